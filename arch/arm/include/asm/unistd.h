@@ -393,6 +393,13 @@
 #define __NR_perf_event_open		(__NR_SYSCALL_BASE+364)
 #define __NR_recvmmsg			(__NR_SYSCALL_BASE+365)
 
+/*
+ * Syscalls private to this tree are numbered from 1000 up, clear of
+ * the upstream numbers (366 is accept4 upstream), so that a binary
+ * built against upstream headers never reaches one of them by accident.
+ */
+#define __NR_getdents_stat		(__NR_SYSCALL_BASE+1000)
+
 /*
  * The following SWIs are ARM private.
  */
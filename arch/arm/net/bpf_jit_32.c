@@ -0,0 +1,717 @@
+/*
+ * Just-In-Time compiler for BPF filters on 32bit ARM
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/moduleloader.h>
+#include <linux/netdevice.h>
+#include <linux/filter.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <asm/cacheflush.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * ABI:
+ *
+ * r0	scratch register, return value of the helpers
+ * r1	offset of the packet load (second argument of the helpers)
+ * r2	scratch register
+ * r3	scratch register
+ * r4	BPF register A
+ * r5	BPF register X
+ * r6	pointer to the skb
+ * r7	skb->data
+ * r8	skb_headlen(skb)
+ *
+ * mem[] lives at the bottom of the stack frame, mem[k] at [sp, #4 * k].
+ */
+
+#define r_scratch	ARM_R0
+#define r_off		ARM_R1
+#define r_A		ARM_R4
+#define r_X		ARM_R5
+#define r_skb		ARM_R6
+#define r_skb_data	ARM_R7
+#define r_skb_hl	ARM_R8
+
+#define SCRATCH_SIZE	(BPF_MEMWORDS * 4)
+
+#define SEEN_MEM	1 /* uses mem[] */
+#define SEEN_DATA	2 /* reads packet data: r7/r8 are loaded */
+#define SEEN_X		4 /* uses the X register */
+
+/* registers saved by the prologue; the epilogue pops lr into pc */
+#define SAVED_REGS	((1 << r_A) | (1 << r_X) | (1 << r_skb) | \
+			 (1 << r_skb_data) | (1 << r_skb_hl))
+
+struct jit_ctx {
+	const struct sk_filter *skf;
+	unsigned idx;		/* index of the next ARM instruction */
+	u32 seen;
+	u16 memload;		/* mem[] slots loaded from */
+	u32 *offsets;		/* first ARM instruction of each BPF insn */
+	u32 *target;		/* NULL until the final pass */
+};
+
+int bpf_jit_enable __read_mostly;
+
+/*
+ * Slow path of the packet loads: non linear skbs, and the negative
+ * SKF_NET_OFF/SKF_LL_OFF offsets. The loaded value is returned in r0 and
+ * a non zero r1 (upper word) means the load failed.
+ */
+static inline u64 jit_load_slow(struct sk_buff *skb, int offset,
+				unsigned int size)
+{
+	u8 buf[4];
+	const u8 *ptr = buf;
+
+	if (offset >= 0) {
+		if (skb_copy_bits(skb, offset, buf, size))
+			return 1ULL << 32;
+	} else {
+		ptr = bpf_internal_load_pointer_neg_helper(skb, offset, size);
+		if (ptr == NULL)
+			return 1ULL << 32;
+	}
+
+	if (size == 4)
+		return get_unaligned_be32(ptr);
+	if (size == 2)
+		return get_unaligned_be16(ptr);
+	return *ptr;
+}
+
+static u64 jit_get_skb_b(struct sk_buff *skb, int offset)
+{
+	return jit_load_slow(skb, offset, 1);
+}
+
+static u64 jit_get_skb_h(struct sk_buff *skb, int offset)
+{
+	return jit_load_slow(skb, offset, 2);
+}
+
+static u64 jit_get_skb_w(struct sk_buff *skb, int offset)
+{
+	return jit_load_slow(skb, offset, 4);
+}
+
+static u32 jit_udiv(u32 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst | (cond << 28);
+
+	ctx->idx++;
+}
+
+/*
+ * Emit an instruction that will be executed unconditionally.
+ */
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+/*
+ * Encode a 32 bit constant as a data processing immediate (an 8 bit
+ * value rotated right by an even amount). Returns -1 if impossible.
+ */
+static int imm8m(u32 x)
+{
+	u32 rot;
+
+	for (rot = 0; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+/*
+ * Load a constant. The number of instructions only depends on the value,
+ * so it is the same in every pass.
+ */
+static void emit_mov_i(int rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(val);
+	int shift;
+
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+	emit(ARM_MOV_I(rd, val & 0xff), ctx);
+	for (shift = 8; shift < 32; shift += 8)
+		if (val & (0xffU << shift))
+			emit(ARM_ORR_I(rd, rd, imm8m(val & (0xffU << shift))),
+			     ctx);
+}
+
+static inline void emit_blx_r(u8 tgt_reg, struct jit_ctx *ctx)
+{
+#if __LINUX_ARM_ARCH__ < 5
+	emit(ARM_MOV_R(ARM_LR, ARM_PC), ctx);
+	emit(ARM_MOV_R(ARM_PC, tgt_reg), ctx);
+#else
+	emit(ARM_BLX_R(tgt_reg), ctx);
+#endif
+}
+
+static inline void emit_call(void *func, struct jit_ctx *ctx)
+{
+	emit_mov_i(ARM_R3, (u32)func, ctx);
+	emit_blx_r(ARM_R3, ctx);
+}
+
+/*
+ * Offset field of a branch to the first instruction of BPF insn tgt.
+ * Only forward branches exist, and their targets were laid out by the
+ * previous pass.
+ */
+static inline u32 b_imm(unsigned tgt, struct jit_ctx *ctx)
+{
+	if (ctx->target == NULL)
+		return 0;
+
+	/* the pc reads 8 bytes ahead of the branch */
+	return ctx->offsets[tgt] - (ctx->idx + 2);
+}
+
+/*
+ * Return 0 from the filter if cond holds: offsets[len] is the epilogue.
+ */
+static inline void emit_err_ret(u8 cond, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_MOV_I(r_A, 0), ctx);
+	_emit(cond, ARM_B(b_imm(ctx->skf->len, ctx)), ctx);
+}
+
+/* rd = *(u16 *)(rn + off), rn must not be r2 */
+static void emit_ldrh_off(int rd, int rn, unsigned off, struct jit_ctx *ctx)
+{
+	if (off < 256) {
+		emit(ARM_LDRH_I(rd, rn, off), ctx);
+	} else {
+		emit_mov_i(ARM_R2, off, ctx);
+		emit(ARM_LDRH_R(rd, rn, ARM_R2), ctx);
+	}
+}
+
+/*
+ * Load size bytes in network order at offset r1 of the packet into r0.
+ */
+static void emit_load(unsigned size, struct jit_ctx *ctx)
+{
+	unsigned skip, i;
+	void *func;
+
+	ctx->seen |= SEEN_DATA;
+
+	/*
+	 * fast path if 0 <= offset && offset + size <= headlen: the SUBS
+	 * clears the carry if headlen < size, which skips the compare.
+	 */
+	emit(ARM_SUBS_I(ARM_R3, r_skb_hl, size), ctx);
+	_emit(ARM_COND_HS, ARM_CMP_R(ARM_R3, r_off), ctx);
+	_emit(ARM_COND_HS, ARM_ADD_R(ARM_R2, r_skb_data, r_off), ctx);
+	_emit(ARM_COND_HS, ARM_LDRB_I(ARM_R0, ARM_R2, 0), ctx);
+	for (i = 1; i < size; i++) {
+		_emit(ARM_COND_HS, ARM_LDRB_I(ARM_R3, ARM_R2, i), ctx);
+		_emit(ARM_COND_HS,
+		      ARM_ORR_S(ARM_R0, ARM_R3, ARM_R0, SRTYPE_LSL, 8), ctx);
+	}
+	skip = ctx->idx;
+	_emit(ARM_COND_HS, ARM_B(0), ctx);
+
+	/* the slow path, the offset is already in r1 */
+	if (size == 4)
+		func = jit_get_skb_w;
+	else if (size == 2)
+		func = jit_get_skb_h;
+	else
+		func = jit_get_skb_b;
+	emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+	emit_call(func, ctx);
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	emit_err_ret(ARM_COND_NE, ctx);
+
+	if (ctx->target != NULL)
+		ctx->target[skip] = ARM_B(ctx->idx - (skip + 2)) |
+				    (ARM_COND_HS << 28);
+}
+
+/*
+ * BPF_S_LD_*_ABS with K in the SKF_AD_OFF area. Returns -1 for the
+ * ancillary data the JIT leaves to the interpreter.
+ */
+static int emit_ancillary(int ad_off, struct jit_ctx *ctx)
+{
+	switch (ad_off) {
+	case SKF_AD_PROTOCOL:
+		BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, protocol) != 2);
+		emit_ldrh_off(r_A, r_skb, offsetof(struct sk_buff, protocol),
+			      ctx);
+#ifndef __ARMEB__
+		/* ntohs() */
+		emit(ARM_LSR_I(ARM_R3, r_A, 8), ctx);
+		emit(ARM_AND_I(r_A, r_A, 0xff), ctx);
+		emit(ARM_ORR_S(r_A, ARM_R3, r_A, SRTYPE_LSL, 8), ctx);
+#endif
+		break;
+	case SKF_AD_MARK:
+		BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, mark) != 4);
+		emit(ARM_LDR_I(r_A, r_skb, offsetof(struct sk_buff, mark)),
+		     ctx);
+		break;
+	case SKF_AD_IFINDEX:
+	case SKF_AD_HATYPE:
+		/* if (!skb->dev) return 0; */
+		emit(ARM_LDR_I(ARM_R3, r_skb, offsetof(struct sk_buff, dev)),
+		     ctx);
+		emit(ARM_CMP_I(ARM_R3, 0), ctx);
+		emit_err_ret(ARM_COND_EQ, ctx);
+		if (ad_off == SKF_AD_IFINDEX) {
+			BUILD_BUG_ON(FIELD_SIZEOF(struct net_device,
+						  ifindex) != 4);
+			emit(ARM_LDR_I(r_A, ARM_R3,
+				       offsetof(struct net_device, ifindex)),
+			     ctx);
+		} else {
+			BUILD_BUG_ON(FIELD_SIZEOF(struct net_device,
+						  type) != 2);
+			emit_ldrh_off(r_A, ARM_R3,
+				      offsetof(struct net_device, type), ctx);
+		}
+		break;
+	default:
+		/*
+		 * PKTTYPE and QUEUE are bitfields, NLATTR calls into
+		 * netlink code
+		 */
+		return -1;
+	}
+	return 0;
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	int i;
+
+	BUILD_BUG_ON(offsetof(struct sk_buff, len) > 4095);
+	BUILD_BUG_ON(offsetof(struct sk_buff, data) > 4095);
+	BUILD_BUG_ON(offsetof(struct sk_buff, data_len) > 4095);
+
+	emit(ARM_PUSH(SAVED_REGS | (1 << ARM_LR)), ctx);
+	if (ctx->seen & SEEN_MEM)
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, SCRATCH_SIZE), ctx);
+
+	emit(ARM_MOV_R(r_skb, ARM_R0), ctx);
+	if (ctx->seen & SEEN_DATA) {
+		emit(ARM_LDR_I(r_skb_data, r_skb,
+			       offsetof(struct sk_buff, data)), ctx);
+		emit(ARM_LDR_I(r_skb_hl, r_skb,
+			       offsetof(struct sk_buff, len)), ctx);
+		emit(ARM_LDR_I(r_scratch, r_skb,
+			       offsetof(struct sk_buff, data_len)), ctx);
+		emit(ARM_SUB_R(r_skb_hl, r_skb_hl, r_scratch), ctx);
+	}
+
+	/* make sure we dont leak kernel information to user */
+	emit(ARM_MOV_I(r_A, 0), ctx);
+	if (ctx->seen & SEEN_X)
+		emit(ARM_MOV_I(r_X, 0), ctx);
+
+	/* the interpreter reads 0 from mem[] slots never written to */
+	for (i = 0; i < BPF_MEMWORDS; i++)
+		if (ctx->memload & (1 << i))
+			emit(ARM_STR_I(r_A, ARM_SP, i * 4), ctx);
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+	if (ctx->seen & SEEN_MEM)
+		emit(ARM_ADD_I(ARM_SP, ARM_SP, SCRATCH_SIZE), ctx);
+	emit(ARM_POP(SAVED_REGS | (1 << ARM_PC)), ctx);
+}
+
+#define ALU_K(OP)							\
+do {									\
+	imm12 = imm8m(k);						\
+	if (imm12 >= 0) {						\
+		emit(ARM_##OP##_I(r_A, r_A, imm12), ctx);		\
+	} else {							\
+		emit_mov_i(ARM_R3, k, ctx);				\
+		emit(ARM_##OP##_R(r_A, r_A, ARM_R3), ctx);		\
+	}								\
+} while (0)
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct sk_filter *prog = ctx->skf;
+	const struct sock_filter *inst;
+	unsigned i, size;
+	int imm12;
+	u8 condt;
+	u32 k;
+
+	for (i = 0; i < prog->len; i++) {
+		inst = &(prog->insns[i]);
+		/* K as an immediate value operand */
+		k = inst->k;
+
+		/* record the start of each BPF instruction */
+		ctx->offsets[i] = ctx->idx;
+
+		switch (inst->code) {
+		case BPF_S_LD_IMM:
+			emit_mov_i(r_A, k, ctx);
+			break;
+		case BPF_S_LD_W_LEN:
+			emit(ARM_LDR_I(r_A, r_skb,
+				       offsetof(struct sk_buff, len)), ctx);
+			break;
+		case BPF_S_LD_MEM:
+			/* A = scratch[k] */
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_LDR_I(r_A, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_S_LD_W_ABS:
+			size = 4;
+			goto load;
+		case BPF_S_LD_H_ABS:
+			size = 2;
+			goto load;
+		case BPF_S_LD_B_ABS:
+			size = 1;
+load:
+			if ((int)k < 0 && (int)k >= SKF_AD_OFF) {
+				if (emit_ancillary((int)k - SKF_AD_OFF, ctx))
+					return -1;
+				break;
+			}
+			emit_mov_i(r_off, k, ctx);
+			emit_load(size, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+		case BPF_S_LD_W_IND:
+			size = 4;
+			goto load_ind;
+		case BPF_S_LD_H_IND:
+			size = 2;
+			goto load_ind;
+		case BPF_S_LD_B_IND:
+			size = 1;
+load_ind:
+			ctx->seen |= SEEN_X;
+			emit_mov_i(r_off, k, ctx);
+			emit(ARM_ADD_R(r_off, r_off, r_X), ctx);
+			emit_load(size, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+		case BPF_S_LDX_IMM:
+			ctx->seen |= SEEN_X;
+			emit_mov_i(r_X, k, ctx);
+			break;
+		case BPF_S_LDX_W_LEN:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LDR_I(r_X, r_skb,
+				       offsetof(struct sk_buff, len)), ctx);
+			break;
+		case BPF_S_LDX_MEM:
+			ctx->seen |= SEEN_X | SEEN_MEM;
+			emit(ARM_LDR_I(r_X, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_S_LDX_B_MSH:
+			/* x = ((*(frame + k)) & 0xf) << 2; */
+			if ((int)k < 0 && (int)k >= SKF_AD_OFF)
+				return -1;
+			ctx->seen |= SEEN_X;
+			emit_mov_i(r_off, k, ctx);
+			emit_load(1, ctx);
+			emit(ARM_AND_I(r_X, ARM_R0, 0x0f), ctx);
+			emit(ARM_LSL_I(r_X, r_X, 2), ctx);
+			break;
+		case BPF_S_ST:
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_STR_I(r_A, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_S_STX:
+			ctx->seen |= SEEN_MEM | SEEN_X;
+			emit(ARM_STR_I(r_X, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_S_ALU_ADD_K:
+			/* A += K */
+			ALU_K(ADD);
+			break;
+		case BPF_S_ALU_ADD_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_ADD_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_SUB_K:
+			/* A -= K */
+			ALU_K(SUB);
+			break;
+		case BPF_S_ALU_SUB_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_SUB_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_MUL_K:
+			/* A *= K */
+			emit_mov_i(ARM_R3, k, ctx);
+			emit(ARM_MUL(r_A, r_A, ARM_R3), ctx);
+			break;
+		case BPF_S_ALU_MUL_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_MUL(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_DIV_K:
+			/* K != 0, checked by sk_chk_filter() */
+			emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+			emit_mov_i(ARM_R1, k, ctx);
+			emit_call(jit_udiv, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+		case BPF_S_ALU_DIV_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_CMP_I(r_X, 0), ctx);
+			emit_err_ret(ARM_COND_EQ, ctx);
+			emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+			emit(ARM_MOV_R(ARM_R1, r_X), ctx);
+			emit_call(jit_udiv, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+		case BPF_S_ALU_OR_K:
+			/* A |= K */
+			ALU_K(ORR);
+			break;
+		case BPF_S_ALU_OR_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_ORR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_AND_K:
+			/* A &= K */
+			ALU_K(AND);
+			break;
+		case BPF_S_ALU_AND_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_AND_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_LSH_K:
+			if (k == 0)
+				break;
+			if (k < 32) {
+				emit(ARM_LSL_I(r_A, r_A, k), ctx);
+			} else {
+				emit_mov_i(ARM_R3, k, ctx);
+				emit(ARM_LSL_R(r_A, r_A, ARM_R3), ctx);
+			}
+			break;
+		case BPF_S_ALU_LSH_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LSL_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_RSH_K:
+			/* an immediate LSR #0 would mean LSR #32 */
+			if (k == 0)
+				break;
+			if (k < 32) {
+				emit(ARM_LSR_I(r_A, r_A, k), ctx);
+			} else {
+				emit_mov_i(ARM_R3, k, ctx);
+				emit(ARM_LSR_R(r_A, r_A, ARM_R3), ctx);
+			}
+			break;
+		case BPF_S_ALU_RSH_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LSR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_S_ALU_NEG:
+			/* A = -A */
+			emit(ARM_RSB_I(r_A, r_A, 0), ctx);
+			break;
+		case BPF_S_JMP_JA:
+			/* pc += K */
+			emit(ARM_B(b_imm(i + k + 1, ctx)), ctx);
+			break;
+		case BPF_S_JMP_JEQ_K:
+			/* pc += (A == K) ? pc->jt : pc->jf */
+			condt  = ARM_COND_EQ;
+			goto cmp_imm;
+		case BPF_S_JMP_JGT_K:
+			/* pc += (A > K) ? pc->jt : pc->jf */
+			condt  = ARM_COND_HI;
+			goto cmp_imm;
+		case BPF_S_JMP_JGE_K:
+			/* pc += (A >= K) ? pc->jt : pc->jf */
+			condt  = ARM_COND_HS;
+cmp_imm:
+			imm12 = imm8m(k);
+			if (imm12 < 0) {
+				emit_mov_i(ARM_R3, k, ctx);
+				emit(ARM_CMP_R(r_A, ARM_R3), ctx);
+			} else {
+				emit(ARM_CMP_I(r_A, imm12), ctx);
+			}
+cond_jump:
+			if (inst->jt)
+				_emit(condt, ARM_B(b_imm(i + inst->jt + 1,
+						   ctx)), ctx);
+			/* condt ^ 1 is the inverse condition */
+			if (inst->jf)
+				_emit(condt ^ 1, ARM_B(b_imm(i + inst->jf + 1,
+							     ctx)), ctx);
+			break;
+		case BPF_S_JMP_JEQ_X:
+			/* pc += (A == X) ? pc->jt : pc->jf */
+			condt   = ARM_COND_EQ;
+			goto cmp_x;
+		case BPF_S_JMP_JGT_X:
+			/* pc += (A > X) ? pc->jt : pc->jf */
+			condt   = ARM_COND_HI;
+			goto cmp_x;
+		case BPF_S_JMP_JGE_X:
+			/* pc += (A >= X) ? pc->jt : pc->jf */
+			condt   = ARM_COND_HS;
+cmp_x:
+			ctx->seen |= SEEN_X;
+			emit(ARM_CMP_R(r_A, r_X), ctx);
+			goto cond_jump;
+		case BPF_S_JMP_JSET_K:
+			/* pc += (A & K) ? pc->jt : pc->jf */
+			condt  = ARM_COND_NE;
+			imm12 = imm8m(k);
+			if (imm12 < 0) {
+				emit_mov_i(ARM_R3, k, ctx);
+				emit(ARM_TST_R(r_A, ARM_R3), ctx);
+			} else {
+				emit(ARM_TST_I(r_A, imm12), ctx);
+			}
+			goto cond_jump;
+		case BPF_S_JMP_JSET_X:
+			/* pc += (A & X) ? pc->jt : pc->jf */
+			ctx->seen |= SEEN_X;
+			condt  = ARM_COND_NE;
+			emit(ARM_TST_R(r_A, r_X), ctx);
+			goto cond_jump;
+		case BPF_S_RET_A:
+			goto b_epilogue;
+		case BPF_S_RET_K:
+			emit_mov_i(r_A, k, ctx);
+b_epilogue:
+			/* the epilogue directly follows the last insn */
+			if (i != prog->len - 1)
+				emit(ARM_B(b_imm(prog->len, ctx)), ctx);
+			break;
+		case BPF_S_MISC_TAX:
+			/* X = A */
+			ctx->seen |= SEEN_X;
+			emit(ARM_MOV_R(r_X, r_A), ctx);
+			break;
+		case BPF_S_MISC_TXA:
+			/* A = X */
+			ctx->seen |= SEEN_X;
+			emit(ARM_MOV_R(r_A, r_X), ctx);
+			break;
+		default:
+			/* leave the filter to the interpreter */
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void bpf_jit_compile(struct sk_filter *fp)
+{
+	struct jit_ctx ctx;
+	unsigned alloc_size;
+	unsigned i;
+
+	if (!bpf_jit_enable)
+		return;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.skf = fp;
+
+	ctx.offsets = kzalloc(4 * (ctx.skf->len + 1), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	for (i = 0; i < fp->len; i++)
+		if (fp->insns[i].code == BPF_S_LD_MEM ||
+		    fp->insns[i].code == BPF_S_LDX_MEM)
+			ctx.memload |= 1 << fp->insns[i].k;
+
+	/* fake pass to fill in ctx.seen */
+	if (unlikely(build_body(&ctx)))
+		goto out;
+
+	/* second fake pass to lay out the code and get its size */
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	ctx.offsets[fp->len] = ctx.idx;
+	build_epilogue(&ctx);
+
+	alloc_size = 4 * ctx.idx;
+	ctx.target = module_alloc(max_t(unsigned, alloc_size,
+					sizeof(struct work_struct)));
+	if (unlikely(ctx.target == NULL))
+		goto out;
+
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		print_hex_dump(KERN_INFO, "BPF JIT code: ",
+			       DUMP_PREFIX_ADDRESS, 16, 4, ctx.target,
+			       alloc_size, false);
+
+	fp->bpf_func = (void *)ctx.target;
+out:
+	kfree(ctx.offsets);
+	return;
+}
+
+static void bpf_jit_free_worker(struct work_struct *work)
+{
+	module_free(NULL, work);
+}
+
+void bpf_jit_free(struct sk_filter *fp)
+{
+	struct work_struct *work;
+
+	if (fp->bpf_func) {
+		work = (struct work_struct *)fp->bpf_func;
+
+		INIT_WORK(work, bpf_jit_free_worker);
+		schedule_work(work);
+	}
+}
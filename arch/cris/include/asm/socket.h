@@ -64,6 +64,10 @@
 
 #define SO_RXQ_OVFL             40
 
+#define SO_PEEK_OFF             42
+
+#define SO_ZEROCOPY             60
+
 #endif /* _ASM_SOCKET_H */
 
 
@@ -61,6 +61,10 @@
 
 #define SO_RXQ_OVFL             0x4021
 
+#define SO_PEEK_OFF             0x4023
+
+#define SO_ZEROCOPY             0x4035
+
 /* O_NONBLOCK clashes with the bits used for socket types.  Therefore we
  * have to define SOCK_NONBLOCK to a different value here.
  */
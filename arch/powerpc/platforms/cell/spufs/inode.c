@@ -71,10 +71,17 @@ spufs_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void spufs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(spufs_inode_cache, SPUFS_I(inode));
+}
+
 static void
 spufs_destroy_inode(struct inode *inode)
 {
-	kmem_cache_free(spufs_inode_cache, SPUFS_I(inode));
+	call_rcu(&inode->i_rcu, spufs_i_callback);
 }
 
 static void
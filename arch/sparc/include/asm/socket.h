@@ -58,6 +58,10 @@
 
 #define SO_RXQ_OVFL             0x0024
 
+#define SO_PEEK_OFF             0x0026
+
+#define SO_ZEROCOPY             0x003e
+
 /* Security levels - as per NRL IPv6 - don't actually do anything */
 #define SO_SECURITY_AUTHENTICATION		0x5001
 #define SO_SECURITY_ENCRYPTION_TRANSPORT	0x5002
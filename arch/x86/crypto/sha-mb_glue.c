@@ -0,0 +1,116 @@
+/*
+ * Multi-buffer SHA-1 and SHA-256, hashing four or eight independent
+ * messages at a time in the 32 bit lanes of SSE2 registers.
+ *
+ * These register with a low priority, so a plain "sha1" or "sha256" still
+ * gets the synchronous implementation; callers that have many requests in
+ * flight at once and can take asynchronous completions ask for the
+ * drivers by name.  The queueing and lane scheduling is in
+ * crypto/mb_hash.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <crypto/mb_hash.h>
+#include <crypto/sha.h>
+
+#include <asm/cpufeature.h>
+#include <asm/i387.h>
+
+#define SHA_MB_PRIORITY		50
+
+void sha1_mb_blocks_x4(u32 *state[], const u8 *data[], unsigned int blocks);
+void sha1_mb_blocks_x8(u32 *state[], const u8 *data[], unsigned int blocks);
+void sha256_mb_blocks_x4(u32 *state[], const u8 *data[], unsigned int blocks);
+void sha256_mb_blocks_x8(u32 *state[], const u8 *data[], unsigned int blocks);
+
+static const u32 sha1_mb_iv[MB_HASH_MAX_WORDS] = {
+	SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4,
+};
+
+static const u32 sha256_mb_iv[MB_HASH_MAX_WORDS] = {
+	SHA256_H0, SHA256_H1, SHA256_H2, SHA256_H3,
+	SHA256_H4, SHA256_H5, SHA256_H6, SHA256_H7,
+};
+
+#define SHA_MB_BLOCKS(name)						\
+static void name##_fpu(u32 *state[], const u8 *data[],			\
+		       unsigned int blocks)				\
+{									\
+	kernel_fpu_begin();						\
+	name(state, data, blocks);					\
+	kernel_fpu_end();						\
+}
+
+SHA_MB_BLOCKS(sha1_mb_blocks_x4)
+SHA_MB_BLOCKS(sha1_mb_blocks_x8)
+SHA_MB_BLOCKS(sha256_mb_blocks_x4)
+SHA_MB_BLOCKS(sha256_mb_blocks_x8)
+
+#define SHA_MB_ALG(alg, nlanes, name, size)				\
+{									\
+	.lanes		= nlanes,					\
+	.iv		= alg##_mb_iv,					\
+	.blocks		= alg##_mb_blocks_x##nlanes##_fpu,		\
+	.ahash.halg	= {						\
+		.digestsize	= size,					\
+		.base		= {					\
+			.cra_name		= name,			\
+			.cra_driver_name	= #alg "-mb-x" #nlanes,	\
+			.cra_priority		= SHA_MB_PRIORITY,	\
+			.cra_module		= THIS_MODULE,		\
+		}							\
+	}								\
+}
+
+static struct mb_hash_alg sha_mb_algs[] = {
+	SHA_MB_ALG(sha1, 4, "sha1", SHA1_DIGEST_SIZE),
+	SHA_MB_ALG(sha1, 8, "sha1", SHA1_DIGEST_SIZE),
+	SHA_MB_ALG(sha256, 4, "sha256", SHA256_DIGEST_SIZE),
+	SHA_MB_ALG(sha256, 8, "sha256", SHA256_DIGEST_SIZE),
+};
+
+static int __init sha_mb_mod_init(void)
+{
+	int i, err;
+
+	if (!cpu_has_xmm2) {
+		pr_info("SSE2 instructions are not detected.\n");
+		return -ENODEV;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sha_mb_algs); i++) {
+		err = mb_hash_register(&sha_mb_algs[i]);
+		if (err)
+			goto out_unregister;
+	}
+	return 0;
+
+out_unregister:
+	while (--i >= 0)
+		mb_hash_unregister(&sha_mb_algs[i]);
+	return err;
+}
+
+static void __exit sha_mb_mod_fini(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sha_mb_algs); i++)
+		mb_hash_unregister(&sha_mb_algs[i]);
+}
+
+module_init(sha_mb_mod_init);
+module_exit(sha_mb_mod_fini);
+
+MODULE_DESCRIPTION("Multi-buffer SHA-1 and SHA-256, SSE2 accelerated");
+MODULE_LICENSE("GPL");
+
+MODULE_ALIAS("sha1-mb-x4");
+MODULE_ALIAS("sha1-mb-x8");
+MODULE_ALIAS("sha256-mb-x4");
+MODULE_ALIAS("sha256-mb-x8");
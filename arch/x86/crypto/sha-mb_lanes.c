@@ -0,0 +1,55 @@
+/*
+ * SIMD lane functions for the SHA-1/SHA-256 multi-buffer hash driver.
+ *
+ * This file is built with SSE2 enabled, so nothing but the lane functions
+ * may live here: the caller must wrap every call in kernel_fpu_begin() and
+ * kernel_fpu_end().
+ *
+ * Eight lanes are two runs of four: with only sixteen 128-bit registers,
+ * eight lanes in two register halves spill so much that SHA-256 gets
+ * slower than four lanes, SHA-1 gains only about 5%, and both need
+ * 2-4k of stack.  The template takes any lane count for when wider
+ * registers can be used.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <asm/unaligned.h>
+
+static const u32 sha256_mb_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA_MB_LANES 4
+#include "sha-mb_lanes.h"
+#undef SHA_MB_LANES
+
+void sha1_mb_blocks_x8(u32 *state[], const u8 *data[], unsigned int blocks)
+{
+	sha1_mb_blocks_x4(state, data, blocks);
+	sha1_mb_blocks_x4(state + 4, data + 4, blocks);
+}
+
+void sha256_mb_blocks_x8(u32 *state[], const u8 *data[], unsigned int blocks)
+{
+	sha256_mb_blocks_x4(state, data, blocks);
+	sha256_mb_blocks_x4(state + 4, data + 4, blocks);
+}
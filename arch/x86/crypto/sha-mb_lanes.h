@@ -0,0 +1,260 @@
+/*
+ * SHA-1 and SHA-256 block functions for SHA_MB_LANES independent messages
+ * at a time, for the multi-buffer hash engine.
+ *
+ * Every variable holds one 32-bit word of each message side by side in a
+ * GCC vector, so each operation of the compression function is a single
+ * SIMD instruction for all lanes.  sha-mb_lanes.c includes this once per
+ * lane count it needs.
+ */
+
+#define __MB_PASTE(name, lanes)	name##_x##lanes
+#define _MB_PASTE(name, lanes)	__MB_PASTE(name, lanes)
+#define MB(name)		_MB_PASTE(name, SHA_MB_LANES)
+
+typedef u32 MB(vec) __attribute__((vector_size(4 * SHA_MB_LANES)));
+
+union MB(lane_vec) {
+	MB(vec) v;
+	u32 w[SHA_MB_LANES];
+};
+
+static inline MB(vec) MB(splat)(u32 x)
+{
+	union MB(lane_vec) u;
+	int l;
+
+	for (l = 0; l < SHA_MB_LANES; l++)
+		u.w[l] = x;
+	return u.v;
+}
+
+/*
+ * Gather the current block of every lane into w[].  All the scalar stores
+ * are done before the first vector load so the loads don't stall on
+ * store forwarding.
+ */
+static inline void MB(load_block)(MB(vec) *w, const u8 *data[])
+{
+	union MB(lane_vec) u[16];
+	int i, l;
+
+	for (l = 0; l < SHA_MB_LANES; l++)
+		for (i = 0; i < 16; i++)
+			u[i].w[l] = get_unaligned_be32(data[l] + 4 * i);
+	for (i = 0; i < 16; i++)
+		w[i] = u[i].v;
+}
+
+static inline void MB(load_state)(MB(vec) *v, u32 *state[], int words)
+{
+	union MB(lane_vec) u;
+	int i, l;
+
+	for (i = 0; i < words; i++) {
+		for (l = 0; l < SHA_MB_LANES; l++)
+			u.w[l] = state[l][i];
+		v[i] = u.v;
+	}
+}
+
+static inline void MB(store_state)(u32 *state[], const MB(vec) *v, int words)
+{
+	union MB(lane_vec) u;
+	int i, l;
+
+	for (i = 0; i < words; i++) {
+		u.v = v[i];
+		for (l = 0; l < SHA_MB_LANES; l++)
+			state[l][i] = u.w[l];
+	}
+}
+
+#define MB_ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+#define MB_ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * The message schedule lives in a 16 entry circular buffer; W() computes
+ * the next word in place.
+ */
+#define MB_W1(i)	(w[(i) & 15] = MB_ROL(w[((i) - 3) & 15] ^ \
+			 w[((i) - 8) & 15] ^ w[((i) - 14) & 15] ^ \
+			 w[(i) & 15], 1))
+
+#define MB_SHA1_ROUND(a, b, c, d, e, f, k, x)				\
+	do {								\
+		e += MB_ROL(a, 5) + (f) + (k) + (x);			\
+		b = MB_ROL(b, 30);					\
+	} while (0)
+
+#define MB_F1(b, c, d)	((d) ^ ((b) & ((c) ^ (d))))
+#define MB_F2(b, c, d)	((b) ^ (c) ^ (d))
+#define MB_F3(b, c, d)	(((b) & (c)) | ((d) & ((b) | (c))))
+
+#define MB_SHA1_5(i, F, k, X)						\
+	do {								\
+		MB_SHA1_ROUND(a, b, c, d, e, F(b, c, d), k, X(i));	\
+		MB_SHA1_ROUND(e, a, b, c, d, F(a, b, c), k, X(i + 1));	\
+		MB_SHA1_ROUND(d, e, a, b, c, F(e, a, b), k, X(i + 2));	\
+		MB_SHA1_ROUND(c, d, e, a, b, F(d, e, a), k, X(i + 3));	\
+		MB_SHA1_ROUND(b, c, d, e, a, F(c, d, e), k, X(i + 4));	\
+	} while (0)
+
+#define MB_W0(i)	(w[i])
+
+void MB(sha1_mb_blocks)(u32 *state[], const u8 *data[], unsigned int blocks)
+{
+	const u8 *p[SHA_MB_LANES];
+	MB(vec) h[5], w[16];
+	MB(vec) a, b, c, d, e, k;
+	int l;
+
+	for (l = 0; l < SHA_MB_LANES; l++)
+		p[l] = data[l];
+	MB(load_state)(h, state, 5);
+
+	while (blocks--) {
+		a = h[0];
+		b = h[1];
+		c = h[2];
+		d = h[3];
+		e = h[4];
+		MB(load_block)(w, p);
+
+		k = MB(splat)(0x5a827999);
+		MB_SHA1_5(0, MB_F1, k, MB_W0);
+		MB_SHA1_5(5, MB_F1, k, MB_W0);
+		MB_SHA1_5(10, MB_F1, k, MB_W0);
+		MB_SHA1_ROUND(a, b, c, d, e, MB_F1(b, c, d), k, MB_W0(15));
+		MB_SHA1_ROUND(e, a, b, c, d, MB_F1(a, b, c), k, MB_W1(16));
+		MB_SHA1_ROUND(d, e, a, b, c, MB_F1(e, a, b), k, MB_W1(17));
+		MB_SHA1_ROUND(c, d, e, a, b, MB_F1(d, e, a), k, MB_W1(18));
+		MB_SHA1_ROUND(b, c, d, e, a, MB_F1(c, d, e), k, MB_W1(19));
+
+		k = MB(splat)(0x6ed9eba1);
+		MB_SHA1_5(20, MB_F2, k, MB_W1);
+		MB_SHA1_5(25, MB_F2, k, MB_W1);
+		MB_SHA1_5(30, MB_F2, k, MB_W1);
+		MB_SHA1_5(35, MB_F2, k, MB_W1);
+
+		k = MB(splat)(0x8f1bbcdc);
+		MB_SHA1_5(40, MB_F3, k, MB_W1);
+		MB_SHA1_5(45, MB_F3, k, MB_W1);
+		MB_SHA1_5(50, MB_F3, k, MB_W1);
+		MB_SHA1_5(55, MB_F3, k, MB_W1);
+
+		k = MB(splat)(0xca62c1d6);
+		MB_SHA1_5(60, MB_F2, k, MB_W1);
+		MB_SHA1_5(65, MB_F2, k, MB_W1);
+		MB_SHA1_5(70, MB_F2, k, MB_W1);
+		MB_SHA1_5(75, MB_F2, k, MB_W1);
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+		for (l = 0; l < SHA_MB_LANES; l++)
+			p[l] += 64;
+	}
+
+	MB(store_state)(state, h, 5);
+}
+
+#define MB_S0(x)	(MB_ROR(x, 7) ^ MB_ROR(x, 18) ^ ((x) >> 3))
+#define MB_S1(x)	(MB_ROR(x, 17) ^ MB_ROR(x, 19) ^ ((x) >> 10))
+#define MB_E0(x)	(MB_ROR(x, 2) ^ MB_ROR(x, 13) ^ MB_ROR(x, 22))
+#define MB_E1(x)	(MB_ROR(x, 6) ^ MB_ROR(x, 11) ^ MB_ROR(x, 25))
+#define MB_CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MB_MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+#define MB_W2(i)	(w[(i) & 15] += MB_S0(w[((i) - 15) & 15]) + \
+			 w[((i) - 7) & 15] + MB_S1(w[((i) - 2) & 15]))
+
+#define MB_SHA256_ROUND(a, b, c, d, e, f, g, h, i, x)			\
+	do {								\
+		t1 = h + MB_E1(e) + MB_CH(e, f, g) +			\
+		     MB(splat)(sha256_mb_k[i]) + (x);			\
+		d += t1;						\
+		h = t1 + MB_E0(a) + MB_MAJ(a, b, c);			\
+	} while (0)
+
+#define MB_SHA256_8(i, X)						\
+	do {								\
+		MB_SHA256_ROUND(a, b, c, d, e, f, g, hh, i, X(i));	\
+		MB_SHA256_ROUND(hh, a, b, c, d, e, f, g, i + 1, X(i + 1)); \
+		MB_SHA256_ROUND(g, hh, a, b, c, d, e, f, i + 2, X(i + 2)); \
+		MB_SHA256_ROUND(f, g, hh, a, b, c, d, e, i + 3, X(i + 3)); \
+		MB_SHA256_ROUND(e, f, g, hh, a, b, c, d, i + 4, X(i + 4)); \
+		MB_SHA256_ROUND(d, e, f, g, hh, a, b, c, i + 5, X(i + 5)); \
+		MB_SHA256_ROUND(c, d, e, f, g, hh, a, b, i + 6, X(i + 6)); \
+		MB_SHA256_ROUND(b, c, d, e, f, g, hh, a, i + 7, X(i + 7)); \
+	} while (0)
+
+void MB(sha256_mb_blocks)(u32 *state[], const u8 *data[], unsigned int blocks)
+{
+	const u8 *p[SHA_MB_LANES];
+	MB(vec) h[8], w[16];
+	MB(vec) a, b, c, d, e, f, g, hh, t1;
+	int l;
+
+	for (l = 0; l < SHA_MB_LANES; l++)
+		p[l] = data[l];
+	MB(load_state)(h, state, 8);
+
+	while (blocks--) {
+		a = h[0];
+		b = h[1];
+		c = h[2];
+		d = h[3];
+		e = h[4];
+		f = h[5];
+		g = h[6];
+		hh = h[7];
+		MB(load_block)(w, p);
+
+		MB_SHA256_8(0, MB_W0);
+		MB_SHA256_8(8, MB_W0);
+		MB_SHA256_8(16, MB_W2);
+		MB_SHA256_8(24, MB_W2);
+		MB_SHA256_8(32, MB_W2);
+		MB_SHA256_8(40, MB_W2);
+		MB_SHA256_8(48, MB_W2);
+		MB_SHA256_8(56, MB_W2);
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+		h[5] += f;
+		h[6] += g;
+		h[7] += hh;
+		for (l = 0; l < SHA_MB_LANES; l++)
+			p[l] += 64;
+	}
+
+	MB(store_state)(state, h, 8);
+}
+
+#undef MB_W0
+#undef MB_W1
+#undef MB_W2
+#undef MB_SHA1_ROUND
+#undef MB_SHA1_5
+#undef MB_F1
+#undef MB_F2
+#undef MB_F3
+#undef MB_S0
+#undef MB_S1
+#undef MB_E0
+#undef MB_E1
+#undef MB_CH
+#undef MB_MAJ
+#undef MB_SHA256_ROUND
+#undef MB_SHA256_8
+#undef MB_ROL
+#undef MB_ROR
+#undef MB
+#undef _MB_PASTE
+#undef __MB_PASTE
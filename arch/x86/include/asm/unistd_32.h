@@ -344,9 +344,12 @@
 #define __NR_perf_event_open	336
 #define __NR_recvmmsg		337
 
+/* private to this tree, see asm/unistd_64.h; 338-999 are unused */
+#define __NR_getdents_stat	1000
+
 #ifdef __KERNEL__
 
-#define NR_syscalls 338
+#define NR_syscalls 1001
 
 #define __ARCH_WANT_IPC_PARSE_VERSION
 #define __ARCH_WANT_OLD_READDIR
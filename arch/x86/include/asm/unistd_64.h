@@ -664,6 +664,14 @@ __SYSCALL(__NR_perf_event_open, sys_perf_event_open)
 #define __NR_recvmmsg				299
 __SYSCALL(__NR_recvmmsg, sys_recvmmsg)
 
+/*
+ * Syscalls private to this tree are numbered from 1000 up, clear of
+ * the upstream numbers, so that a binary built against upstream headers
+ * never reaches one of them by accident. The gap is sys_ni_syscall.
+ */
+#define __NR_getdents_stat			1000
+__SYSCALL(__NR_getdents_stat, sys_getdents_stat)
+
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
 #define __ARCH_WANT_OLD_STAT
@@ -0,0 +1,440 @@
+/*
+ * Multi-buffer hash engine.
+ *
+ * Hashing one small buffer at a time leaves most of a SIMD unit idle: the
+ * rounds of SHA-1 or SHA-256 depend on each other, so a single message
+ * can't be spread across vector lanes.  Independent messages can though.
+ * This engine takes ahash requests from any number of callers, queues
+ * them per cpu, and once there are enough to fill the lanes (or the oldest
+ * one has waited flush_us microseconds) hands them to the algorithm's
+ * block function in groups of "lanes" messages.  When one message runs
+ * out of blocks its lane is refilled from the queue while the others keep
+ * going.
+ *
+ * Requests are hashed straight out of their scatterlists; only partial
+ * blocks, blocks straddling highmem page boundaries and the final padding
+ * go through a per-request bounce buffer.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/crypto_wq.h>
+#include <crypto/internal/hash.h>
+#include <crypto/mb_hash.h>
+#include <crypto/scatterwalk.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/scatterlist.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <asm/unaligned.h>
+
+#define MB_HASH_MAX_CPU_QLEN	1000
+
+/*
+ * Blocks per lane per call of the block function, which bounds the time
+ * spent with preemption off in kernel_fpu_begin() sections.
+ */
+#define MB_HASH_MAX_BLOCKS	16
+
+static unsigned int flush_us = 1000;
+module_param(flush_us, uint, 0644);
+MODULE_PARM_DESC(flush_us,
+		 "Microseconds a request may wait for the lanes to fill up");
+
+struct mb_hash_cpu_queue {
+	spinlock_t lock;
+	struct crypto_queue queue;
+	struct work_struct work;
+	struct delayed_work flush;
+	struct mb_hash_alg *alg;
+};
+
+enum {
+	MB_HASH_UPDATE,		/* just hash the data */
+	MB_HASH_FINAL,		/* pad after the data */
+	MB_HASH_PADDED,		/* padding handed out, write the digest */
+};
+
+struct mb_hash_request_ctx {
+	struct mb_hash_state state;
+	struct scatterlist *sg;
+	unsigned int offset;	/* into sg */
+	unsigned int nbytes;	/* left to hash */
+	int final;
+};
+
+static inline struct mb_hash_alg *mb_hash_alg(struct crypto_ahash *tfm)
+{
+	struct crypto_alg *alg = crypto_ahash_tfm(tfm)->__crt_alg;
+
+	return container_of(__crypto_ahash_alg(alg), struct mb_hash_alg,
+			    ahash);
+}
+
+static inline void mb_hash_advance(struct mb_hash_request_ctx *rctx,
+				   unsigned int len)
+{
+	rctx->state.count += len;
+	rctx->offset += len;
+	rctx->nbytes -= len;
+}
+
+/*
+ * Find the next run of whole blocks of a request: returns how many there
+ * are and points *data at them, or returns 0 when the request is done.
+ * Called from the worker only, between calls of the block function.
+ */
+static unsigned int mb_hash_next(struct mb_hash_request_ctx *rctx,
+				 const u8 **data)
+{
+	struct mb_hash_state *st = &rctx->state;
+	unsigned int partial = st->count % MB_HASH_BLOCK_SIZE;
+
+	while (rctx->nbytes) {
+		struct scatterlist *sg = rctx->sg;
+		unsigned int off = sg->offset + rctx->offset;
+		unsigned int len = min(sg->length - rctx->offset,
+				       rctx->nbytes);
+		struct page *page;
+		u8 *vaddr;
+
+		if (!len) {
+			rctx->sg = scatterwalk_sg_next(sg);
+			rctx->offset = 0;
+			continue;
+		}
+
+		page = nth_page(sg_page(sg), off >> PAGE_SHIFT);
+		off &= ~PAGE_MASK;
+
+		if (!partial && len >= MB_HASH_BLOCK_SIZE &&
+		    !PageHighMem(page) &&
+		    !PageHighMem(nth_page(page, (off + len - 1) >> PAGE_SHIFT))) {
+			len /= MB_HASH_BLOCK_SIZE;
+			*data = page_address(page) + off;
+			mb_hash_advance(rctx, len * MB_HASH_BLOCK_SIZE);
+			return len;
+		}
+
+		len = min(len, MB_HASH_BLOCK_SIZE - partial);
+		len = min_t(unsigned int, len, PAGE_SIZE - off);
+		vaddr = crypto_kmap(page, 0);
+		memcpy(st->buf + partial, vaddr + off, len);
+		crypto_kunmap(vaddr, 0);
+		mb_hash_advance(rctx, len);
+
+		partial += len;
+		if (partial == MB_HASH_BLOCK_SIZE) {
+			*data = st->buf;
+			return 1;
+		}
+	}
+
+	if (rctx->final == MB_HASH_FINAL) {
+		unsigned int padlen = partial < MB_HASH_BLOCK_SIZE - 8 ?
+				      MB_HASH_BLOCK_SIZE :
+				      2 * MB_HASH_BLOCK_SIZE;
+
+		st->buf[partial] = 0x80;
+		memset(st->buf + partial + 1, 0, padlen - partial - 9);
+		put_unaligned_be64(st->count << 3, st->buf + padlen - 8);
+		rctx->final = MB_HASH_PADDED;
+		*data = st->buf;
+		return padlen / MB_HASH_BLOCK_SIZE;
+	}
+
+	return 0;
+}
+
+static void mb_hash_complete(struct ahash_request *req, int err)
+{
+	struct mb_hash_request_ctx *rctx = ahash_request_ctx(req);
+	unsigned int i, words;
+
+	if (rctx->final == MB_HASH_PADDED) {
+		words = crypto_ahash_digestsize(crypto_ahash_reqtfm(req)) / 4;
+		for (i = 0; i < words; i++)
+			put_unaligned_be32(rctx->state.h[i],
+					   req->result + 4 * i);
+	}
+
+	local_bh_disable();
+	req->base.complete(&req->base, err);
+	local_bh_enable();
+}
+
+static struct ahash_request *mb_hash_dequeue(struct mb_hash_cpu_queue *cq)
+{
+	struct crypto_async_request *req, *backlog;
+
+	spin_lock_bh(&cq->lock);
+	backlog = crypto_get_backlog(&cq->queue);
+	req = crypto_dequeue_request(&cq->queue);
+	spin_unlock_bh(&cq->lock);
+
+	if (backlog) {
+		local_bh_disable();
+		backlog->complete(backlog, -EINPROGRESS);
+		local_bh_enable();
+	}
+
+	return req ? ahash_request_cast(req) : NULL;
+}
+
+/*
+ * Run everything queued on @cq through the lanes.  Idle lanes are refilled
+ * from the queue as they free up, so under load the lanes stay full; once
+ * the queue is empty the remaining requests are finished with some lanes
+ * idle rather than left waiting.
+ */
+static void mb_hash_run(struct mb_hash_cpu_queue *cq)
+{
+	struct mb_hash_alg *alg = cq->alg;
+	struct ahash_request *job[MB_HASH_MAX_LANES] = { NULL, };
+	unsigned int left[MB_HASH_MAX_LANES];
+	const u8 *data[MB_HASH_MAX_LANES];
+	u32 *state[MB_HASH_MAX_LANES];
+	u32 scratch[MB_HASH_MAX_WORDS];
+	struct mb_hash_request_ctx *rctx;
+	struct ahash_request *req;
+	unsigned int i, n, lead = 0, active = 0;
+
+	for (;;) {
+		for (i = 0; i < alg->lanes; i++) {
+			while (!job[i] && (req = mb_hash_dequeue(cq))) {
+				rctx = ahash_request_ctx(req);
+				left[i] = mb_hash_next(rctx, &data[i]);
+				if (!left[i]) {
+					mb_hash_complete(req, 0);
+					continue;
+				}
+				job[i] = req;
+				state[i] = rctx->state.h;
+				active++;
+			}
+			if (!job[i])
+				break;
+		}
+		if (!active)
+			break;
+
+		n = MB_HASH_MAX_BLOCKS;
+		for (i = 0; i < alg->lanes; i++) {
+			if (job[i]) {
+				n = min(n, left[i]);
+				lead = i;
+			}
+		}
+		for (i = 0; i < alg->lanes; i++) {
+			if (!job[i]) {
+				state[i] = scratch;
+				data[i] = data[lead];
+			}
+		}
+
+		alg->blocks(state, data, n);
+
+		for (i = 0; i < alg->lanes; i++) {
+			if (!job[i])
+				continue;
+			data[i] += n * MB_HASH_BLOCK_SIZE;
+			left[i] -= n;
+			if (left[i])
+				continue;
+			left[i] = mb_hash_next(ahash_request_ctx(job[i]),
+					       &data[i]);
+			if (left[i])
+				continue;
+			mb_hash_complete(job[i], 0);
+			job[i] = NULL;
+			active--;
+		}
+
+		cond_resched();
+	}
+}
+
+static void mb_hash_work(struct work_struct *work)
+{
+	mb_hash_run(container_of(work, struct mb_hash_cpu_queue, work));
+}
+
+static void mb_hash_flush(struct work_struct *work)
+{
+	mb_hash_run(container_of(work, struct mb_hash_cpu_queue, flush.work));
+}
+
+static int mb_hash_enqueue(struct ahash_request *req)
+{
+	struct mb_hash_alg *alg = mb_hash_alg(crypto_ahash_reqtfm(req));
+	struct mb_hash_cpu_queue *cq;
+	unsigned int qlen;
+	int cpu, err;
+
+	cpu = get_cpu();
+	cq = per_cpu_ptr(alg->queue, cpu);
+
+	spin_lock_bh(&cq->lock);
+	err = ahash_enqueue_request(&cq->queue, req);
+	qlen = cq->queue.qlen;
+	spin_unlock_bh(&cq->lock);
+
+	/* run now if the lanes are full, else when the oldest times out */
+	if (qlen >= alg->lanes)
+		queue_work_on(cpu, kcrypto_wq, &cq->work);
+	else
+		queue_delayed_work_on(cpu, kcrypto_wq, &cq->flush,
+				      usecs_to_jiffies(flush_us));
+	put_cpu();
+
+	return err;
+}
+
+static int mb_hash_submit(struct ahash_request *req, unsigned int nbytes,
+			  int final)
+{
+	struct mb_hash_request_ctx *rctx = ahash_request_ctx(req);
+	unsigned int partial = rctx->state.count % MB_HASH_BLOCK_SIZE;
+
+	/* no whole block to hash yet: keep the bytes and finish right away */
+	if (!final && partial + nbytes < MB_HASH_BLOCK_SIZE) {
+		scatterwalk_map_and_copy(rctx->state.buf + partial, req->src,
+					 0, nbytes, 0);
+		rctx->state.count += nbytes;
+		return 0;
+	}
+
+	rctx->sg = req->src;
+	rctx->offset = 0;
+	rctx->nbytes = nbytes;
+	rctx->final = final ? MB_HASH_FINAL : MB_HASH_UPDATE;
+
+	return mb_hash_enqueue(req);
+}
+
+static int mb_hash_init(struct ahash_request *req)
+{
+	struct mb_hash_alg *alg = mb_hash_alg(crypto_ahash_reqtfm(req));
+	struct mb_hash_request_ctx *rctx = ahash_request_ctx(req);
+
+	memcpy(rctx->state.h, alg->iv, sizeof(rctx->state.h));
+	rctx->state.count = 0;
+
+	return 0;
+}
+
+static int mb_hash_update(struct ahash_request *req)
+{
+	return mb_hash_submit(req, req->nbytes, 0);
+}
+
+static int mb_hash_final(struct ahash_request *req)
+{
+	return mb_hash_submit(req, 0, 1);
+}
+
+static int mb_hash_finup(struct ahash_request *req)
+{
+	return mb_hash_submit(req, req->nbytes, 1);
+}
+
+static int mb_hash_digest(struct ahash_request *req)
+{
+	return mb_hash_init(req) ?: mb_hash_finup(req);
+}
+
+static int mb_hash_export(struct ahash_request *req, void *out)
+{
+	struct mb_hash_request_ctx *rctx = ahash_request_ctx(req);
+
+	memcpy(out, &rctx->state, sizeof(rctx->state));
+	return 0;
+}
+
+static int mb_hash_import(struct ahash_request *req, const void *in)
+{
+	struct mb_hash_request_ctx *rctx = ahash_request_ctx(req);
+
+	memcpy(&rctx->state, in, sizeof(rctx->state));
+	return 0;
+}
+
+static int mb_hash_cra_init(struct crypto_tfm *tfm)
+{
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct mb_hash_request_ctx));
+	return 0;
+}
+
+int mb_hash_register(struct mb_hash_alg *alg)
+{
+	struct crypto_alg *base = &alg->ahash.halg.base;
+	struct mb_hash_cpu_queue *cq;
+	int cpu, err;
+
+	if (!alg->lanes || alg->lanes > MB_HASH_MAX_LANES ||
+	    alg->ahash.halg.digestsize > 4 * MB_HASH_MAX_WORDS)
+		return -EINVAL;
+
+	alg->queue = alloc_percpu(struct mb_hash_cpu_queue);
+	if (!alg->queue)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		cq = per_cpu_ptr(alg->queue, cpu);
+		spin_lock_init(&cq->lock);
+		crypto_init_queue(&cq->queue, MB_HASH_MAX_CPU_QLEN);
+		INIT_WORK(&cq->work, mb_hash_work);
+		INIT_DELAYED_WORK(&cq->flush, mb_hash_flush);
+		cq->alg = alg;
+	}
+
+	alg->ahash.init = mb_hash_init;
+	alg->ahash.update = mb_hash_update;
+	alg->ahash.final = mb_hash_final;
+	alg->ahash.finup = mb_hash_finup;
+	alg->ahash.digest = mb_hash_digest;
+	alg->ahash.export = mb_hash_export;
+	alg->ahash.import = mb_hash_import;
+	alg->ahash.halg.statesize = sizeof(struct mb_hash_state);
+
+	base->cra_flags = CRYPTO_ALG_TYPE_AHASH | CRYPTO_ALG_ASYNC;
+	base->cra_blocksize = MB_HASH_BLOCK_SIZE;
+	base->cra_init = mb_hash_cra_init;
+
+	err = crypto_register_ahash(&alg->ahash);
+	if (err)
+		free_percpu(alg->queue);
+	return err;
+}
+EXPORT_SYMBOL_GPL(mb_hash_register);
+
+void mb_hash_unregister(struct mb_hash_alg *alg)
+{
+	struct mb_hash_cpu_queue *cq;
+	int cpu;
+
+	crypto_unregister_ahash(&alg->ahash);
+
+	for_each_possible_cpu(cpu) {
+		cq = per_cpu_ptr(alg->queue, cpu);
+		cancel_delayed_work_sync(&cq->flush);
+		cancel_work_sync(&cq->work);
+		BUG_ON(cq->queue.qlen);
+	}
+	free_percpu(alg->queue);
+}
+EXPORT_SYMBOL_GPL(mb_hash_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Multi-buffer hash engine");
@@ -54,10 +54,10 @@ static char *tvmem[TVMEMSIZE];
 static char *check[] = {
 	"des", "md5", "des3_ede", "rot13", "sha1", "sha224", "sha256",
 	"blowfish", "twofish", "serpent", "sha384", "sha512", "md4", "aes",
-	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
-	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
-	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "crc32", "tea",
+	"xtea", "khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",
+	"fcrypt", "camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256",
+	"rmd320", "lzo", "cts", "zlib", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -711,6 +711,140 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+#define MB_REQS	8
+
+/*
+ * Keep MB_REQS digests of the same buffer in flight at once, which is what
+ * the multi-buffer drivers need to fill their lanes, and report the
+ * aggregate throughput.
+ */
+static int test_mb_ahash_batch(struct ahash_request **req,
+			       struct tcrypt_result *tr)
+{
+	int i, ret, err = 0;
+
+	for (i = 0; i < MB_REQS; i++) {
+		ret = crypto_ahash_digest(req[i]);
+		if (ret == -EINPROGRESS || ret == -EBUSY)
+			continue;
+		tr[i].err = ret;
+		complete(&tr[i].completion);
+	}
+
+	for (i = 0; i < MB_REQS; i++) {
+		wait_for_completion(&tr[i].completion);
+		INIT_COMPLETION(tr[i].completion);
+		if (tr[i].err)
+			err = tr[i].err;
+	}
+
+	return err;
+}
+
+static void test_mb_ahash_speed(const char *algo, unsigned int sec,
+				struct hash_speed *speed)
+{
+	struct scatterlist sg[TVMEMSIZE];
+	struct tcrypt_result tr[MB_REQS];
+	struct ahash_request *req[MB_REQS] = { NULL, };
+	struct crypto_ahash *tfm;
+	static char output[MB_REQS][64];
+	unsigned long start, end, cycles;
+	int i, j, bcount, ret;
+
+	printk(KERN_INFO "\ntesting speed of multi-buffer %s, %d requests "
+	       "in flight\n", algo, MB_REQS);
+
+	tfm = crypto_alloc_ahash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	if (crypto_ahash_digestsize(tfm) > sizeof(output[0])) {
+		pr_err("digestsize(%u) > outputbuffer(%zu)\n",
+		       crypto_ahash_digestsize(tfm), sizeof(output[0]));
+		goto out;
+	}
+
+	test_hash_sg_init(sg);
+	for (i = 0; i < MB_REQS; i++) {
+		req[i] = ahash_request_alloc(tfm, GFP_KERNEL);
+		if (!req[i]) {
+			pr_err("ahash request allocation failure\n");
+			goto out_free;
+		}
+		init_completion(&tr[i].completion);
+		ahash_request_set_callback(req[i], CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   tcrypt_complete, &tr[i]);
+	}
+
+	for (i = 0; speed[i].blen != 0; i++) {
+		/* whole-buffer digests only */
+		if (speed[i].plen != speed[i].blen)
+			continue;
+		if (speed[i].blen > TVMEMSIZE * PAGE_SIZE) {
+			pr_err("template (%u) too big for tvmem (%lu)\n",
+			       speed[i].blen, TVMEMSIZE * PAGE_SIZE);
+			break;
+		}
+
+		pr_info("test%3u (%5u byte blocks): ", i, speed[i].blen);
+
+		for (j = 0; j < MB_REQS; j++)
+			ahash_request_set_crypt(req[j], sg, output[j],
+						speed[i].blen);
+
+		/* warm-up run */
+		ret = test_mb_ahash_batch(req, tr);
+		if (ret)
+			goto fail;
+
+		if (sec) {
+			end = jiffies + sec * HZ;
+			for (bcount = 0; time_before(jiffies, end); bcount++) {
+				ret = test_mb_ahash_batch(req, tr);
+				if (ret)
+					goto fail;
+			}
+			pr_cont("%6u opers/sec, %9lu bytes/sec\n",
+				bcount * MB_REQS / sec,
+				((long)bcount * MB_REQS * speed[i].blen) / sec);
+		} else {
+			cycles = 0;
+			for (bcount = 0; bcount < 8; bcount++) {
+				start = get_cycles();
+				ret = test_mb_ahash_batch(req, tr);
+				end = get_cycles();
+				if (ret)
+					goto fail;
+				cycles += end - start;
+			}
+			pr_cont("%6lu cycles/operation, %4lu cycles/byte\n",
+				cycles / (8 * MB_REQS),
+				cycles / (8 * MB_REQS * speed[i].blen));
+		}
+
+		for (j = 1; j < MB_REQS; j++) {
+			if (memcmp(output[j], output[0],
+				   crypto_ahash_digestsize(tfm))) {
+				pr_err("request %d digest differs\n", j);
+				goto out_free;
+			}
+		}
+	}
+	goto out_free;
+
+fail:
+	pr_err("hashing failed ret=%d\n", ret);
+out_free:
+	for (i = 0; i < MB_REQS && req[i]; i++)
+		ahash_request_free(req[i]);
+out:
+	crypto_free_ahash(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -936,6 +1070,10 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4309(ccm(aes))");
 		break;
 
+	case 46:
+		ret += tcrypt_test("crc32");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1138,6 +1276,14 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("crc32c", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 320:
+		test_hash_speed("crc32", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1212,6 +1358,26 @@ static int do_test(int m)
 		test_ahash_speed("rmd320", sec, generic_hash_speed_template);
 		if (mode > 400 && mode < 500) break;
 
+	case 418:
+		test_mb_ahash_speed("sha1-mb-x4", sec,
+				    generic_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
+	case 419:
+		test_mb_ahash_speed("sha1-mb-x8", sec,
+				    generic_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
+	case 420:
+		test_mb_ahash_speed("sha256-mb-x4", sec,
+				    generic_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
+	case 421:
+		test_mb_ahash_speed("sha256-mb-x8", sec,
+				    generic_hash_speed_template);
+		if (mode > 400 && mode < 500) break;
+
 	case 499:
 		break;
 
@@ -9431,6 +9431,71 @@ static struct hash_testvec michael_mic_tv_template[] = {
 	}
 };
 
+/*
+ * CRC32 test vectors
+ */
+#define CRC32_TEST_VECTORS 5
+
+static struct hash_testvec crc32_tv_template[] = {
+	{
+		.psize = 0,
+		.digest = "\x00\x00\x00\x00",
+	},
+	{
+		.key = "\x87\xa9\xcb\xed",
+		.ksize = 4,
+		.psize = 0,
+		.digest = "\x78\x56\x34\x12",
+	},
+	{
+		.plaintext = "123456789",
+		.psize = 9,
+		.digest = "\x26\x39\xf4\xcb",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x00\x01\x02\x03\x04\x05\x06\x07"
+			     "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+			     "\x10\x11\x12\x13\x14\x15\x16\x17"
+			     "\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f"
+			     "\x20\x21\x22\x23\x24\x25\x26\x27",
+		.psize = 40,
+		.digest = "\x3c\x2e\xa6\x0d",
+	},
+	{
+		.plaintext = "\x03\x0a\x11\x18\x1f\x26\x2d\x34"
+			     "\x3b\x42\x49\x50\x57\x5e\x65\x6c"
+			     "\x73\x7a\x81\x88\x8f\x96\x9d\xa4"
+			     "\xab\xb2\xb9\xc0\xc7\xce\xd5\xdc"
+			     "\xe3\xea\xf1\xf8\xff\x06\x0d\x14"
+			     "\x1b\x22\x29\x30\x37\x3e\x45\x4c"
+			     "\x53\x5a\x61\x68\x6f\x76\x7d\x84"
+			     "\x8b\x92\x99\xa0\xa7\xae\xb5\xbc"
+			     "\xc3\xca\xd1\xd8\xdf\xe6\xed\xf4"
+			     "\xfb\x02\x09\x10\x17\x1e\x25\x2c"
+			     "\x33\x3a\x41\x48\x4f\x56\x5d\x64"
+			     "\x6b\x72\x79\x80\x87\x8e\x95\x9c"
+			     "\xa3\xaa\xb1\xb8\xbf\xc6\xcd\xd4"
+			     "\xdb\xe2\xe9\xf0\xf7\xfe\x05\x0c"
+			     "\x13\x1a\x21\x28\x2f\x36\x3d\x44"
+			     "\x4b\x52\x59\x60\x67\x6e\x75\x7c"
+			     "\x83\x8a\x91\x98\x9f\xa6\xad\xb4"
+			     "\xbb\xc2\xc9\xd0\xd7\xde\xe5\xec"
+			     "\xf3\xfa\x01\x08\x0f\x16\x1d\x24"
+			     "\x2b\x32\x39\x40\x47\x4e\x55\x5c"
+			     "\x63\x6a\x71\x78\x7f\x86\x8d\x94"
+			     "\x9b\xa2\xa9\xb0\xb7\xbe\xc5\xcc"
+			     "\xd3\xda\xe1\xe8\xef\xf6\xfd\x04"
+			     "\x0b\x12\x19\x20\x27\x2e\x35\x3c"
+			     "\x43\x4a\x51\x58\x5f\x66\x6d\x74",
+		.psize = 200,
+		.digest = "\x03\x69\xf1\x0f",
+		.np = 2,
+		.tap = { 72, 128 }
+	}
+};
+
 /*
  * CRC32C test vectors
  */
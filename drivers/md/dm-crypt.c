@@ -18,6 +18,7 @@
 #include <linux/crypto.h>
 #include <linux/workqueue.h>
 #include <linux/backing-dev.h>
+#include <linux/percpu.h>
 #include <asm/atomic.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
@@ -41,6 +42,7 @@ struct convert_context {
 	unsigned int idx_out;
 	sector_t sector;
 	atomic_t pending;
+	struct ablkcipher_request *req;
 };
 
 /*
@@ -57,6 +59,14 @@ struct dm_crypt_io {
 	int error;
 	sector_t sector;
 	struct dm_crypt_io *base_io;
+
+	/*
+	 * Writes are submitted in the order they were mapped; see
+	 * kcryptd_write_flush().  Only used in the base io of a write.
+	 */
+	struct list_head write_list;
+	struct bio_list write_bios;
+	unsigned write_pending;
 };
 
 struct dm_crypt_request {
@@ -86,6 +96,15 @@ struct iv_benbi_private {
 	int shift;
 };
 
+/*
+ * Per-cpu throughput counters, reported by the status command.
+ */
+struct crypt_stats {
+	u64 sectors[2];
+	unsigned long ios[2];
+	unsigned long inline_ios;
+};
+
 /*
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
@@ -107,6 +126,25 @@ struct crypt_config {
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
 
+	/*
+	 * writes in the order they were mapped, waiting for
+	 * encryption of all their fragments to finish
+	 */
+	spinlock_t write_lock;
+	struct list_head write_list;
+	struct work_struct write_work;
+	int write_force;
+	/* tasks in crypt_alloc_page_wait() */
+	atomic_t page_waiters;
+
+	/*
+	 * small synchronous writes up to this size are encrypted in
+	 * the context of the submitter (0: never)
+	 */
+	unsigned int inline_max_sectors;
+
+	struct crypt_stats __percpu *stats;
+
 	/*
 	 * crypto related data
 	 */
@@ -133,7 +171,6 @@ struct crypt_config {
 	 * correctly aligned.
 	 */
 	unsigned int dmreq_start;
-	struct ablkcipher_request *req;
 
 	char cipher[CRYPTO_MAX_ALG_NAME];
 	char chainmode[CRYPTO_MAX_ALG_NAME];
@@ -460,13 +497,13 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
-	if (!cc->req)
-		cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
-	ablkcipher_request_set_tfm(cc->req, cc->tfm);
-	ablkcipher_request_set_callback(cc->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	if (!ctx->req)
+		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	ablkcipher_request_set_tfm(ctx->req, cc->tfm);
+	ablkcipher_request_set_callback(ctx->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
 					CRYPTO_TFM_REQ_MAY_SLEEP,
 					kcryptd_async_done,
-					dmreq_of_req(cc, cc->req));
+					dmreq_of_req(cc, ctx->req));
 }
 
 /*
@@ -486,7 +523,7 @@ static int crypt_convert(struct crypt_config *cc,
 
 		atomic_inc(&ctx->pending);
 
-		r = crypt_convert_block(cc, ctx, cc->req);
+		r = crypt_convert_block(cc, ctx, ctx->req);
 
 		switch (r) {
 		/* async */
@@ -495,7 +532,7 @@ static int crypt_convert(struct crypt_config *cc,
 			INIT_COMPLETION(ctx->restart);
 			/* fall through*/
 		case -EINPROGRESS:
-			cc->req = NULL;
+			ctx->req = NULL;
 			ctx->sector++;
 			continue;
 
@@ -524,6 +561,35 @@ static void dm_crypt_bio_destructor(struct bio *bio)
 	bio_free(bio, cc->bs);
 }
 
+static void crypt_write_flush(struct crypt_config *cc, int force);
+
+/*
+ * Wait for a page from the pool.  Writes held back for ordering pin
+ * pool pages and are only freed once submitted, so while anyone waits
+ * here each fragment is submitted as soon as it is encrypted (see
+ * crypt_write_end()), and whatever is held back is flushed again every
+ * time the wait runs out.  A fragment queued behind the waiter itself
+ * is the only one that cannot make progress, and it holds no pages yet.
+ */
+static struct page *crypt_alloc_page_wait(struct crypt_config *cc,
+					  gfp_t gfp_mask)
+{
+	gfp_t nowait = (gfp_mask | __GFP_NOWARN) & ~__GFP_WAIT;
+	struct page *page;
+
+	atomic_inc(&cc->page_waiters);
+	for (;;) {
+		crypt_write_flush(cc, 1);
+		page = mempool_alloc(cc->page_pool, nowait);
+		if (page)
+			break;
+		congestion_wait(BLK_RW_ASYNC, HZ/100);
+	}
+	atomic_dec(&cc->page_waiters);
+
+	return page;
+}
+
 /*
  * Generate a new unfragmented bio with the given size
  * This should never violate the device limitations
@@ -531,16 +597,16 @@ static void dm_crypt_bio_destructor(struct bio *bio)
  * *out_of_pages set to 1.
  */
 static struct bio *crypt_alloc_buffer(struct dm_crypt_io *io, unsigned size,
-				      unsigned *out_of_pages)
+				      unsigned *out_of_pages, gfp_t gfp)
 {
 	struct crypt_config *cc = io->target->private;
 	struct bio *clone;
 	unsigned int nr_iovecs = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	gfp_t gfp_mask = GFP_NOIO | __GFP_HIGHMEM;
+	gfp_t gfp_mask = gfp | __GFP_HIGHMEM;
 	unsigned i, len;
 	struct page *page;
 
-	clone = bio_alloc_bioset(GFP_NOIO, nr_iovecs, cc->bs);
+	clone = bio_alloc_bioset(gfp, nr_iovecs, cc->bs);
 	if (!clone)
 		return NULL;
 
@@ -548,7 +614,10 @@ static struct bio *crypt_alloc_buffer(struct dm_crypt_io *io, unsigned size,
 	*out_of_pages = 0;
 
 	for (i = 0; i < nr_iovecs; i++) {
-		page = mempool_alloc(cc->page_pool, gfp_mask);
+		page = mempool_alloc(cc->page_pool,
+				     (gfp_mask | __GFP_NOWARN) & ~__GFP_WAIT);
+		if (!page && (gfp_mask & __GFP_WAIT))
+			page = crypt_alloc_page_wait(cc, gfp_mask);
 		if (!page) {
 			*out_of_pages = 1;
 			break;
@@ -605,7 +674,11 @@ static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
 	io->sector = sector;
 	io->error = 0;
 	io->base_io = NULL;
+	io->ctx.req = NULL;
 	atomic_set(&io->pending, 0);
+	INIT_LIST_HEAD(&io->write_list);
+	bio_list_init(&io->write_bios);
+	io->write_pending = 0;
 
 	return io;
 }
@@ -630,6 +703,8 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 	if (!atomic_dec_and_test(&io->pending))
 		return;
 
+	if (io->ctx.req)
+		mempool_free(io->ctx.req, cc->req_pool);
 	mempool_free(io, cc->io_pool);
 
 	if (likely(!base_io))
@@ -641,13 +716,126 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 	}
 }
 
+/*
+ * Writes are passed down in the order they were mapped, even though
+ * their encryption is spread over all cpus and may finish in any order:
+ * a write is only submitted once every write mapped before it has been.
+ * This only runs from the single threaded kcryptd_io, so the clones
+ * also reach generic_make_request() in that order.
+ * With write_force set, everything that is encrypted so far is submitted
+ * regardless of the order, so that the pages held back can be reused
+ * when someone is about to wait for memory.
+ */
+static void kcryptd_write_flush(struct work_struct *work)
+{
+	struct crypt_config *cc = container_of(work, struct crypt_config,
+					       write_work);
+	struct dm_crypt_io *io, *tmp;
+	struct bio_list bios;
+	struct bio *clone;
+	unsigned long flags;
+	int force;
+	LIST_HEAD(done);
+
+	bio_list_init(&bios);
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	force = cc->write_force;
+	cc->write_force = 0;
+	list_for_each_entry_safe(io, tmp, &cc->write_list, write_list) {
+		bio_list_merge(&bios, &io->write_bios);
+		bio_list_init(&io->write_bios);
+
+		if (io->write_pending) {
+			if (!force)
+				break;
+			continue;
+		}
+
+		list_move_tail(&io->write_list, &done);
+	}
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+
+	while ((clone = bio_list_pop(&bios)))
+		generic_make_request(clone);
+
+	/* drop the reference taken in crypt_write_start() */
+	list_for_each_entry_safe(io, tmp, &done, write_list) {
+		list_del_init(&io->write_list);
+		crypt_dec_pending(io);
+	}
+}
+
+/*
+ * Have kcryptd_io submit the writes that are ready, see
+ * kcryptd_write_flush().
+ */
+static void crypt_write_flush(struct crypt_config *cc, int force)
+{
+	unsigned long flags;
+
+	if (force) {
+		spin_lock_irqsave(&cc->write_lock, flags);
+		cc->write_force = 1;
+		spin_unlock_irqrestore(&cc->write_lock, flags);
+	}
+	queue_work(cc->io_queue, &cc->write_work);
+}
+
+/*
+ * Put a newly mapped write at the end of the submission order.  The
+ * write is held back until crypt_write_end() has been called once
+ * for each crypt_write_hold() and once for this.
+ */
+static void crypt_write_start(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	unsigned long flags;
+
+	crypt_inc_pending(io);
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	io->write_pending = 1;
+	list_add_tail(&io->write_list, &cc->write_list);
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+static void crypt_write_hold(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	io->write_pending++;
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+/*
+ * An encrypted fragment @clone of the write @io (NULL on error) is
+ * ready.
+ */
+static void crypt_write_end(struct dm_crypt_io *io, struct bio *clone)
+{
+	struct crypt_config *cc = io->target->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	if (clone)
+		bio_list_add(&io->write_bios, clone);
+	io->write_pending--;
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+
+	/* out of order while someone waits for the pages it holds */
+	crypt_write_flush(cc, atomic_read(&cc->page_waiters) != 0);
+}
+
 /*
  * kcryptd/kcryptd_io:
  *
  * Needed because it would be very unwise to do decryption in an
  * interrupt context.
  *
- * kcryptd performs the actual encryption or decryption.
+ * kcryptd performs the actual encryption or decryption, on all cpus.
  *
  * kcryptd_io performs the IO submission.
  *
@@ -725,20 +913,11 @@ static void kcryptd_io_read(struct dm_crypt_io *io)
 	generic_make_request(clone);
 }
 
-static void kcryptd_io_write(struct dm_crypt_io *io)
-{
-	struct bio *clone = io->ctx.bio_out;
-	generic_make_request(clone);
-}
-
 static void kcryptd_io(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_io_read(io);
-	else
-		kcryptd_io_write(io);
+	kcryptd_io_read(io);
 }
 
 static void kcryptd_queue_io(struct dm_crypt_io *io)
@@ -749,16 +928,17 @@ static void kcryptd_queue_io(struct dm_crypt_io *io)
 	queue_work(cc->io_queue, &io->work);
 }
 
-static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
-					  int error, int async)
+static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int error)
 {
 	struct bio *clone = io->ctx.bio_out;
 	struct crypt_config *cc = io->target->private;
+	struct dm_crypt_io *base_io = io->base_io ? io->base_io : io;
 
 	if (unlikely(error < 0)) {
 		crypt_free_buffer_pages(cc, clone);
 		bio_put(clone);
 		io->error = -EIO;
+		crypt_write_end(base_io, NULL);
 		crypt_dec_pending(io);
 		return;
 	}
@@ -767,17 +947,21 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 	BUG_ON(io->ctx.idx_out < clone->bi_vcnt);
 
 	clone->bi_sector = cc->start + io->sector;
+	irqsafe_cpu_add(cc->stats->sectors[WRITE], bio_sectors(clone));
 
-	if (async)
-		kcryptd_queue_io(io);
-	else
-		generic_make_request(clone);
+	crypt_write_end(base_io, clone);
 }
 
-static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
+/*
+ * @first_clone, if given, is the buffer for the start of the write,
+ * allocated by the caller.
+ */
+static void kcryptd_crypt_write_convert(struct dm_crypt_io *io,
+					struct bio *first_clone)
 {
 	struct crypt_config *cc = io->target->private;
 	struct bio *clone;
+	struct dm_crypt_io *base_io = io;
 	struct dm_crypt_io *new_io;
 	int crypt_finished;
 	unsigned out_of_pages = 0;
@@ -796,7 +980,11 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	 * so repeat the whole process until all the data can be handled.
 	 */
 	while (remaining) {
-		clone = crypt_alloc_buffer(io, remaining, &out_of_pages);
+		clone = first_clone;
+		first_clone = NULL;
+		if (!clone)
+			clone = crypt_alloc_buffer(io, remaining, &out_of_pages,
+						   GFP_NOIO);
 		if (unlikely(!clone)) {
 			io->error = -ENOMEM;
 			break;
@@ -809,12 +997,13 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 		sector += bio_sectors(clone);
 
 		crypt_inc_pending(io);
+		crypt_write_hold(base_io);
 		r = crypt_convert(cc, &io->ctx);
 		crypt_finished = atomic_dec_and_test(&io->ctx.pending);
 
 		/* Encryption was already finished, submit io now */
 		if (crypt_finished) {
-			kcryptd_crypt_write_io_submit(io, r, 0);
+			kcryptd_crypt_write_io_submit(io, r);
 
 			/*
 			 * If there was an error, do not try next fragments.
@@ -862,13 +1051,19 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 		}
 	}
 
+	crypt_write_end(base_io, NULL);
 	crypt_dec_pending(io);
 }
 
 static void kcryptd_crypt_read_done(struct dm_crypt_io *io, int error)
 {
+	struct crypt_config *cc = io->target->private;
+
 	if (unlikely(error < 0))
 		io->error = -EIO;
+	else
+		irqsafe_cpu_add(cc->stats->sectors[READ],
+				bio_sectors(io->base_bio));
 
 	crypt_dec_pending(io);
 }
@@ -912,7 +1107,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_done(io, error);
 	else
-		kcryptd_crypt_write_io_submit(io, error, 1);
+		kcryptd_crypt_write_io_submit(io, error);
 }
 
 static void kcryptd_crypt(struct work_struct *work)
@@ -922,7 +1117,7 @@ static void kcryptd_crypt(struct work_struct *work)
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_convert(io);
 	else
-		kcryptd_crypt_write_convert(io);
+		kcryptd_crypt_write_convert(io, NULL);
 }
 
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
@@ -1001,7 +1196,10 @@ static int crypt_wipe_key(struct crypt_config *cc)
 
 /*
  * Construct an encryption mapping:
- * <cipher> <key> <iv_offset> <dev_path> <start>
+ * <cipher> <key> <iv_offset> <dev_path> <start> [<#opt_params> <opt_params>]
+ *
+ * Optional parameters:
+ *   inline_crypt <max_sectors>
  */
 static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 {
@@ -1013,9 +1211,11 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char *ivmode;
 	char *ivopts;
 	unsigned int key_size;
+	unsigned int opt_params;
 	unsigned long long tmpll;
+	int i;
 
-	if (argc != 5) {
+	if (argc < 5) {
 		ti->error = "Not enough arguments";
 		return -EINVAL;
 	}
@@ -1134,7 +1334,6 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		ti->error = "Cannot allocate crypt request mempool";
 		goto bad_req_pool;
 	}
-	cc->req = NULL;
 
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
@@ -1148,6 +1347,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad_bs;
 	}
 
+	cc->stats = alloc_percpu(struct crypt_stats);
+	if (!cc->stats) {
+		ti->error = "Cannot allocate crypt statistics";
+		goto bad_stats;
+	}
+
 	if (sscanf(argv[2], "%llu", &tmpll) != 1) {
 		ti->error = "Invalid iv_offset sector";
 		goto bad_device;
@@ -1165,6 +1370,29 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad_device;
 	}
 
+	if (argc > 5) {
+		if (sscanf(argv[5], "%u", &opt_params) != 1 ||
+		    opt_params != argc - 6) {
+			ti->error = "Invalid number of feature args";
+			goto bad_ivmode_string;
+		}
+
+		for (i = 6; i < argc; i++) {
+			if (!strcasecmp(argv[i], "inline_crypt") &&
+			    i + 1 < argc) {
+				if (sscanf(argv[++i], "%u",
+					   &cc->inline_max_sectors) != 1) {
+					ti->error = "Invalid inline_crypt size";
+					goto bad_ivmode_string;
+				}
+				continue;
+			}
+
+			ti->error = "Invalid feature arguments";
+			goto bad_ivmode_string;
+		}
+	}
+
 	if (ivmode && cc->iv_gen_ops) {
 		if (ivopts)
 			*(ivopts - 1) = ':';
@@ -1183,12 +1411,17 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad_io_queue;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	cc->crypt_queue = create_workqueue("kcryptd");
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		goto bad_crypt_queue;
 	}
 
+	spin_lock_init(&cc->write_lock);
+	INIT_LIST_HEAD(&cc->write_list);
+	INIT_WORK(&cc->write_work, kcryptd_write_flush);
+	atomic_set(&cc->page_waiters, 0);
+
 	ti->num_flush_requests = 1;
 	ti->private = cc;
 	return 0;
@@ -1200,6 +1433,8 @@ bad_io_queue:
 bad_ivmode_string:
 	dm_put_device(ti, cc->dev);
 bad_device:
+	free_percpu(cc->stats);
+bad_stats:
 	bioset_free(cc->bs);
 bad_bs:
 	mempool_destroy(cc->page_pool);
@@ -1225,9 +1460,7 @@ static void crypt_dtr(struct dm_target *ti)
 	destroy_workqueue(cc->io_queue);
 	destroy_workqueue(cc->crypt_queue);
 
-	if (cc->req)
-		mempool_free(cc->req, cc->req_pool);
-
+	free_percpu(cc->stats);
 	bioset_free(cc->bs);
 	mempool_destroy(cc->page_pool);
 	mempool_destroy(cc->req_pool);
@@ -1247,21 +1480,49 @@ static int crypt_map(struct dm_target *ti, struct bio *bio,
 		     union map_info *map_context)
 {
 	struct dm_crypt_io *io;
-	struct crypt_config *cc;
+	struct crypt_config *cc = ti->private;
+	struct bio *clone;
+	unsigned out_of_pages;
 
 	if (unlikely(bio_empty_barrier(bio))) {
-		cc = ti->private;
 		bio->bi_bdev = cc->dev->bdev;
 		return DM_MAPIO_REMAPPED;
 	}
 
 	io = crypt_io_alloc(ti, bio, bio->bi_sector - ti->begin);
+	irqsafe_cpu_inc(cc->stats->ios[bio_data_dir(bio)]);
 
-	if (bio_data_dir(io->base_bio) == READ)
+	if (bio_data_dir(io->base_bio) == READ) {
 		kcryptd_queue_io(io);
-	else
-		kcryptd_queue_crypt(io);
+		return DM_MAPIO_SUBMITTED;
+	}
+
+	crypt_write_start(io);
 
+	/*
+	 * Small synchronous writes are encrypted right here, someone is
+	 * waiting for them and a trip through kcryptd costs more than
+	 * the encryption itself.  But only if the whole buffer is there
+	 * without waiting: bios submitted from here are not dispatched
+	 * before we return, so waiting for the pages that they hold would
+	 * never end.
+	 */
+	if (cc->inline_max_sectors && bio_rw_flagged(bio, BIO_RW_SYNCIO) &&
+	    bio_sectors(bio) <= cc->inline_max_sectors) {
+		clone = crypt_alloc_buffer(io, bio->bi_size, &out_of_pages,
+					   GFP_NOWAIT);
+		if (clone && clone->bi_size == bio->bi_size) {
+			irqsafe_cpu_inc(cc->stats->inline_ios);
+			kcryptd_crypt_write_convert(io, clone);
+			return DM_MAPIO_SUBMITTED;
+		}
+		if (clone) {
+			crypt_free_buffer_pages(cc, clone);
+			bio_put(clone);
+		}
+	}
+
+	kcryptd_queue_crypt(io);
 	return DM_MAPIO_SUBMITTED;
 }
 
@@ -1269,11 +1530,28 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 			char *result, unsigned int maxlen)
 {
 	struct crypt_config *cc = (struct crypt_config *) ti->private;
+	struct crypt_stats *stats;
+	u64 sectors[2] = { 0, 0 };
+	unsigned long ios[2] = { 0, 0 };
+	unsigned long inline_ios = 0;
 	unsigned int sz = 0;
+	int cpu;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		result[0] = '\0';
+		for_each_possible_cpu(cpu) {
+			stats = per_cpu_ptr(cc->stats, cpu);
+			sectors[READ] += stats->sectors[READ];
+			sectors[WRITE] += stats->sectors[WRITE];
+			ios[READ] += stats->ios[READ];
+			ios[WRITE] += stats->ios[WRITE];
+			inline_ios += stats->inline_ios;
+		}
+
+		DMEMIT("%llu %llu %lu %lu %lu",
+		       (unsigned long long)sectors[READ],
+		       (unsigned long long)sectors[WRITE],
+		       ios[READ], ios[WRITE], inline_ios);
 		break;
 
 	case STATUSTYPE_TABLE:
@@ -1297,6 +1575,9 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
+
+		if (cc->inline_max_sectors)
+			DMEMIT(" 2 inline_crypt %u", cc->inline_max_sectors);
 		break;
 	}
 	return 0;
@@ -1393,7 +1674,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 7, 0},
+	.version = {1, 8, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -51,6 +51,7 @@
 #include <linux/seq_file.h>
 #include <linux/cpu.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include "md.h"
 #include "raid5.h"
 #include "raid0.h"
@@ -70,6 +71,8 @@
 #define HASH_MASK		(NR_HASH - 1)
 
 #define stripe_hash(conf, sect)	(&((conf)->stripe_hashtbl[((sect) >> STRIPE_SHIFT) & HASH_MASK]))
+/* NR_HASH is a multiple of NR_STRIPE_HASH_LOCKS, so every chain has one lock */
+#define stripe_hash_locks_hash(sect) (((sect) >> STRIPE_SHIFT) & STRIPE_HASH_LOCKS_MASK)
 
 /* bio's attached to a stripe+device for I/O are linked together in bi_sector
  * order without overlap.  There may be several bio's per stripe+device, and
@@ -87,10 +90,17 @@
 #define RAID5_PARANOIA	1
 #if RAID5_PARANOIA && defined(CONFIG_SMP)
 # define CHECK_DEVLOCK() assert_spin_locked(&conf->device_lock)
+# define CHECK_HASHLOCK(hash) assert_spin_locked(conf->hash_locks + (hash))
 #else
 # define CHECK_DEVLOCK()
+# define CHECK_HASHLOCK(hash)
 #endif
 
+/* stripes handled per device_lock round trip by raid5d and the workers */
+#define MAX_STRIPE_BATCH	8
+
+static struct workqueue_struct *raid5_wq;
+
 #ifdef DEBUG
 #define inline
 #define __inline__
@@ -193,39 +203,133 @@ static int stripe_operations_active(struct stripe_head *sh)
 	       test_bit(STRIPE_COMPUTE_RUN, &sh->state);
 }
 
-static void __release_stripe(raid5_conf_t *conf, struct stripe_head *sh)
+static void lock_all_device_hash_locks_irq(raid5_conf_t *conf)
 {
-	if (atomic_dec_and_test(&sh->count)) {
-		BUG_ON(!list_empty(&sh->lru));
-		BUG_ON(atomic_read(&conf->active_stripes)==0);
-		if (test_bit(STRIPE_HANDLE, &sh->state)) {
-			if (test_bit(STRIPE_DELAYED, &sh->state)) {
-				list_add_tail(&sh->lru, &conf->delayed_list);
-				blk_plug_device(conf->mddev->queue);
-			} else if (test_bit(STRIPE_BIT_DELAY, &sh->state) &&
-				   sh->bm_seq - conf->seq_write > 0) {
-				list_add_tail(&sh->lru, &conf->bitmap_list);
-				blk_plug_device(conf->mddev->queue);
-			} else {
-				clear_bit(STRIPE_BIT_DELAY, &sh->state);
-				list_add_tail(&sh->lru, &conf->handle_list);
-			}
-			md_wakeup_thread(conf->mddev->thread);
+	int i;
+
+	local_irq_disable();
+	spin_lock(conf->hash_locks);
+	for (i = 1; i < NR_STRIPE_HASH_LOCKS; i++)
+		spin_lock_nest_lock(conf->hash_locks + i, conf->hash_locks);
+	spin_lock(&conf->device_lock);
+}
+
+static void unlock_all_device_hash_locks_irq(raid5_conf_t *conf)
+{
+	int i;
+
+	spin_unlock(&conf->device_lock);
+	for (i = NR_STRIPE_HASH_LOCKS; i; i--)
+		spin_unlock(conf->hash_locks + i - 1);
+	local_irq_enable();
+}
+
+/*
+ * Queue a stripe to the worker of the CPU it belongs to.  Called with
+ * device_lock held and interrupts off, which also keeps that CPU from
+ * going offline under us.
+ */
+static void raid5_wakeup_stripe_thread(struct stripe_head *sh)
+{
+	raid5_conf_t *conf = sh->raid_conf;
+	struct r5worker_group *group;
+	int cpu = sh->cpu;
+
+	if (!cpu_online(cpu)) {
+		cpu = cpumask_any(cpu_online_mask);
+		sh->cpu = cpu;
+	}
+
+	group = conf->worker_groups + cpu;
+	list_add_tail(&sh->lru, &group->handle_list);
+	queue_work_on(cpu, raid5_wq, &group->work);
+}
+
+static void do_release_stripe(raid5_conf_t *conf, struct stripe_head *sh,
+			      struct list_head *temp_inactive_list)
+{
+	BUG_ON(!list_empty(&sh->lru));
+	BUG_ON(atomic_read(&conf->active_stripes)==0);
+	if (test_bit(STRIPE_HANDLE, &sh->state)) {
+		if (test_bit(STRIPE_DELAYED, &sh->state)) {
+			list_add_tail(&sh->lru, &conf->delayed_list);
+			blk_plug_device(conf->mddev->queue);
+		} else if (test_bit(STRIPE_BIT_DELAY, &sh->state) &&
+			   sh->bm_seq - conf->seq_write > 0) {
+			list_add_tail(&sh->lru, &conf->bitmap_list);
+			blk_plug_device(conf->mddev->queue);
 		} else {
-			BUG_ON(stripe_operations_active(sh));
-			if (test_and_clear_bit(STRIPE_PREREAD_ACTIVE, &sh->state)) {
-				atomic_dec(&conf->preread_active_stripes);
-				if (atomic_read(&conf->preread_active_stripes) < IO_THRESHOLD)
-					md_wakeup_thread(conf->mddev->thread);
-			}
-			atomic_dec(&conf->active_stripes);
-			if (!test_bit(STRIPE_EXPANDING, &sh->state)) {
-				list_add_tail(&sh->lru, &conf->inactive_list);
-				wake_up(&conf->wait_for_stripe);
-				if (conf->retry_read_aligned)
-					md_wakeup_thread(conf->mddev->thread);
+			clear_bit(STRIPE_BIT_DELAY, &sh->state);
+			if (conf->stripe_workers) {
+				raid5_wakeup_stripe_thread(sh);
+				return;
 			}
+			list_add_tail(&sh->lru, &conf->handle_list);
+		}
+		md_wakeup_thread(conf->mddev->thread);
+	} else {
+		BUG_ON(stripe_operations_active(sh));
+		if (test_and_clear_bit(STRIPE_PREREAD_ACTIVE, &sh->state)) {
+			atomic_dec(&conf->preread_active_stripes);
+			if (atomic_read(&conf->preread_active_stripes) < IO_THRESHOLD)
+				md_wakeup_thread(conf->mddev->thread);
+		}
+		atomic_dec(&conf->active_stripes);
+		if (!test_bit(STRIPE_EXPANDING, &sh->state))
+			list_add_tail(&sh->lru, temp_inactive_list);
+	}
+}
+
+static void __release_stripe(raid5_conf_t *conf, struct stripe_head *sh,
+			     struct list_head *temp_inactive_list)
+{
+	if (atomic_dec_and_test(&sh->count))
+		do_release_stripe(conf, sh, temp_inactive_list);
+}
+
+/*
+ * Move stripes that __release_stripe() put on @temp_inactive_list to their
+ * inactive_list.  @hash is the group of a single list, or
+ * NR_STRIPE_HASH_LOCKS for an array of lists, one per group.  Must be
+ * called without device_lock held.
+ */
+static void release_inactive_stripe_list(raid5_conf_t *conf,
+					 struct list_head *temp_inactive_list,
+					 int hash)
+{
+	int size;
+	int do_wakeup = 0;
+	unsigned long flags;
+
+	if (hash == NR_STRIPE_HASH_LOCKS) {
+		size = NR_STRIPE_HASH_LOCKS;
+		hash = NR_STRIPE_HASH_LOCKS - 1;
+	} else
+		size = 1;
+	while (size) {
+		struct list_head *list = &temp_inactive_list[size - 1];
+
+		/*
+		 * We don't hold any lock here yet, get_active_stripe() might
+		 * remove stripes from the list
+		 */
+		if (!list_empty_careful(list)) {
+			spin_lock_irqsave(conf->hash_locks + hash, flags);
+			if (list_empty(conf->inactive_list + hash) &&
+			    !list_empty(list))
+				atomic_dec(&conf->empty_inactive_list_nr);
+			list_splice_tail_init(list, conf->inactive_list + hash);
+			do_wakeup = 1;
+			spin_unlock_irqrestore(conf->hash_locks + hash, flags);
 		}
+		size--;
+		hash--;
+	}
+
+	if (do_wakeup) {
+		wake_up(&conf->wait_for_stripe);
+		if (conf->retry_read_aligned)
+			md_wakeup_thread(conf->mddev->thread);
 	}
 }
 
@@ -233,10 +337,18 @@ static void release_stripe(struct stripe_head *sh)
 {
 	raid5_conf_t *conf = sh->raid_conf;
 	unsigned long flags;
+	struct list_head list;
+	int hash;
 
-	spin_lock_irqsave(&conf->device_lock, flags);
-	__release_stripe(conf, sh);
-	spin_unlock_irqrestore(&conf->device_lock, flags);
+	local_irq_save(flags);
+	if (atomic_dec_and_lock(&sh->count, &conf->device_lock)) {
+		INIT_LIST_HEAD(&list);
+		hash = sh->hash_lock_index;
+		do_release_stripe(conf, sh, &list);
+		spin_unlock(&conf->device_lock);
+		release_inactive_stripe_list(conf, &list, hash);
+	}
+	local_irq_restore(flags);
 }
 
 static inline void remove_hash(struct stripe_head *sh)
@@ -254,25 +366,28 @@ static inline void insert_hash(raid5_conf_t *conf, struct stripe_head *sh)
 	pr_debug("insert_hash(), stripe %llu\n",
 		(unsigned long long)sh->sector);
 
-	CHECK_DEVLOCK();
+	CHECK_HASHLOCK(sh->hash_lock_index);
 	hlist_add_head(&sh->hash, hp);
 }
 
 
 /* find an idle stripe, make sure it is unhashed, and return it. */
-static struct stripe_head *get_free_stripe(raid5_conf_t *conf)
+static struct stripe_head *get_free_stripe(raid5_conf_t *conf, int hash)
 {
 	struct stripe_head *sh = NULL;
 	struct list_head *first;
 
-	CHECK_DEVLOCK();
-	if (list_empty(&conf->inactive_list))
+	CHECK_HASHLOCK(hash);
+	if (list_empty(conf->inactive_list + hash))
 		goto out;
-	first = conf->inactive_list.next;
+	first = (conf->inactive_list + hash)->next;
 	sh = list_entry(first, struct stripe_head, lru);
 	list_del_init(first);
 	remove_hash(sh);
 	atomic_inc(&conf->active_stripes);
+	BUG_ON(hash != sh->hash_lock_index);
+	if (list_empty(conf->inactive_list + hash))
+		atomic_inc(&conf->empty_inactive_list_nr);
 out:
 	return sh;
 }
@@ -321,12 +436,13 @@ static void init_stripe(struct stripe_head *sh, sector_t sector, int previous)
 	BUG_ON(test_bit(STRIPE_HANDLE, &sh->state));
 	BUG_ON(stripe_operations_active(sh));
 
-	CHECK_DEVLOCK();
+	CHECK_HASHLOCK(sh->hash_lock_index);
 	pr_debug("init_stripe called, stripe %llu\n",
 		(unsigned long long)sh->sector);
 
 	remove_hash(sh);
 
+	sh->cpu = smp_processor_id();
 	sh->generation = conf->generation - previous;
 	sh->disks = previous ? conf->previous_raid_disks : conf->raid_disks;
 	sh->sector = sector;
@@ -357,7 +473,7 @@ static struct stripe_head *__find_stripe(raid5_conf_t *conf, sector_t sector,
 	struct stripe_head *sh;
 	struct hlist_node *hn;
 
-	CHECK_DEVLOCK();
+	CHECK_HASHLOCK(stripe_hash_locks_hash(sector));
 	pr_debug("__find_stripe, sector %llu\n", (unsigned long long)sector);
 	hlist_for_each_entry(sh, hn, stripe_hash(conf, sector), hash)
 		if (sh->sector == sector && sh->generation == generation)
@@ -441,35 +557,42 @@ get_active_stripe(raid5_conf_t *conf, sector_t sector,
 		  int previous, int noblock, int noquiesce)
 {
 	struct stripe_head *sh;
+	int hash = stripe_hash_locks_hash(sector);
+	int inc_empty_inactive_list_flag;
 
 	pr_debug("get_stripe, sector %llu\n", (unsigned long long)sector);
 
-	spin_lock_irq(&conf->device_lock);
+	spin_lock_irq(conf->hash_locks + hash);
 
 	do {
 		wait_event_lock_irq(conf->wait_for_stripe,
 				    conf->quiesce == 0 || noquiesce,
-				    conf->device_lock, /* nothing */);
+				    conf->hash_locks[hash], /* nothing */);
 		sh = __find_stripe(conf, sector, conf->generation - previous);
 		if (!sh) {
 			if (!conf->inactive_blocked)
-				sh = get_free_stripe(conf);
+				sh = get_free_stripe(conf, hash);
 			if (noblock && sh == NULL)
 				break;
 			if (!sh) {
 				conf->inactive_blocked = 1;
 				wait_event_lock_irq(conf->wait_for_stripe,
-						    !list_empty(&conf->inactive_list) &&
+						    !list_empty(conf->inactive_list + hash) &&
 						    (atomic_read(&conf->active_stripes)
 						     < (conf->max_nr_stripes *3/4)
 						     || !conf->inactive_blocked),
-						    conf->device_lock,
+						    conf->hash_locks[hash],
 						    raid5_unplug_device(conf->mddev->queue)
 					);
 				conf->inactive_blocked = 0;
 			} else
 				init_stripe(sh, sector, previous);
 		} else {
+			/*
+			 * The count only drops to zero under device_lock,
+			 * and an idle stripe may be on any of its lists.
+			 */
+			spin_lock(&conf->device_lock);
 			if (atomic_read(&sh->count)) {
 				BUG_ON(!list_empty(&sh->lru)
 				    && !test_bit(STRIPE_EXPANDING, &sh->state));
@@ -479,15 +602,21 @@ get_active_stripe(raid5_conf_t *conf, sector_t sector,
 				if (list_empty(&sh->lru) &&
 				    !test_bit(STRIPE_EXPANDING, &sh->state))
 					BUG();
+				inc_empty_inactive_list_flag =
+					!list_empty(conf->inactive_list + hash);
 				list_del_init(&sh->lru);
+				if (inc_empty_inactive_list_flag &&
+				    list_empty(conf->inactive_list + hash))
+					atomic_inc(&conf->empty_inactive_list_nr);
 			}
+			spin_unlock(&conf->device_lock);
 		}
 	} while (sh == NULL);
 
 	if (sh)
 		atomic_inc(&sh->count);
 
-	spin_unlock_irq(&conf->device_lock);
+	spin_unlock_irq(conf->hash_locks + hash);
 	return sh;
 }
 
@@ -1306,7 +1435,7 @@ static void raid_run_ops(struct stripe_head *sh, unsigned long ops_request)
 #define raid_run_ops __raid_run_ops
 #endif
 
-static int grow_one_stripe(raid5_conf_t *conf)
+static int grow_one_stripe(raid5_conf_t *conf, int hash)
 {
 	struct stripe_head *sh;
 	sh = kmem_cache_alloc(conf->slab_cache, GFP_KERNEL);
@@ -1324,6 +1453,7 @@ static int grow_one_stripe(raid5_conf_t *conf)
 		kmem_cache_free(conf->slab_cache, sh);
 		return 0;
 	}
+	sh->hash_lock_index = hash;
 	/* we just created an active stripe so... */
 	atomic_set(&sh->count, 1);
 	atomic_inc(&conf->active_stripes);
@@ -1336,6 +1466,7 @@ static int grow_stripes(raid5_conf_t *conf, int num)
 {
 	struct kmem_cache *sc;
 	int devs = max(conf->raid_disks, conf->previous_raid_disks);
+	int i;
 
 	sprintf(conf->cache_name[0],
 		"raid%d-%s", conf->level, mdname(conf->mddev));
@@ -1349,8 +1480,9 @@ static int grow_stripes(raid5_conf_t *conf, int num)
 		return 1;
 	conf->slab_cache = sc;
 	conf->pool_size = devs;
-	while (num--)
-		if (!grow_one_stripe(conf))
+	/* stripe n belongs to hash group n % NR_STRIPE_HASH_LOCKS */
+	for (i = 0; i < num; i++)
+		if (!grow_one_stripe(conf, i & STRIPE_HASH_LOCKS_MASK))
 			return 1;
 	return 0;
 }
@@ -1409,6 +1541,7 @@ static int resize_stripes(raid5_conf_t *conf, int newsize)
 	int err;
 	struct kmem_cache *sc;
 	int i;
+	int hash;
 
 	if (newsize <= conf->pool_size)
 		return 0; /* never bother to shrink */
@@ -1451,18 +1584,22 @@ static int resize_stripes(raid5_conf_t *conf, int newsize)
 	}
 	/* Step 2 - Must use GFP_NOIO now.
 	 * OK, we have enough stripes, start collecting inactive
-	 * stripes and copying them over
+	 * stripes and copying them over.  The stripes are spread over the
+	 * hash groups round robin, so collect them the same way.
 	 */
+	hash = 0;
 	list_for_each_entry(nsh, &newstripes, lru) {
-		spin_lock_irq(&conf->device_lock);
+		spin_lock_irq(conf->hash_locks + hash);
 		wait_event_lock_irq(conf->wait_for_stripe,
-				    !list_empty(&conf->inactive_list),
-				    conf->device_lock,
+				    !list_empty(conf->inactive_list + hash),
+				    conf->hash_locks[hash],
 				    unplug_slaves(conf->mddev)
 			);
-		osh = get_free_stripe(conf);
-		spin_unlock_irq(&conf->device_lock);
+		osh = get_free_stripe(conf, hash);
+		spin_unlock_irq(conf->hash_locks + hash);
 		atomic_set(&nsh->count, 1);
+		nsh->hash_lock_index = hash;
+		hash = (hash + 1) & STRIPE_HASH_LOCKS_MASK;
 		for(i=0; i<conf->pool_size; i++)
 			nsh->dev[i].page = osh->dev[i].page;
 		for( ; i<newsize; i++)
@@ -1526,13 +1663,13 @@ static int resize_stripes(raid5_conf_t *conf, int newsize)
 	return err;
 }
 
-static int drop_one_stripe(raid5_conf_t *conf)
+static int drop_one_stripe(raid5_conf_t *conf, int hash)
 {
 	struct stripe_head *sh;
 
-	spin_lock_irq(&conf->device_lock);
-	sh = get_free_stripe(conf);
-	spin_unlock_irq(&conf->device_lock);
+	spin_lock_irq(conf->hash_locks + hash);
+	sh = get_free_stripe(conf, hash);
+	spin_unlock_irq(conf->hash_locks + hash);
 	if (!sh)
 		return 0;
 	BUG_ON(atomic_read(&sh->count));
@@ -1544,8 +1681,11 @@ static int drop_one_stripe(raid5_conf_t *conf)
 
 static void shrink_stripes(raid5_conf_t *conf)
 {
-	while (drop_one_stripe(conf))
-		;
+	int hash;
+
+	for (hash = 0; hash < NR_STRIPE_HASH_LOCKS; hash++)
+		while (drop_one_stripe(conf, hash))
+			;
 
 	if (conf->slab_cache)
 		kmem_cache_destroy(conf->slab_cache);
@@ -3617,7 +3757,8 @@ static void raid5_activate_delayed(raid5_conf_t *conf)
 		blk_plug_device(conf->mddev->queue);
 }
 
-static void activate_bit_delay(raid5_conf_t *conf)
+static void activate_bit_delay(raid5_conf_t *conf,
+			       struct list_head *temp_inactive_list)
 {
 	/* device_lock is held */
 	struct list_head head;
@@ -3625,9 +3766,11 @@ static void activate_bit_delay(raid5_conf_t *conf)
 	list_del_init(&conf->bitmap_list);
 	while (!list_empty(&head)) {
 		struct stripe_head *sh = list_entry(head.next, struct stripe_head, lru);
+		int hash;
 		list_del_init(&sh->lru);
 		atomic_inc(&sh->count);
-		__release_stripe(conf, sh);
+		hash = sh->hash_lock_index;
+		__release_stripe(conf, sh, &temp_inactive_list[hash]);
 	}
 }
 
@@ -3689,7 +3832,7 @@ static int raid5_congested(void *data, int bits)
 		return 1;
 	if (conf->quiesce)
 		return 1;
-	if (list_empty_careful(&conf->inactive_list))
+	if (atomic_read(&conf->empty_inactive_list_nr))
 		return 1;
 
 	return 0;
@@ -3904,19 +4047,35 @@ static int chunk_aligned_read(mddev_t *mddev, struct bio * raid_bio)
  * stripe with in flight i/o.  The bypass_count will be reset when the
  * head of the hold_list has changed, i.e. the head was promoted to the
  * handle_list.
+ *
+ * A worker (@group set) takes stripes from its own handle_list; raid5d
+ * takes them from the array's, and then from any worker's.
  */
-static struct stripe_head *__get_priority_stripe(raid5_conf_t *conf)
+static struct stripe_head *__get_priority_stripe(raid5_conf_t *conf,
+						 struct r5worker_group *group)
 {
 	struct stripe_head *sh;
+	struct list_head *handle_list = &conf->handle_list;
+	int cpu;
+
+	if (group)
+		handle_list = &group->handle_list;
+	else if (list_empty(handle_list) && conf->stripe_workers) {
+		for_each_online_cpu(cpu) {
+			handle_list = &conf->worker_groups[cpu].handle_list;
+			if (!list_empty(handle_list))
+				break;
+		}
+	}
 
 	pr_debug("%s: handle: %s hold: %s full_writes: %d bypass_count: %d\n",
 		  __func__,
-		  list_empty(&conf->handle_list) ? "empty" : "busy",
+		  list_empty(handle_list) ? "empty" : "busy",
 		  list_empty(&conf->hold_list) ? "empty" : "busy",
 		  atomic_read(&conf->pending_full_writes), conf->bypass_count);
 
-	if (!list_empty(&conf->handle_list)) {
-		sh = list_entry(conf->handle_list.next, typeof(*sh), lru);
+	if (!list_empty(handle_list)) {
+		sh = list_entry(handle_list->next, typeof(*sh), lru);
 
 		if (list_empty(&conf->hold_list))
 			conf->bypass_count = 0;
@@ -4492,6 +4651,78 @@ static int  retry_aligned_read(raid5_conf_t *conf, struct bio *raid_bio)
 }
 
 
+/*
+ * Take up to MAX_STRIPE_BATCH stripes for raid5d (@group NULL) or a worker,
+ * handle them with device_lock dropped and release them again.  Stripes
+ * that become idle collect on @temp_inactive_list; the ones from the
+ * previous call are moved to the inactive lists while device_lock is
+ * dropped.  Called and returns with device_lock held.
+ */
+static int handle_active_stripes(raid5_conf_t *conf,
+				 struct r5worker_group *group,
+				 struct list_head *temp_inactive_list)
+{
+	struct stripe_head *batch[MAX_STRIPE_BATCH], *sh;
+	int i, batch_size = 0, hash;
+
+	while (batch_size < MAX_STRIPE_BATCH &&
+	       (sh = __get_priority_stripe(conf, group)) != NULL)
+		batch[batch_size++] = sh;
+
+	if (batch_size == 0)
+		return batch_size;
+	spin_unlock_irq(&conf->device_lock);
+
+	release_inactive_stripe_list(conf, temp_inactive_list,
+				     NR_STRIPE_HASH_LOCKS);
+
+	for (i = 0; i < batch_size; i++)
+		handle_stripe(batch[i]);
+
+	cond_resched();
+
+	spin_lock_irq(&conf->device_lock);
+	for (i = 0; i < batch_size; i++) {
+		hash = batch[i]->hash_lock_index;
+		__release_stripe(conf, batch[i], &temp_inactive_list[hash]);
+	}
+	return batch_size;
+}
+
+/*
+ * Per-CPU stripe worker, queued by raid5_wakeup_stripe_thread().
+ */
+static void raid5_do_work(struct work_struct *work)
+{
+	struct r5worker_group *group = container_of(work, struct r5worker_group,
+						    work);
+	raid5_conf_t *conf = group->conf;
+	int handled = 0, batch_size;
+
+	pr_debug("+++ raid5worker active\n");
+
+	spin_lock_irq(&conf->device_lock);
+	while (1) {
+		batch_size = handle_active_stripes(conf, group,
+						   group->temp_inactive_list);
+		if (!batch_size)
+			break;
+		handled += batch_size;
+	}
+	pr_debug("%d stripes handled\n", handled);
+
+	spin_unlock_irq(&conf->device_lock);
+
+	release_inactive_stripe_list(conf, group->temp_inactive_list,
+				     NR_STRIPE_HASH_LOCKS);
+
+	async_tx_issue_pending_all();
+	if (handled)
+		unplug_slaves(conf->mddev);
+
+	pr_debug("--- raid5worker inactive\n");
+}
+
 /*
  * This is our raid5 kernel thread.
  *
@@ -4501,9 +4732,8 @@ static int  retry_aligned_read(raid5_conf_t *conf, struct bio *raid_bio)
  */
 static void raid5d(mddev_t *mddev)
 {
-	struct stripe_head *sh;
 	raid5_conf_t *conf = mddev->private;
-	int handled;
+	int handled, batch_size;
 
 	pr_debug("+++ raid5d active\n");
 
@@ -4520,7 +4750,7 @@ static void raid5d(mddev_t *mddev)
 			bitmap_unplug(mddev->bitmap);
 			spin_lock_irq(&conf->device_lock);
 			conf->seq_write = seq;
-			activate_bit_delay(conf);
+			activate_bit_delay(conf, conf->temp_inactive_list);
 		}
 
 		while ((bio = remove_bio_from_retry(conf))) {
@@ -4533,23 +4763,19 @@ static void raid5d(mddev_t *mddev)
 			handled++;
 		}
 
-		sh = __get_priority_stripe(conf);
-
-		if (!sh)
+		batch_size = handle_active_stripes(conf, NULL,
+						   conf->temp_inactive_list);
+		if (!batch_size)
 			break;
-		spin_unlock_irq(&conf->device_lock);
-		
-		handled++;
-		handle_stripe(sh);
-		release_stripe(sh);
-		cond_resched();
-
-		spin_lock_irq(&conf->device_lock);
+		handled += batch_size;
 	}
 	pr_debug("%d stripes handled\n", handled);
 
 	spin_unlock_irq(&conf->device_lock);
 
+	release_inactive_stripe_list(conf, conf->temp_inactive_list,
+				     NR_STRIPE_HASH_LOCKS);
+
 	async_tx_issue_pending_all();
 	unplug_slaves(mddev);
 
@@ -4582,8 +4808,10 @@ raid5_store_stripe_cache_size(mddev_t *mddev, const char *page, size_t len)
 		return -EINVAL;
 	if (new <= 16 || new > 32768)
 		return -EINVAL;
+	/* the last stripe is in group (n - 1), see grow_stripes() */
 	while (new < conf->max_nr_stripes) {
-		if (drop_one_stripe(conf))
+		if (drop_one_stripe(conf, (conf->max_nr_stripes - 1) &
+				    STRIPE_HASH_LOCKS_MASK))
 			conf->max_nr_stripes--;
 		else
 			break;
@@ -4592,7 +4820,8 @@ raid5_store_stripe_cache_size(mddev_t *mddev, const char *page, size_t len)
 	if (err)
 		return err;
 	while (new > conf->max_nr_stripes) {
-		if (grow_one_stripe(conf))
+		if (grow_one_stripe(conf, conf->max_nr_stripes &
+				    STRIPE_HASH_LOCKS_MASK))
 			conf->max_nr_stripes++;
 		else break;
 	}
@@ -4651,10 +4880,55 @@ stripe_cache_active_show(mddev_t *mddev, char *page)
 static struct md_sysfs_entry
 raid5_stripecache_active = __ATTR_RO(stripe_cache_active);
 
+static ssize_t
+raid5_show_stripe_workers(mddev_t *mddev, char *page)
+{
+	raid5_conf_t *conf = mddev->private;
+	if (conf)
+		return sprintf(page, "%d\n", conf->stripe_workers);
+	else
+		return 0;
+}
+
+static ssize_t
+raid5_store_stripe_workers(mddev_t *mddev, const char *page, size_t len)
+{
+	raid5_conf_t *conf = mddev->private;
+	unsigned long new;
+	int cpu;
+
+	if (len >= PAGE_SIZE)
+		return -EINVAL;
+	if (!conf)
+		return -ENODEV;
+
+	if (strict_strtoul(page, 10, &new))
+		return -EINVAL;
+	if (new > 1)
+		return -EINVAL;
+
+	spin_lock_irq(&conf->device_lock);
+	conf->stripe_workers = new;
+	/* hand whatever the workers haven't started on to raid5d */
+	if (!new)
+		for_each_possible_cpu(cpu)
+			list_splice_tail_init(&conf->worker_groups[cpu].handle_list,
+					      &conf->handle_list);
+	spin_unlock_irq(&conf->device_lock);
+	md_wakeup_thread(mddev->thread);
+	return len;
+}
+
+static struct md_sysfs_entry
+raid5_stripe_workers = __ATTR(stripe_workers, S_IRUGO | S_IWUSR,
+			      raid5_show_stripe_workers,
+			      raid5_store_stripe_workers);
+
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
 	&raid5_preread_bypass_threshold.attr,
+	&raid5_stripe_workers.attr,
 	NULL,
 };
 static struct attribute_group raid5_attrs_group = {
@@ -4706,6 +4980,7 @@ static void free_conf(raid5_conf_t *conf)
 	raid5_free_percpu(conf);
 	kfree(conf->disks);
 	kfree(conf->stripe_hashtbl);
+	kfree(conf->worker_groups);
 	kfree(conf);
 }
 
@@ -4790,10 +5065,31 @@ static int raid5_alloc_percpu(raid5_conf_t *conf)
 	return err;
 }
 
+static int alloc_worker_groups(raid5_conf_t *conf)
+{
+	struct r5worker_group *group;
+	int cpu, i;
+
+	conf->worker_groups = kcalloc(nr_cpu_ids, sizeof(*group), GFP_KERNEL);
+	if (!conf->worker_groups)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		group = conf->worker_groups + cpu;
+		INIT_LIST_HEAD(&group->handle_list);
+		INIT_WORK(&group->work, raid5_do_work);
+		group->conf = conf;
+		for (i = 0; i < NR_STRIPE_HASH_LOCKS; i++)
+			INIT_LIST_HEAD(group->temp_inactive_list + i);
+	}
+	return 0;
+}
+
 static raid5_conf_t *setup_conf(mddev_t *mddev)
 {
 	raid5_conf_t *conf;
 	int raid_disk, memory, max_disks;
+	int i;
 	mdk_rdev_t *rdev;
 	struct disk_info *disk;
 
@@ -4836,7 +5132,12 @@ static raid5_conf_t *setup_conf(mddev_t *mddev)
 	INIT_LIST_HEAD(&conf->hold_list);
 	INIT_LIST_HEAD(&conf->delayed_list);
 	INIT_LIST_HEAD(&conf->bitmap_list);
-	INIT_LIST_HEAD(&conf->inactive_list);
+	for (i = 0; i < NR_STRIPE_HASH_LOCKS; i++) {
+		spin_lock_init(conf->hash_locks + i);
+		INIT_LIST_HEAD(conf->inactive_list + i);
+		INIT_LIST_HEAD(conf->temp_inactive_list + i);
+	}
+	atomic_set(&conf->empty_inactive_list_nr, NR_STRIPE_HASH_LOCKS);
 	atomic_set(&conf->active_stripes, 0);
 	atomic_set(&conf->preread_active_stripes, 0);
 	atomic_set(&conf->active_aligned_reads, 0);
@@ -4860,6 +5161,9 @@ static raid5_conf_t *setup_conf(mddev_t *mddev)
 	if ((conf->stripe_hashtbl = kzalloc(PAGE_SIZE, GFP_KERNEL)) == NULL)
 		goto abort;
 
+	if (alloc_worker_groups(conf))
+		goto abort;
+
 	conf->level = mddev->new_level;
 	if (raid5_alloc_percpu(conf) != 0)
 		goto abort;
@@ -5200,6 +5504,8 @@ static int stop(mddev_t *mddev)
 
 	md_unregister_thread(mddev->thread);
 	mddev->thread = NULL;
+	/* workers may still be returning stripes to the inactive lists */
+	flush_workqueue(raid5_wq);
 	mddev->queue->backing_dev_info.congested_fn = NULL;
 	blk_sync_queue(mddev->queue); /* the unplug fn references 'conf'*/
 	free_conf(conf);
@@ -5231,7 +5537,7 @@ static void printall(struct seq_file *seq, raid5_conf_t *conf)
 	struct hlist_node *hn;
 	int i;
 
-	spin_lock_irq(&conf->device_lock);
+	lock_all_device_hash_locks_irq(conf);
 	for (i = 0; i < NR_HASH; i++) {
 		hlist_for_each_entry(sh, hn, &conf->stripe_hashtbl[i], hash) {
 			if (sh->raid_conf != conf)
@@ -5239,7 +5545,7 @@ static void printall(struct seq_file *seq, raid5_conf_t *conf)
 			print_sh(seq, sh);
 		}
 	}
-	spin_unlock_irq(&conf->device_lock);
+	unlock_all_device_hash_locks_irq(conf);
 }
 #endif
 
@@ -5509,7 +5815,8 @@ static int raid5_start_reshape(mddev_t *mddev)
 	}
 
 	atomic_set(&conf->reshape_stripes, 0);
-	spin_lock_irq(&conf->device_lock);
+	/* init_stripe() reads the geometry under a hash lock only */
+	lock_all_device_hash_locks_irq(conf);
 	conf->previous_raid_disks = conf->raid_disks;
 	conf->raid_disks += mddev->delta_disks;
 	conf->prev_chunk_sectors = conf->chunk_sectors;
@@ -5522,7 +5829,7 @@ static int raid5_start_reshape(mddev_t *mddev)
 		conf->reshape_progress = 0;
 	conf->reshape_safe = conf->reshape_progress;
 	conf->generation++;
-	spin_unlock_irq(&conf->device_lock);
+	unlock_all_device_hash_locks_irq(conf);
 
 	/* Add some new drives, as many as will fit.
 	 * We know there are enough to make the newly sized array work.
@@ -5594,10 +5901,10 @@ static void end_reshape(raid5_conf_t *conf)
 
 	if (!test_bit(MD_RECOVERY_INTR, &conf->mddev->recovery)) {
 
-		spin_lock_irq(&conf->device_lock);
+		lock_all_device_hash_locks_irq(conf);
 		conf->previous_raid_disks = conf->raid_disks;
 		conf->reshape_progress = MaxSector;
-		spin_unlock_irq(&conf->device_lock);
+		unlock_all_device_hash_locks_irq(conf);
 		wake_up(&conf->wait_for_overlap);
 
 		/* read-ahead size must cover two whole stripes, which is
@@ -5663,11 +5970,14 @@ static void raid5_quiesce(mddev_t *mddev, int state)
 		break;
 
 	case 1: /* stop all writes */
-		spin_lock_irq(&conf->device_lock);
+		/* get_active_stripe() tests quiesce under a hash lock */
+		lock_all_device_hash_locks_irq(conf);
 		/* '2' tells resync/reshape to pause so that all
 		 * active stripes can drain
 		 */
 		conf->quiesce = 2;
+		unlock_all_device_hash_locks_irq(conf);
+		spin_lock_irq(&conf->device_lock);
 		wait_event_lock_irq(conf->wait_for_stripe,
 				    atomic_read(&conf->active_stripes) == 0 &&
 				    atomic_read(&conf->active_aligned_reads) == 0,
@@ -5992,6 +6302,9 @@ static struct mdk_personality raid4_personality =
 
 static int __init raid5_init(void)
 {
+	raid5_wq = create_workqueue("raid5wq");
+	if (!raid5_wq)
+		return -ENOMEM;
 	register_md_personality(&raid6_personality);
 	register_md_personality(&raid5_personality);
 	register_md_personality(&raid4_personality);
@@ -6003,6 +6316,7 @@ static void raid5_exit(void)
 	unregister_md_personality(&raid6_personality);
 	unregister_md_personality(&raid5_personality);
 	unregister_md_personality(&raid4_personality);
+	destroy_workqueue(raid5_wq);
 }
 
 module_init(raid5_init);
@@ -203,6 +203,9 @@ struct stripe_head {
 	struct raid5_private_data *raid_conf;
 	short			generation;	/* increments with every
 						 * reshape */
+	short			hash_lock_index; /* inactive_list and hash
+						  * lock this stripe uses */
+	int			cpu;		/* worker that handles it */
 	sector_t		sector;		/* sector of this row */
 	short			pd_idx;		/* parity disk index */
 	short			qd_idx;		/* 'Q' disk index for raid6 */
@@ -338,6 +341,40 @@ struct r6_state {
  * HANDLE gets cleared if stripe_handle leave nothing locked.
  */
 
+/*
+ * Locking:
+ *
+ * The stripe cache is split into NR_STRIPE_HASH_LOCKS groups by
+ * (sector >> STRIPE_SHIFT).  Each group has its own lock in hash_locks[],
+ * which protects the hash chains of that group and its inactive_list, so
+ * looking up and allocating stripes for different sectors doesn't
+ * serialise on device_lock.  Every stripe belongs to one group for its
+ * whole life (hash_lock_index).  When both are needed, a hash lock is
+ * taken before device_lock; device_lock still protects the handle, hold,
+ * delayed and bitmap lists and the worker groups' lists.
+ *
+ * Stripes released by __release_stripe() with device_lock held are put on
+ * a temporary per-group list first and moved to the inactive_list once
+ * device_lock has been dropped, see release_inactive_stripe_list().
+ *
+ * Stripe handling:
+ *
+ * With stripe_workers set, stripes that need handling are queued to a
+ * worker per CPU (the CPU that brought the stripe into the cache) rather
+ * than to raid5d, so handle_stripe() - parity computation included - runs
+ * on all CPUs at once.  raid5d keeps the preread hold_list, retried
+ * aligned reads and bitmap batching, and picks up stripes from the
+ * workers' lists when it runs.
+ */
+#define NR_STRIPE_HASH_LOCKS	8
+#define STRIPE_HASH_LOCKS_MASK	(NR_STRIPE_HASH_LOCKS - 1)
+
+struct r5worker_group {
+	struct list_head	handle_list;	/* stripes for this CPU */
+	struct work_struct	work;
+	struct raid5_private_data *conf;
+	struct list_head	temp_inactive_list[NR_STRIPE_HASH_LOCKS];
+};
 
 struct disk_info {
 	mdk_rdev_t	*rdev;
@@ -418,7 +455,10 @@ struct raid5_private_data {
 	 * Free stripes pool
 	 */
 	atomic_t		active_stripes;
-	struct list_head	inactive_list;
+	struct list_head	inactive_list[NR_STRIPE_HASH_LOCKS];
+	atomic_t		empty_inactive_list_nr;
+	/* raid5d's stripes on their way to the inactive_lists */
+	struct list_head	temp_inactive_list[NR_STRIPE_HASH_LOCKS];
 	wait_queue_head_t	wait_for_stripe;
 	wait_queue_head_t	wait_for_overlap;
 	int			inactive_blocked;	/* release of inactive stripes blocked,
@@ -426,8 +466,13 @@ struct raid5_private_data {
 							 */
 	int			pool_size; /* number of disks in stripeheads in pool */
 	spinlock_t		device_lock;
+	spinlock_t		hash_locks[NR_STRIPE_HASH_LOCKS];
 	struct disk_info	*disks;
 
+	/* per-CPU stripe handling, indexed by CPU number */
+	struct r5worker_group	*worker_groups;
+	int			stripe_workers;	/* use worker_groups */
+
 	/* When taking over an array from a different personality, we store
 	 * the new thread here until we fully activate the array.
 	 */
@@ -26,6 +26,7 @@
 #include <linux/scatterlist.h>
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
+#include <linux/interrupt.h>
 
 static int napi_weight = 128;
 module_param(napi_weight, int, 0444);
@@ -59,6 +60,9 @@ struct virtnet_info {
 	/* Work struct for refilling if we run low on memory. */
 	struct delayed_work refill;
 
+	/* Reclaims sent buffers outside of hardirq on a tx interrupt. */
+	struct tasklet_struct tx_tasklet;
+
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 
@@ -125,7 +129,7 @@ static void skb_xmit_done(struct virtqueue *svq)
 	virtqueue_disable_cb(svq);
 
 	/* We were probably waiting for more output buffers. */
-	netif_wake_queue(vi->dev);
+	tasklet_schedule(&vi->tx_tasklet);
 }
 
 static void set_skb_frag(struct sk_buff *skb, struct page *page,
@@ -495,21 +499,37 @@ again:
 	return received;
 }
 
+/* Called with the tx queue lock held. */
 static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 {
 	struct sk_buff *skb;
 	unsigned int len, tot_sgs = 0;
+	unsigned int bytes = 0, packets = 0;
 
 	while ((skb = virtqueue_get_buf(vi->svq, &len)) != NULL) {
 		pr_debug("Sent skb %p\n", skb);
-		vi->dev->stats.tx_bytes += skb->len;
-		vi->dev->stats.tx_packets++;
+		bytes += skb->len;
+		packets++;
 		tot_sgs += skb_vnet_hdr(skb)->num_sg;
 		dev_kfree_skb_any(skb);
 	}
+	vi->dev->stats.tx_bytes += bytes;
+	vi->dev->stats.tx_packets += packets;
+	netdev_completed_queue(vi->dev, packets, bytes);
 	return tot_sgs;
 }
 
+static void xmit_tasklet(unsigned long data)
+{
+	struct virtnet_info *vi = (struct virtnet_info *)data;
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev, 0);
+
+	__netif_tx_lock(txq, smp_processor_id());
+	free_old_xmit_skbs(vi);
+	netif_tx_wake_queue(txq);
+	__netif_tx_unlock(txq);
+}
+
 static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 {
 	struct skb_vnet_hdr *hdr = skb_vnet_hdr(skb);
@@ -560,6 +580,7 @@ static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, 0);
 	int capacity;
 
 	/* Free up any pending old buffers before queueing new ones. */
@@ -585,6 +606,7 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		kfree_skb(skb);
 		return NETDEV_TX_OK;
 	}
+	netdev_tx_sent_queue(txq, skb->len);
 	virtqueue_kick(vi->svq);
 
 	/* Don't wait up for transmitted skbs to be freed. */
@@ -603,6 +625,14 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 				virtqueue_disable_cb(vi->svq);
 			}
 		}
+	} else if (unlikely(netif_xmit_stopped(txq))) {
+		/* Byte queue limits stopped us; only a tx interrupt will
+		 * report the completions that restart the queue. */
+		if (unlikely(!virtqueue_enable_cb(vi->svq))) {
+			free_old_xmit_skbs(vi);
+			if (!netif_xmit_stopped(txq))
+				virtqueue_disable_cb(vi->svq);
+		}
 	}
 
 	return NETDEV_TX_OK;
@@ -941,6 +971,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 	vdev->priv = vi;
 	vi->pages = NULL;
 	INIT_DELAYED_WORK(&vi->refill, refill_work);
+	tasklet_init(&vi->tx_tasklet, xmit_tasklet, (unsigned long)vi);
 	sg_init_table(vi->rx_sg, ARRAY_SIZE(vi->rx_sg));
 	sg_init_table(vi->tx_sg, ARRAY_SIZE(vi->tx_sg));
 
@@ -997,6 +1028,7 @@ unregister:
 	unregister_netdev(dev);
 	cancel_delayed_work_sync(&vi->refill);
 free_vqs:
+	tasklet_kill(&vi->tx_tasklet);
 	vdev->config->del_vqs(vdev);
 free:
 	free_netdev(dev);
@@ -1035,6 +1067,7 @@ static void __devexit virtnet_remove(struct virtio_device *vdev)
 
 	unregister_netdev(vi->dev);
 	cancel_delayed_work_sync(&vi->refill);
+	tasklet_kill(&vi->tx_tasklet);
 
 	/* Free unused buffers in both send and recv, if any. */
 	free_unused_bufs(vi);
@@ -33,13 +33,31 @@
 #include <linux/bootmem.h>
 #include <linux/fs_struct.h>
 #include <linux/hardirq.h>
+#include <linux/rculist_bl.h>
 #include "internal.h"
 
+/*
+ * Locking, from outermost to innermost:
+ *
+ * dcache_lock
+ *   protects the tree (d_subdirs, d_child, d_alias, d_parent changes)
+ *   and keeps unreferenced dentries alive; anything that kills a dentry
+ *   or takes a reference on one with a zero count holds it
+ * dentry->d_lock
+ *   protects d_flags, d_name and d_count of a dentry that is being put;
+ *   d_seq is only written under it
+ * dcache_hash_bucket lock (bit 0 of the bucket head)
+ *   protects a hash chain against writers; readers use RCU
+ * dcache_lru_lock
+ *   protects sb->s_dentry_lru, the d_lru links and the unused counts
+ */
+
 int sysctl_vfs_cache_pressure __read_mostly = 100;
 EXPORT_SYMBOL_GPL(sysctl_vfs_cache_pressure);
 
  __cacheline_aligned_in_smp DEFINE_SPINLOCK(dcache_lock);
 __cacheline_aligned_in_smp DEFINE_SEQLOCK(rename_lock);
+static __cacheline_aligned_in_smp DEFINE_SPINLOCK(dcache_lru_lock);
 
 EXPORT_SYMBOL(dcache_lock);
 
@@ -60,7 +78,15 @@ static struct kmem_cache *dentry_cache __read_mostly;
 
 static unsigned int d_hash_mask __read_mostly;
 static unsigned int d_hash_shift __read_mostly;
-static struct hlist_head *dentry_hashtable __read_mostly;
+static struct hlist_bl_head *dentry_hashtable __read_mostly;
+
+static inline struct hlist_bl_head *d_hash(struct dentry *parent,
+					unsigned long hash)
+{
+	hash += ((unsigned long) parent ^ GOLDEN_RATIO_PRIME) / L1_CACHE_BYTES;
+	hash = hash ^ ((hash ^ GOLDEN_RATIO_PRIME) >> D_HASHBITS);
+	return dentry_hashtable + (hash & D_HASHMASK);
+}
 
 /* Statistics gathering. */
 struct dentry_stat_t dentry_stat = {
@@ -84,16 +110,32 @@ static void d_callback(struct rcu_head *head)
 /*
  * no dcache_lock, please.  The caller must decrement dentry_stat.nr_dentry
  * inside dcache_lock.
+ *
+ * A path walk in RCU mode may still be looking at the dentry, even one
+ * that was never hashed (the root of a tree, a parent), so it is always
+ * freed after a grace period.
  */
 static void d_free(struct dentry *dentry)
 {
 	if (dentry->d_op && dentry->d_op->d_release)
 		dentry->d_op->d_release(dentry);
-	/* if dentry was never inserted into hash, immediate free is OK */
-	if (hlist_unhashed(&dentry->d_hash))
-		__d_free(dentry);
-	else
-		call_rcu(&dentry->d_u.d_rcu, d_callback);
+	call_rcu(&dentry->d_u.d_rcu, d_callback);
+}
+
+/**
+ * dentry_rcuwalk_barrier - invalidate in-progress rcu-walk lookups
+ * @dentry: the target dentry
+ *
+ * After this call, in-progress rcu-walk path lookups that sampled d_seq
+ * before it will fail their sequence check.  Called under d_lock after
+ * changing something an rcu-walk reads: the hash chain, the name, the
+ * parent or d_inode.
+ */
+static inline void dentry_rcuwalk_barrier(struct dentry *dentry)
+{
+	assert_spin_locked(&dentry->d_lock);
+	write_seqcount_begin(&dentry->d_seq);
+	write_seqcount_end(&dentry->d_seq);
 }
 
 /*
@@ -108,6 +150,7 @@ static void dentry_iput(struct dentry * dentry)
 	if (inode) {
 		dentry->d_inode = NULL;
 		list_del_init(&dentry->d_alias);
+		dentry_rcuwalk_barrier(dentry);
 		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
 		if (!inode->i_nlink)
@@ -123,38 +166,58 @@ static void dentry_iput(struct dentry * dentry)
 }
 
 /*
- * dentry_lru_(add|add_tail|del|del_init) must be called with dcache_lock held.
+ * dentry_lru_(add|move_tail|del|del_init) take dcache_lru_lock, which nests
+ * inside d_lock.  dput() adds a dentry to the LRU holding only d_lock.
  */
 static void dentry_lru_add(struct dentry *dentry)
 {
-	list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-	dentry->d_sb->s_nr_dentry_unused++;
-	dentry_stat.nr_unused++;
+	spin_lock(&dcache_lru_lock);
+	if (list_empty(&dentry->d_lru)) {
+		list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
+		dentry->d_sb->s_nr_dentry_unused++;
+		dentry_stat.nr_unused++;
+	}
+	spin_unlock(&dcache_lru_lock);
+}
+
+static void dentry_lru_move_tail(struct dentry *dentry)
+{
+	spin_lock(&dcache_lru_lock);
+	if (list_empty(&dentry->d_lru)) {
+		list_add_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
+		dentry->d_sb->s_nr_dentry_unused++;
+		dentry_stat.nr_unused++;
+	} else {
+		list_move_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
+	}
+	spin_unlock(&dcache_lru_lock);
 }
 
-static void dentry_lru_add_tail(struct dentry *dentry)
+static void __dentry_lru_del_init(struct dentry *dentry)
 {
-	list_add_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-	dentry->d_sb->s_nr_dentry_unused++;
-	dentry_stat.nr_unused++;
+	if (likely(!list_empty(&dentry->d_lru))) {
+		list_del_init(&dentry->d_lru);
+		dentry->d_sb->s_nr_dentry_unused--;
+		dentry_stat.nr_unused--;
+	}
 }
 
 static void dentry_lru_del(struct dentry *dentry)
 {
+	spin_lock(&dcache_lru_lock);
 	if (!list_empty(&dentry->d_lru)) {
 		list_del(&dentry->d_lru);
 		dentry->d_sb->s_nr_dentry_unused--;
 		dentry_stat.nr_unused--;
 	}
+	spin_unlock(&dcache_lru_lock);
 }
 
 static void dentry_lru_del_init(struct dentry *dentry)
 {
-	if (likely(!list_empty(&dentry->d_lru))) {
-		list_del_init(&dentry->d_lru);
-		dentry->d_sb->s_nr_dentry_unused--;
-		dentry_stat.nr_unused--;
-	}
+	spin_lock(&dcache_lru_lock);
+	__dentry_lru_del_init(dentry);
+	spin_unlock(&dcache_lru_lock);
 }
 
 /**
@@ -220,6 +283,28 @@ void dput(struct dentry *dentry)
 repeat:
 	if (atomic_read(&dentry->d_count) == 1)
 		might_sleep();
+	if (atomic_add_unless(&dentry->d_count, -1, 1))
+		return;
+
+	/*
+	 * Dropping what is likely the last reference.  A hashed dentry
+	 * without ->d_delete() just goes on the LRU; holding d_lock keeps
+	 * it from being unhashed or killed meanwhile, so that does not
+	 * need dcache_lock.
+	 */
+	if (!(dentry->d_op && dentry->d_op->d_delete)) {
+		spin_lock(&dentry->d_lock);
+		if (!d_unhashed(dentry)) {
+			if (atomic_dec_and_test(&dentry->d_count)) {
+				dentry->d_flags |= DCACHE_REFERENCED;
+				dentry_lru_add(dentry);
+			}
+			spin_unlock(&dentry->d_lock);
+			return;
+		}
+		spin_unlock(&dentry->d_lock);
+	}
+
 	if (!atomic_dec_and_lock(&dentry->d_count, &dcache_lock))
 		return;
 
@@ -240,10 +325,8 @@ repeat:
 	/* Unreachable? Get rid of it */
  	if (d_unhashed(dentry))
 		goto kill_it;
-  	if (list_empty(&dentry->d_lru)) {
-  		dentry->d_flags |= DCACHE_REFERENCED;
-		dentry_lru_add(dentry);
-  	}
+	dentry->d_flags |= DCACHE_REFERENCED;
+	dentry_lru_add(dentry);
  	spin_unlock(&dentry->d_lock);
 	spin_unlock(&dcache_lock);
 	return;
@@ -470,6 +553,7 @@ static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
 		/* called from prune_dcache() and shrink_dcache_parent() */
 		cnt = *count;
 restart:
+	spin_lock(&dcache_lru_lock);
 	if (count == NULL)
 		list_splice_init(&sb->s_dentry_lru, &tmp);
 	else {
@@ -478,7 +562,13 @@ restart:
 					struct dentry, d_lru);
 			BUG_ON(dentry->d_sb != sb);
 
-			spin_lock(&dentry->d_lock);
+			/* d_lock nests outside dcache_lru_lock */
+			if (!spin_trylock(&dentry->d_lock)) {
+				spin_unlock(&dcache_lru_lock);
+				cpu_relax();
+				spin_lock(&dcache_lru_lock);
+				continue;
+			}
 			/*
 			 * If we are honouring the DCACHE_REFERENCED flag and
 			 * the dentry has this flag set, don't free it. Clear
@@ -496,13 +586,23 @@ restart:
 				if (!cnt)
 					break;
 			}
-			cond_resched_lock(&dcache_lock);
+			if (need_resched() || spin_needbreak(&dcache_lock)) {
+				spin_unlock(&dcache_lru_lock);
+				cond_resched_lock(&dcache_lock);
+				spin_lock(&dcache_lru_lock);
+			}
 		}
 	}
 	while (!list_empty(&tmp)) {
 		dentry = list_entry(tmp.prev, struct dentry, d_lru);
-		dentry_lru_del_init(dentry);
-		spin_lock(&dentry->d_lock);
+		if (!spin_trylock(&dentry->d_lock)) {
+			spin_unlock(&dcache_lru_lock);
+			cpu_relax();
+			spin_lock(&dcache_lru_lock);
+			continue;
+		}
+		__dentry_lru_del_init(dentry);
+		spin_unlock(&dcache_lru_lock);
 		/*
 		 * We found an inuse dentry which was not removed from
 		 * the LRU because of laziness during lookup.  Do not free
@@ -510,18 +610,23 @@ restart:
 		 */
 		if (atomic_read(&dentry->d_count)) {
 			spin_unlock(&dentry->d_lock);
+			spin_lock(&dcache_lru_lock);
 			continue;
 		}
 		prune_one_dentry(dentry);
 		/* dentry->d_lock was dropped in prune_one_dentry() */
 		cond_resched_lock(&dcache_lock);
+		spin_lock(&dcache_lru_lock);
 	}
-	if (count == NULL && !list_empty(&sb->s_dentry_lru))
+	if (count == NULL && !list_empty(&sb->s_dentry_lru)) {
+		spin_unlock(&dcache_lru_lock);
 		goto restart;
+	}
 	if (count != NULL)
 		*count = cnt;
 	if (!list_empty(&referenced))
 		list_splice(&referenced, &sb->s_dentry_lru);
+	spin_unlock(&dcache_lru_lock);
 	spin_unlock(&dcache_lock);
 }
 
@@ -631,7 +736,9 @@ static void shrink_dcache_for_umount_subtree(struct dentry *dentry)
 	/* detach this root from the system */
 	spin_lock(&dcache_lock);
 	dentry_lru_del_init(dentry);
+	spin_lock(&dentry->d_lock);
 	__d_drop(dentry);
+	spin_unlock(&dentry->d_lock);
 	spin_unlock(&dcache_lock);
 
 	for (;;) {
@@ -645,7 +752,9 @@ static void shrink_dcache_for_umount_subtree(struct dentry *dentry)
 			list_for_each_entry(loop, &dentry->d_subdirs,
 					    d_u.d_child) {
 				dentry_lru_del_init(loop);
+				spin_lock(&loop->d_lock);
 				__d_drop(loop);
+				spin_unlock(&loop->d_lock);
 				cond_resched_lock(&dcache_lock);
 			}
 			spin_unlock(&dcache_lock);
@@ -740,8 +849,9 @@ void shrink_dcache_for_umount(struct super_block *sb)
 	atomic_dec(&dentry->d_count);
 	shrink_dcache_for_umount_subtree(dentry);
 
-	while (!hlist_empty(&sb->s_anon)) {
-		dentry = hlist_entry(sb->s_anon.first, struct dentry, d_hash);
+	while (!hlist_bl_empty(&sb->s_anon)) {
+		dentry = hlist_bl_entry(hlist_bl_first(&sb->s_anon),
+					struct dentry, d_hash);
 		shrink_dcache_for_umount_subtree(dentry);
 	}
 }
@@ -828,15 +938,18 @@ resume:
 		struct dentry *dentry = list_entry(tmp, struct dentry, d_u.d_child);
 		next = tmp->next;
 
-		dentry_lru_del_init(dentry);
 		/* 
 		 * move only zero ref count dentries to the end 
 		 * of the unused list for prune_dcache
 		 */
+		spin_lock(&dentry->d_lock);
 		if (!atomic_read(&dentry->d_count)) {
-			dentry_lru_add_tail(dentry);
+			dentry_lru_move_tail(dentry);
 			found++;
+		} else {
+			dentry_lru_del_init(dentry);
 		}
+		spin_unlock(&dentry->d_lock);
 
 		/*
 		 * We can return to the caller if we have found some (this
@@ -955,7 +1068,8 @@ struct dentry *d_alloc(struct dentry * parent, const struct qstr *name)
 	dentry->d_op = NULL;
 	dentry->d_fsdata = NULL;
 	dentry->d_mounted = 0;
-	INIT_HLIST_NODE(&dentry->d_hash);
+	seqcount_init(&dentry->d_seq);
+	INIT_HLIST_BL_NODE(&dentry->d_hash);
 	INIT_LIST_HEAD(&dentry->d_lru);
 	INIT_LIST_HEAD(&dentry->d_subdirs);
 	INIT_LIST_HEAD(&dentry->d_alias);
@@ -991,9 +1105,12 @@ EXPORT_SYMBOL(d_alloc_name);
 /* the caller must hold dcache_lock */
 static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 {
+	spin_lock(&dentry->d_lock);
 	if (inode)
 		list_add(&dentry->d_alias, &inode->i_dentry);
 	dentry->d_inode = inode;
+	dentry_rcuwalk_barrier(dentry);
+	spin_unlock(&dentry->d_lock);
 	fsnotify_d_instantiate(dentry, inode);
 }
 
@@ -1119,14 +1236,6 @@ struct dentry * d_alloc_root(struct inode * root_inode)
 }
 EXPORT_SYMBOL(d_alloc_root);
 
-static inline struct hlist_head *d_hash(struct dentry *parent,
-					unsigned long hash)
-{
-	hash += ((unsigned long) parent ^ GOLDEN_RATIO_PRIME) / L1_CACHE_BYTES;
-	hash = hash ^ ((hash ^ GOLDEN_RATIO_PRIME) >> D_HASHBITS);
-	return dentry_hashtable + (hash & D_HASHMASK);
-}
-
 /**
  * d_obtain_alias - find or allocate a dentry for a given inode
  * @inode: inode to allocate the dentry for
@@ -1182,7 +1291,9 @@ struct dentry *d_obtain_alias(struct inode *inode)
 	tmp->d_flags |= DCACHE_DISCONNECTED;
 	tmp->d_flags &= ~DCACHE_UNHASHED;
 	list_add(&tmp->d_alias, &inode->i_dentry);
-	hlist_add_head(&tmp->d_hash, &inode->i_sb->s_anon);
+	hlist_bl_lock(&tmp->d_sb->s_anon);
+	hlist_bl_add_head(&tmp->d_hash, &tmp->d_sb->s_anon);
+	hlist_bl_unlock(&tmp->d_sb->s_anon);
 	spin_unlock(&tmp->d_lock);
 
 	spin_unlock(&dcache_lock);
@@ -1375,14 +1486,14 @@ struct dentry * __d_lookup(struct dentry * parent, struct qstr * name)
 	unsigned int len = name->len;
 	unsigned int hash = name->hash;
 	const unsigned char *str = name->name;
-	struct hlist_head *head = d_hash(parent,hash);
+	struct hlist_bl_head *b = d_hash(parent, hash);
 	struct dentry *found = NULL;
-	struct hlist_node *node;
+	struct hlist_bl_node *node;
 	struct dentry *dentry;
 
 	rcu_read_lock();
 	
-	hlist_for_each_entry_rcu(dentry, node, head, d_hash) {
+	hlist_bl_for_each_entry_rcu(dentry, node, b, d_hash) {
 		struct qstr *qstr;
 
 		if (dentry->d_name.hash != hash)
@@ -1431,6 +1542,62 @@ next:
  	return found;
 }
 
+/**
+ * __d_lookup_rcu - search for a dentry without taking a reference
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ * @seq: returns the d_seq of the dentry found
+ *
+ * For the RCU mode path walk: the caller holds rcu_read_lock() and has
+ * sampled @parent's d_seq, which it must check again after this returns.
+ * No reference is taken on the dentry found, so anything the caller reads
+ * from it is only good if d_seq still equals *@seq afterwards.
+ *
+ * The name is compared against a snapshot of d_name that the sequence
+ * count says is consistent, so a concurrent d_move() cannot make us read
+ * past the end of a name.  A d_move() to another chain can make us miss
+ * the dentry; the caller then falls back to the locked lookup, which is
+ * serialised against renames by rename_lock.
+ *
+ * Returns NULL if nothing matched, or if @parent has its own ->d_compare(),
+ * which is not safe to call here.
+ */
+struct dentry *__d_lookup_rcu(struct dentry *parent, struct qstr *name,
+			      unsigned *seq)
+{
+	unsigned int len = name->len;
+	unsigned int hash = name->hash;
+	const unsigned char *str = name->name;
+	struct hlist_bl_head *b = d_hash(parent, hash);
+	struct hlist_bl_node *node;
+	struct dentry *dentry;
+
+	if (unlikely(parent->d_op && parent->d_op->d_compare))
+		return NULL;
+
+	hlist_bl_for_each_entry_rcu(dentry, node, b, d_hash) {
+		const unsigned char *tname;
+		unsigned int tlen;
+
+		if (dentry->d_name.hash != hash)
+			continue;
+seqretry:
+		*seq = read_seqcount_begin(&dentry->d_seq);
+		if (dentry->d_parent != parent)
+			continue;
+		if (d_unhashed(dentry))
+			continue;
+		tlen = dentry->d_name.len;
+		tname = dentry->d_name.name;
+		if (read_seqcount_retry(&dentry->d_seq, *seq))
+			goto seqretry;
+		if (tlen != len || memcmp(tname, str, len))
+			continue;
+		return dentry;
+	}
+	return NULL;
+}
+
 /**
  * d_hash_and_lookup - hash the qstr then search for a dentry
  * @dir: Directory to search in
@@ -1469,8 +1636,9 @@ out:
  
 int d_validate(struct dentry *dentry, struct dentry *dparent)
 {
-	struct hlist_head *base;
-	struct hlist_node *lhp;
+	struct hlist_bl_head *b;
+	struct hlist_bl_node *node;
+	struct dentry *d;
 
 	/* Check whether the ptr might be valid at all.. */
 	if (!kmem_ptr_validate(dentry_cache, dentry))
@@ -1480,17 +1648,17 @@ int d_validate(struct dentry *dentry, struct dentry *dparent)
 		goto out;
 
 	spin_lock(&dcache_lock);
-	base = d_hash(dparent, dentry->d_name.hash);
-	hlist_for_each(lhp,base) { 
-		/* hlist_for_each_entry_rcu() not required for d_hash list
-		 * as it is parsed under dcache_lock
-		 */
-		if (dentry == hlist_entry(lhp, struct dentry, d_hash)) {
+	b = d_hash(dparent, dentry->d_name.hash);
+	hlist_bl_lock(b);
+	hlist_bl_for_each_entry(d, node, b, d_hash) {
+		if (dentry == d) {
 			__dget_locked(dentry);
+			hlist_bl_unlock(b);
 			spin_unlock(&dcache_lock);
 			return 1;
 		}
 	}
+	hlist_bl_unlock(b);
 	spin_unlock(&dcache_lock);
 out:
 	return 0;
@@ -1544,11 +1712,39 @@ void d_delete(struct dentry * dentry)
 }
 EXPORT_SYMBOL(d_delete);
 
-static void __d_rehash(struct dentry * entry, struct hlist_head *list)
+/**
+ * __d_drop - unhash a dentry
+ * @dentry: dentry to unhash
+ *
+ * See d_drop().  The caller must hold dentry->d_lock.  Takes the lock of
+ * the hash bucket the dentry is on: its parent's chain, or the
+ * superblock's list of anonymous dentries for a disconnected root.
+ */
+void __d_drop(struct dentry *dentry)
 {
+	if (!(dentry->d_flags & DCACHE_UNHASHED)) {
+		struct hlist_bl_head *b;
+
+		if (unlikely(IS_ROOT(dentry)))
+			b = &dentry->d_sb->s_anon;
+		else
+			b = d_hash(dentry->d_parent, dentry->d_name.hash);
+
+		hlist_bl_lock(b);
+		dentry->d_flags |= DCACHE_UNHASHED;
+		hlist_bl_del_rcu(&dentry->d_hash);
+		hlist_bl_unlock(b);
+		dentry_rcuwalk_barrier(dentry);
+	}
+}
+EXPORT_SYMBOL(__d_drop);
 
+static void __d_rehash(struct dentry * entry, struct hlist_bl_head *b)
+{
+	hlist_bl_lock(b);
  	entry->d_flags &= ~DCACHE_UNHASHED;
- 	hlist_add_head_rcu(&entry->d_hash, list);
+ 	hlist_bl_add_head_rcu(&entry->d_hash, b);
+	hlist_bl_unlock(b);
 }
 
 static void _d_rehash(struct dentry * entry)
@@ -1565,11 +1761,9 @@ static void _d_rehash(struct dentry * entry)
  
 void d_rehash(struct dentry * entry)
 {
-	spin_lock(&dcache_lock);
 	spin_lock(&entry->d_lock);
 	_d_rehash(entry);
 	spin_unlock(&entry->d_lock);
-	spin_unlock(&dcache_lock);
 }
 EXPORT_SYMBOL(d_rehash);
 
@@ -1647,8 +1841,6 @@ static void switch_names(struct dentry *dentry, struct dentry *target)
  */
 static void d_move_locked(struct dentry * dentry, struct dentry * target)
 {
-	struct hlist_head *list;
-
 	if (!dentry->d_inode)
 		printk(KERN_WARNING "VFS: moving negative dcache entry\n");
 
@@ -1664,15 +1856,12 @@ static void d_move_locked(struct dentry * dentry, struct dentry * target)
 		spin_lock_nested(&target->d_lock, DENTRY_D_LOCK_NESTED);
 	}
 
-	/* Move the dentry to the target hash queue, if on different bucket */
-	if (d_unhashed(dentry))
-		goto already_unhashed;
-
-	hlist_del_rcu(&dentry->d_hash);
+	write_seqcount_begin(&dentry->d_seq);
+	write_seqcount_begin(&target->d_seq);
 
-already_unhashed:
-	list = d_hash(target->d_parent, target->d_name.hash);
-	__d_rehash(dentry, list);
+	/* Move the dentry to the target hash queue */
+	__d_drop(dentry);
+	__d_rehash(dentry, d_hash(target->d_parent, target->d_name.hash));
 
 	/* Unhash the target: dput() will then get rid of it */
 	__d_drop(target);
@@ -1697,6 +1886,10 @@ already_unhashed:
 	}
 
 	list_add(&dentry->d_u.d_child, &dentry->d_parent->d_subdirs);
+
+	write_seqcount_end(&target->d_seq);
+	write_seqcount_end(&dentry->d_seq);
+
 	spin_unlock(&target->d_lock);
 	fsnotify_d_move(dentry);
 	spin_unlock(&dentry->d_lock);
@@ -1847,8 +2040,11 @@ struct dentry *d_materialise_unique(struct dentry *dentry, struct inode *inode)
 			 * into our tree? */
 			if (IS_ROOT(alias)) {
 				spin_lock(&alias->d_lock);
-				__d_materialise_dentry(dentry, alias);
+				/* off s_anon while it is still a root */
 				__d_drop(alias);
+				write_seqcount_begin(&alias->d_seq);
+				__d_materialise_dentry(dentry, alias);
+				write_seqcount_end(&alias->d_seq);
 				goto found;
 			}
 			/* Nope, but we must(!) avoid directory aliasing */
@@ -2295,7 +2491,7 @@ static void __init dcache_init_early(void)
 
 	dentry_hashtable =
 		alloc_large_system_hash("Dentry cache",
-					sizeof(struct hlist_head),
+					sizeof(struct hlist_bl_head),
 					dhash_entries,
 					13,
 					HASH_EARLY,
@@ -2304,7 +2500,7 @@ static void __init dcache_init_early(void)
 					0);
 
 	for (loop = 0; loop < (1 << d_hash_shift); loop++)
-		INIT_HLIST_HEAD(&dentry_hashtable[loop]);
+		INIT_HLIST_BL_HEAD(&dentry_hashtable[loop]);
 }
 
 static void __init dcache_init(void)
@@ -2327,7 +2523,7 @@ static void __init dcache_init(void)
 
 	dentry_hashtable =
 		alloc_large_system_hash("Dentry cache",
-					sizeof(struct hlist_head),
+					sizeof(struct hlist_bl_head),
 					dhash_entries,
 					13,
 					0,
@@ -2336,7 +2532,7 @@ static void __init dcache_init(void)
 					0);
 
 	for (loop = 0; loop < (1 << d_hash_shift); loop++)
-		INIT_HLIST_HEAD(&dentry_hashtable[loop]);
+		INIT_HLIST_BL_HEAD(&dentry_hashtable[loop]);
 }
 
 /* SLAB cache for __getname() consumers */
@@ -464,7 +464,8 @@ void ext4_add_groupblocks(handle_t *handle, struct super_block *sb,
 	 * request to reload the buddy with the
 	 * new bitmap information
 	 */
-	set_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state));
+	if (!test_and_set_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state)))
+		atomic_inc(&sbi->s_mb_uninit_groups);
 	grp->bb_free += blocks_freed;
 	up_write(&grp->alloc_sem);
 
@@ -151,6 +151,15 @@ struct ext4_map_blocks {
 	unsigned int m_flags;
 };
 
+/*
+ * Bio being built by ext4_bio_write_page()
+ */
+struct ext4_io_submit {
+	int			io_op;
+	struct bio		*io_bio;
+	sector_t		io_next_block;
+};
+
 /*
  * For delayed allocation tracking
  */
@@ -164,6 +173,7 @@ struct mpage_da_data {
 	int io_done;
 	int pages_written;
 	int retval;
+	struct ext4_io_submit io_submit;
 };
 #define	EXT4_IO_UNWRITTEN	0x1
 typedef struct ext4_io_end {
@@ -883,6 +893,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_INIT_INODE_TABLE	0x4000000 /* Zero unused itables */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1103,6 +1114,17 @@ struct ext4_sb_info {
 	unsigned short *s_mb_offsets;
 	unsigned int *s_mb_maxs;
 
+	/*
+	 * Initialized groups indexed by the order of their largest free
+	 * extent and of their average free extent size, so the allocator
+	 * can go straight to a group that fits a request.
+	 */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
+	struct list_head *s_mb_avg_fragment_size;
+	rwlock_t *s_mb_avg_fragment_size_locks;
+	atomic_t s_mb_uninit_groups;	/* groups not in the indexes yet */
+
 	/* tunables */
 	unsigned long s_stripe;
 	unsigned int s_mb_stream_request;
@@ -1111,6 +1133,7 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_optimize_scan;
 	unsigned int s_max_writeback_mb_bump;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1125,6 +1148,9 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_groups_considered;	/* groups checked for fit */
+	atomic_t s_bal_groups_scanned;	/* groups whose buddy was scanned */
+	atomic_t s_bal_index_hits;	/* groups picked from the indexes */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -1145,6 +1171,29 @@ struct ext4_sb_info {
 
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
+
+	/* lazy inode table initialization */
+	struct ext4_li_request *s_li_request;
+	unsigned int s_li_wait_mult;
+};
+
+/*
+ * Lazy inode table initialization: one ext4lazyinit thread serves the
+ * requests of all mounted filesystems that have inode tables left to
+ * zero.
+ */
+struct ext4_lazy_init {
+	struct list_head	li_request_list;
+	struct mutex		li_list_mtx;
+};
+
+struct ext4_li_request {
+	struct super_block	*lr_super;
+	struct ext4_sb_info	*lr_sbi;
+	ext4_group_t		lr_next_group;
+	struct list_head	lr_request;
+	unsigned long		lr_next_sched;	/* jiffies of next run */
+	unsigned long		lr_timeout;	/* sleep between groups */
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1322,6 +1371,14 @@ EXT4_INODE_BIT_FNS(state, state_flags)
 #define EXT4_DEF_MIN_BATCH_TIME	0
 #define EXT4_DEF_MAX_BATCH_TIME	15000 /* 15ms */
 
+/*
+ * Lazy inode table initialization: sleep this many times as long as
+ * zeroing the last group took, and spread out the first run of every
+ * filesystem over this many seconds.
+ */
+#define EXT4_DEF_LI_WAIT_MULT		10
+#define EXT4_DEF_LI_MAX_START_DELAY	5
+
 /*
  * Minimum number of groups in a flexgroup before we separate out
  * directories into the first block group of a flexgroup
@@ -1540,6 +1597,8 @@ extern unsigned ext4_init_inode_bitmap(struct super_block *sb,
 				       ext4_group_t group,
 				       struct ext4_group_desc *desc);
 extern void mark_bitmap_end(int start_bit, int end_bit, char *bitmap);
+extern int ext4_init_inode_table(struct super_block *sb,
+				 ext4_group_t group);
 
 /* mballoc.c */
 extern long ext4_mb_stats;
@@ -1802,7 +1861,12 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_grpblk_t	bb_avg_fragment_size_order;	/* order of average
+							 * free extent size */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	struct		list_head bb_largest_free_order_node;
+	struct		list_head bb_avg_fragment_size_node;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -1917,6 +1981,11 @@ extern int ext4_move_extents(struct file *o_filp, struct file *d_filp,
 			     __u64 start_orig, __u64 start_donor,
 			     __u64 len, __u64 *moved_len);
 
+/* page-io.c */
+extern void ext4_io_submit(struct ext4_io_submit *io);
+extern int ext4_bio_write_page(struct ext4_io_submit *io,
+			       struct page *page, int len);
+
 
 /* BH_Uninit flag: blocks are allocated but uninitialized on disk */
 enum ext4_state_bits {
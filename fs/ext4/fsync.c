@@ -66,7 +66,8 @@ static void ext4_sync_parent(struct inode *inode)
  * state in the journalling system.
  *
  * What we do is just kick off a commit and wait on it.  This will snapshot the
- * inode to disk.
+ * inode to disk.  Other processes fsync()ing at the same time get a short
+ * window to join the commit first, see jbd2_log_batch_sync().
  *
  * i_mutex lock is held when entering and exiting this function
  */
@@ -115,6 +116,7 @@ int ext4_sync_file(struct file *file, int datasync)
 		return ext4_force_commit(inode->i_sb);
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+	jbd2_log_batch_sync(journal, commit_tid);
 	if (jbd2_log_start_commit(journal, commit_tid)) {
 		/*
 		 * When the journal is on a different device than the
@@ -129,7 +131,7 @@ int ext4_sync_file(struct file *file, int datasync)
 		    (journal->j_flags & JBD2_BARRIER))
 			blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
 					NULL, BLKDEV_IFL_WAIT);
-		ret = jbd2_log_wait_commit(journal, commit_tid);
+		ret = jbd2_log_wait_stable(journal, commit_tid);
 	} else if (journal->j_flags & JBD2_BARRIER)
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
@@ -1967,7 +1967,17 @@ static void ext4_da_page_release_reservation(struct page *page,
  * to be allocated. this may be wrong if allocation failed.
  *
  * As pages are already locked by write_cache_pages(), we can't use it
+ *
+ * Pages whose buffers are all mapped are added to bios that span as
+ * many contiguous blocks as possible, the rest go through writepage(),
+ * which redirties what is still not allocated.
  */
+static int ext4_bh_needs_writepage(handle_t *handle, struct buffer_head *bh)
+{
+	return buffer_delay(bh) || buffer_unwritten(bh) || buffer_uninit(bh) ||
+		(buffer_dirty(bh) && !buffer_mapped(bh));
+}
+
 static int mpage_da_submit_io(struct mpage_da_data *mpd)
 {
 	long pages_skipped;
@@ -1976,6 +1986,8 @@ static int mpage_da_submit_io(struct mpage_da_data *mpd)
 	int ret = 0, err, nr_pages, i;
 	struct inode *inode = mpd->inode;
 	struct address_space *mapping = inode->i_mapping;
+	loff_t size = i_size_read(inode);
+	unsigned int len;
 
 	BUG_ON(mpd->next_page <= mpd->first_page);
 	/*
@@ -2003,6 +2015,26 @@ static int mpage_da_submit_io(struct mpage_da_data *mpd)
 			BUG_ON(!PageLocked(page));
 			BUG_ON(PageWriteback(page));
 
+			if (page->index == size >> PAGE_CACHE_SHIFT)
+				len = size & ~PAGE_CACHE_MASK;
+			else
+				len = PAGE_CACHE_SIZE;
+
+			if (page_has_buffers(page) && len &&
+			    page->index <= size >> PAGE_CACHE_SHIFT &&
+			    !ext4_should_dioread_nolock(inode) &&
+			    !walk_page_buffers(NULL, page_buffers(page), 0,
+					       len, NULL,
+					       ext4_bh_needs_writepage)) {
+				err = ext4_bio_write_page(&mpd->io_submit,
+							  page, len);
+				if (!err)
+					mpd->pages_written++;
+				if (ret == 0)
+					ret = err;
+				continue;
+			}
+
 			pages_skipped = mpd->wbc->pages_skipped;
 			err = mapping->a_ops->writepage(page, mpd->wbc);
 			if (!err && (pages_skipped == mpd->wbc->pages_skipped))
@@ -2021,6 +2053,7 @@ static int mpage_da_submit_io(struct mpage_da_data *mpd)
 		}
 		pagevec_release(&pvec);
 	}
+	ext4_io_submit(&mpd->io_submit);
 	return ret;
 }
 
@@ -2173,6 +2206,7 @@ static int mpage_da_map_blocks(struct mpage_da_data *mpd)
 	struct ext4_map_blocks map;
 	sector_t next = mpd->b_blocknr;
 	unsigned max_blocks = mpd->b_size >> mpd->inode->i_blkbits;
+	unsigned mapped = 0;
 	loff_t disksize = EXT4_I(mpd->inode)->i_disksize;
 	handle_t *handle = NULL;
 
@@ -2211,71 +2245,97 @@ static int mpage_da_map_blocks(struct mpage_da_data *mpd)
 	 * EXT4_GET_BLOCKS_DELALLOC_RESERVE so the delalloc accounting
 	 * variables are updated after the blocks have been allocated.
 	 */
-	map.m_lblk = next;
-	map.m_len = max_blocks;
 	get_blocks_flags = EXT4_GET_BLOCKS_CREATE;
 	if (ext4_should_dioread_nolock(mpd->inode))
 		get_blocks_flags |= EXT4_GET_BLOCKS_IO_CREATE_EXT;
 	if (mpd->b_state & (1 << BH_Delay))
 		get_blocks_flags |= EXT4_GET_BLOCKS_DELALLOC_RESERVE;
 
-	blks = ext4_map_blocks(handle, mpd->inode, &map, get_blocks_flags);
-	if (blks < 0) {
-		err = blks;
-		/*
-		 * If get block returns with error we simply
-		 * return. Later writepage will redirty the page and
-		 * writepages will find the dirty page again
-		 */
-		if (err == -EAGAIN)
-			return 0;
+	/*
+	 * The allocator may hand out less than the whole extent, so keep
+	 * mapping until all of it is done, as long as the handle has the
+	 * credits for one more chunk.  What we do not get to here stays
+	 * delayed, and writepage() redirties its pages.
+	 */
+	while (mapped < max_blocks) {
+		if (mapped) {
+			int needed = ext4_chunk_trans_blocks(mpd->inode,
+							     max_blocks - mapped);
 
-		if (err == -ENOSPC &&
-		    ext4_count_free_blocks(mpd->inode->i_sb)) {
-			mpd->retval = err;
-			return 0;
+			if (!ext4_handle_has_enough_credits(handle, needed) &&
+			    ext4_journal_extend(handle, needed))
+				break;
 		}
 
-		/*
-		 * get block failure will cause us to loop in
-		 * writepages, because a_ops->writepage won't be able
-		 * to make progress. The page will be redirtied by
-		 * writepage and writepages will again try to write
-		 * the same.
-		 */
-		ext4_msg(mpd->inode->i_sb, KERN_CRIT,
-			 "delayed block allocation failed for inode %lu at "
-			 "logical offset %llu with max blocks %zd with "
-			 "error %d", mpd->inode->i_ino,
-			 (unsigned long long) next,
-			 mpd->b_size >> mpd->inode->i_blkbits, err);
-		printk(KERN_CRIT "This should not happen!!  "
-		       "Data will be lost\n");
-		if (err == -ENOSPC) {
-			ext4_print_free_blocks(mpd->inode);
+		map.m_lblk = next + mapped;
+		map.m_len = max_blocks - mapped;
+		blks = ext4_map_blocks(handle, mpd->inode, &map,
+				       get_blocks_flags);
+		if (blks < 0) {
+			err = blks;
+			/*
+			 * Keep what we mapped so far, the remaining pages
+			 * are redirtied and found again by writepages.
+			 */
+			if (mapped)
+				break;
+			/*
+			 * If get block returns with error we simply
+			 * return. Later writepage will redirty the page and
+			 * writepages will find the dirty page again
+			 */
+			if (err == -EAGAIN)
+				return 0;
+
+			if (err == -ENOSPC &&
+			    ext4_count_free_blocks(mpd->inode->i_sb)) {
+				mpd->retval = err;
+				return 0;
+			}
+
+			/*
+			 * get block failure will cause us to loop in
+			 * writepages, because a_ops->writepage won't be able
+			 * to make progress. The page will be redirtied by
+			 * writepage and writepages will again try to write
+			 * the same.
+			 */
+			ext4_msg(mpd->inode->i_sb, KERN_CRIT,
+				 "delayed block allocation failed for inode %lu at "
+				 "logical offset %llu with max blocks %zd with "
+				 "error %d", mpd->inode->i_ino,
+				 (unsigned long long) next,
+				 mpd->b_size >> mpd->inode->i_blkbits, err);
+			printk(KERN_CRIT "This should not happen!!  "
+			       "Data will be lost\n");
+			if (err == -ENOSPC) {
+				ext4_print_free_blocks(mpd->inode);
+			}
+			/* invalidate all the pages */
+			ext4_da_block_invalidatepages(mpd, next,
+					mpd->b_size >> mpd->inode->i_blkbits);
+			return err;
 		}
-		/* invalidate all the pages */
-		ext4_da_block_invalidatepages(mpd, next,
-				mpd->b_size >> mpd->inode->i_blkbits);
-		return err;
-	}
-	BUG_ON(blks == 0);
+		BUG_ON(blks == 0);
 
-	if (map.m_flags & EXT4_MAP_NEW) {
-		struct block_device *bdev = mpd->inode->i_sb->s_bdev;
-		int i;
+		if (map.m_flags & EXT4_MAP_NEW) {
+			struct block_device *bdev = mpd->inode->i_sb->s_bdev;
+			int i;
 
-		for (i = 0; i < map.m_len; i++)
-			unmap_underlying_metadata(bdev, map.m_pblk + i);
-	}
+			for (i = 0; i < map.m_len; i++)
+				unmap_underlying_metadata(bdev, map.m_pblk + i);
+		}
 
-	/*
-	 * If blocks are delayed marked, we need to
-	 * put actual blocknr and drop delayed bit
-	 */
-	if ((mpd->b_state & (1 << BH_Delay)) ||
-	    (mpd->b_state & (1 << BH_Unwritten)))
-		mpage_put_bnr_to_bhs(mpd, &map);
+		/*
+		 * If blocks are delayed marked, we need to
+		 * put actual blocknr and drop delayed bit
+		 */
+		if ((mpd->b_state & (1 << BH_Delay)) ||
+		    (mpd->b_state & (1 << BH_Unwritten)))
+			mpage_put_bnr_to_bhs(mpd, &map);
+
+		mapped += blks;
+	}
 
 	if (ext4_should_order_data(mpd->inode)) {
 		err = ext4_jbd2_file_inode(handle, mpd->inode);
@@ -2286,7 +2346,7 @@ static int mpage_da_map_blocks(struct mpage_da_data *mpd)
 	/*
 	 * Update on-disk size along with block allocation.
 	 */
-	disksize = ((loff_t) next + blks) << mpd->inode->i_blkbits;
+	disksize = ((loff_t) next + mapped) << mpd->inode->i_blkbits;
 	if (disksize > i_size_read(mpd->inode))
 		disksize = i_size_read(mpd->inode);
 	if (disksize > EXT4_I(mpd->inode)->i_disksize) {
@@ -2317,12 +2377,12 @@ static void mpage_add_bh_to_extent(struct mpage_da_data *mpd,
 	int nrblocks = mpd->b_size >> mpd->inode->i_blkbits;
 
 	/*
-	 * XXX Don't go larger than mballoc is willing to allocate
-	 * This is a stopgap solution.  We eventually need to fold
-	 * mpage_da_submit_io() into this function and then call
-	 * ext4_get_blocks() multiple times in a loop
+	 * mpage_da_map_blocks() maps the extent in as many calls to
+	 * ext4_map_blocks() as it takes, so the extent is only bounded
+	 * by how much we want to write out of one inode in one go.
 	 */
-	if (nrblocks >= 8*1024*1024/mpd->inode->i_sb->s_blocksize)
+	if (nrblocks >= EXT4_SB(mpd->inode->i_sb)->s_max_writeback_mb_bump <<
+			(20 - mpd->inode->i_blkbits))
 		goto flush_it;
 
 	/* check if thereserved journal credits might overflow */
@@ -2991,6 +3051,9 @@ static int ext4_da_writepages(struct address_space *mapping,
 
 	mpd.wbc = wbc;
 	mpd.inode = mapping->host;
+	mpd.io_submit.io_bio = NULL;
+	mpd.io_submit.io_op = (wbc->sync_mode == WB_SYNC_ALL) ?
+		WRITE_SYNC_PLUG : WRITE;
 
 	pages_skipped = wbc->pages_skipped;
 
@@ -660,23 +660,73 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the matching s_mb_largest_free_orders list.
+ * Called with the group locked.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
+	int new_order = -1;
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new_order = i;
 			break;
 		}
 	}
+
+	if (new_order == grp->bb_largest_free_order)
+		return;
+
+	if (grp->bb_largest_free_order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[
+					grp->bb_largest_free_order]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[
+					grp->bb_largest_free_order]);
+	}
+	grp->bb_largest_free_order = new_order;
+	if (new_order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[new_order]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new_order]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[new_order]);
+	}
+}
+
+/*
+ * Groups are kept on the s_mb_avg_fragment_size list of order
+ * log2(bb_free / bb_fragments).  Called with the group locked.
+ */
+static void
+mb_update_avg_fragment_size(struct super_block *sb, struct ext4_group_info *grp)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int new_order = -1;
+
+	if (grp->bb_free && grp->bb_fragments)
+		new_order = min_t(int, fls(grp->bb_free / grp->bb_fragments) - 1,
+				  MB_NUM_ORDERS(sb) - 1);
+
+	if (new_order == grp->bb_avg_fragment_size_order)
+		return;
+
+	if (grp->bb_avg_fragment_size_order >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[
+					grp->bb_avg_fragment_size_order]);
+		list_del_init(&grp->bb_avg_fragment_size_node);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[
+					grp->bb_avg_fragment_size_order]);
+	}
+	grp->bb_avg_fragment_size_order = new_order;
+	if (new_order >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[new_order]);
+		list_add_tail(&grp->bb_avg_fragment_size_node,
+			      &sbi->s_mb_avg_fragment_size[new_order]);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[new_order]);
+	}
 }
 
 static noinline_for_stack
@@ -722,8 +772,10 @@ void ext4_mb_generate_buddy(struct super_block *sb,
 		grp->bb_free = free;
 	}
 	mb_set_largest_free_order(sb, grp);
+	mb_update_avg_fragment_size(sb, grp);
 
-	clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state));
+	if (test_and_clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state)))
+		atomic_dec(&EXT4_SB(sb)->s_mb_uninit_groups);
 
 	period = get_cycles() - period;
 	spin_lock(&EXT4_SB(sb)->s_bal_lock);
@@ -1337,6 +1389,7 @@ static void mb_free_blocks(struct inode *inode, struct ext4_buddy *e4b,
 		} while (1);
 	}
 	mb_set_largest_free_order(sb, e4b->bd_info);
+	mb_update_avg_fragment_size(sb, e4b->bd_info);
 	mb_check_buddy(e4b);
 }
 
@@ -1466,6 +1519,7 @@ static int mb_mark_used(struct ext4_buddy *e4b, struct ext4_free_extent *ex)
 		e4b->bd_info->bb_counters[ord]++;
 	}
 	mb_set_largest_free_order(e4b->bd_sb, e4b->bd_info);
+	mb_update_avg_fragment_size(e4b->bd_sb, e4b->bd_info);
 
 	mb_set_bits(EXT4_MB_BITMAP(e4b), ex->fe_start, len0);
 	mb_check_buddy(e4b);
@@ -1860,8 +1914,12 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	}
 }
 
-/* This is now called BEFORE we load the buddy bitmap. */
-static int ext4_mb_good_group(struct ext4_allocation_context *ac,
+/*
+ * Check whether an initialized group may satisfy the request at
+ * criteria @cr.  Doesn't sleep, so it can be used while walking the
+ * free extent indexes.
+ */
+static int __ext4_mb_good_group(struct ext4_allocation_context *ac,
 				ext4_group_t group, int cr)
 {
 	unsigned free, fragments;
@@ -1870,12 +1928,9 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 
 	BUG_ON(cr < 0 || cr >= 4);
 
-	/* We only do this if the grp has never been initialized */
-	if (unlikely(EXT4_MB_GRP_NEED_INIT(grp))) {
-		int ret = ext4_mb_init_group(ac->ac_sb, group);
-		if (ret)
-			return 0;
-	}
+	ac->ac_groups_considered++;
+	if (unlikely(EXT4_MB_GRP_NEED_INIT(grp)))
+		return 0;
 
 	free = grp->bb_free;
 	fragments = grp->bb_fragments;
@@ -1915,6 +1970,103 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/* This is now called BEFORE we load the buddy bitmap. */
+static int ext4_mb_good_group(struct ext4_allocation_context *ac,
+				ext4_group_t group, int cr)
+{
+	struct ext4_group_info *grp = ext4_get_group_info(ac->ac_sb, group);
+
+	/* We only do this if the grp has never been initialized */
+	if (unlikely(EXT4_MB_GRP_NEED_INIT(grp))) {
+		int ret = ext4_mb_init_group(ac->ac_sb, group);
+		if (ret)
+			return 0;
+	}
+
+	return __ext4_mb_good_group(ac, group, cr);
+}
+
+/*
+ * Walk the index lists from @order up and return the first group that
+ * is good for criteria @cr, or NULL.  The group found is moved to the
+ * tail of its list, so that the next search starts with a different
+ * one.
+ */
+static struct ext4_group_info *
+ext4_mb_find_group_index(struct ext4_allocation_context *ac,
+			 struct list_head *lists, rwlock_t *locks,
+			 int order, ext4_group_t ngroups, int cr)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_group_info *grp;
+	struct list_head *pos;
+
+	for (; order < MB_NUM_ORDERS(sb); order++) {
+		if (list_empty(&lists[order]))
+			continue;
+		write_lock(&locks[order]);
+		list_for_each(pos, &lists[order]) {
+			if (cr == 0)
+				grp = list_entry(pos, struct ext4_group_info,
+						 bb_largest_free_order_node);
+			else
+				grp = list_entry(pos, struct ext4_group_info,
+						 bb_avg_fragment_size_node);
+			if (grp->bb_group >= ngroups ||
+			    !__ext4_mb_good_group(ac, grp->bb_group, cr))
+				continue;
+			list_move_tail(pos, &lists[order]);
+			write_unlock(&locks[order]);
+			return grp;
+		}
+		write_unlock(&locks[order]);
+	}
+	return NULL;
+}
+
+/*
+ * Choose the group to scan after *group at criteria *new_cr.  Criteria 0
+ * looks for a group whose largest free extent is at least 2^ac_2order
+ * blocks, criteria 1 for a group whose average free extent is at least
+ * the goal length; both find it through the per-order indexes instead
+ * of trying every group in turn.  When the indexes have nothing left,
+ * move on to the next criteria, unless there are groups which were
+ * never initialized and so aren't indexed: those still need the linear
+ * scan.  Criteria 2 and 3 always scan linearly.
+ */
+static void ext4_mb_choose_next_group(struct ext4_allocation_context *ac,
+		int *new_cr, ext4_group_t *group, ext4_group_t ngroups)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct ext4_group_info *grp = NULL;
+
+	if (*new_cr < 2 && sbi->s_mb_optimize_scan && !ac->ac_scan_linear) {
+		if (*new_cr == 0)
+			grp = ext4_mb_find_group_index(ac,
+				sbi->s_mb_largest_free_orders,
+				sbi->s_mb_largest_free_orders_locks,
+				ac->ac_2order, ngroups, 0);
+		else
+			grp = ext4_mb_find_group_index(ac,
+				sbi->s_mb_avg_fragment_size,
+				sbi->s_mb_avg_fragment_size_locks,
+				fls(ac->ac_g_ex.fe_len) - 1, ngroups, 1);
+		if (grp) {
+			atomic_inc(&sbi->s_bal_index_hits);
+			*group = grp->bb_group;
+			return;
+		}
+		if (!atomic_read(&sbi->s_mb_uninit_groups)) {
+			(*new_cr)++;
+			return;
+		}
+		ac->ac_scan_linear = 1;
+	}
+
+	if (++*group >= ngroups)
+		*group = 0;
+}
+
 /*
  * lock the group_info alloc_sem of all the groups
  * belonging to the same buddy cache page. This
@@ -1997,7 +2149,7 @@ static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
-	int cr;
+	int cr, new_cr;
 	int err = 0;
 	int bsbits;
 	struct ext4_sb_info *sbi;
@@ -2061,14 +2213,20 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
 		ac->ac_criteria = cr;
+		ac->ac_scan_linear = 0;
 		/*
 		 * searching for the right group start
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
 
-		for (i = 0; i < ngroups; group++, i++) {
-			if (group == ngroups)
+		for (i = 0, new_cr = cr; i < ngroups; i++,
+		     ext4_mb_choose_next_group(ac, &new_cr, &group, ngroups)) {
+			if (new_cr != cr) {
+				cr = new_cr;
+				goto repeat;
+			}
+			if (group >= ngroups)
 				group = 0;
 
 			/* This now checks without needing the buddy page */
@@ -2236,6 +2394,58 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_stats_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned reqs = atomic_read(&sbi->s_bal_reqs);
+
+	seq_printf(seq, "mballoc:\n");
+	if (!sbi->s_mb_stats) {
+		seq_printf(seq, "\tmb stats collection turned off.\n");
+		seq_printf(seq, "\tTo enable, echo 1 > /sys/fs/ext4/%s/mb_stats\n",
+			   sb->s_id);
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", reqs);
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tblocks: %u\n", atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+	seq_printf(seq, "\tgroups_considered: %u\n",
+		   atomic_read(&sbi->s_bal_groups_considered));
+	seq_printf(seq, "\tgroups_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_groups_scanned));
+	seq_printf(seq, "\tindex_hits: %u\n",
+		   atomic_read(&sbi->s_bal_index_hits));
+	if (reqs)
+		seq_printf(seq, "\tgroups_scanned_per_req: %u.%02u\n",
+			   atomic_read(&sbi->s_bal_groups_scanned) / reqs,
+			   atomic_read(&sbi->s_bal_groups_scanned) % reqs *
+			   100 / reqs);
+	seq_printf(seq, "\tuninit_groups: %u\n",
+		   atomic_read(&sbi->s_mb_uninit_groups));
+	seq_printf(seq, "\toptimize_scan: %u\n", sbi->s_mb_optimize_scan);
+	return 0;
+}
+
+static int ext4_mb_seq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_stats_show, PDE(inode)->data);
+}
+
+static const struct file_operations ext4_mb_seq_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 
 /* Create and initialize ext4_group_info data for the given group. */
 int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
@@ -2282,6 +2492,7 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 	set_bit(EXT4_GROUP_INFO_NEED_INIT_BIT,
 		&(meta_group_info[i]->bb_state));
+	atomic_inc(&sbi->s_mb_uninit_groups);
 
 	/*
 	 * initialize bb_free to be able to skip
@@ -2299,6 +2510,10 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_avg_fragment_size_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_avg_fragment_size_node);
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2402,6 +2617,47 @@ err_freesgi:
 	return -ENOMEM;
 }
 
+static void ext4_mb_free_indexes(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	kfree(sbi->s_mb_avg_fragment_size);
+	kfree(sbi->s_mb_avg_fragment_size_locks);
+}
+
+static int ext4_mb_init_indexes(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int i, n = MB_NUM_ORDERS(sb);
+
+	sbi->s_mb_largest_free_orders =
+		kmalloc(n * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc(n * sizeof(rwlock_t), GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size =
+		kmalloc(n * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size_locks =
+		kmalloc(n * sizeof(rwlock_t), GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks ||
+	    !sbi->s_mb_avg_fragment_size ||
+	    !sbi->s_mb_avg_fragment_size_locks) {
+		ext4_mb_free_indexes(sb);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+		INIT_LIST_HEAD(&sbi->s_mb_avg_fragment_size[i]);
+		rwlock_init(&sbi->s_mb_avg_fragment_size_locks[i]);
+	}
+	atomic_set(&sbi->s_mb_uninit_groups, 0);
+	return 0;
+}
+
 int ext4_mb_init(struct super_block *sb, int needs_recovery)
 {
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
@@ -2439,9 +2695,17 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		i++;
 	} while (i <= sb->s_blocksize_bits + 1);
 
+	ret = ext4_mb_init_indexes(sb);
+	if (ret != 0) {
+		kfree(sbi->s_mb_offsets);
+		kfree(sbi->s_mb_maxs);
+		return ret;
+	}
+
 	/* init file for buddy data */
 	ret = ext4_mb_init_backend(sb);
 	if (ret != 0) {
+		ext4_mb_free_indexes(sb);
 		kfree(sbi->s_mb_offsets);
 		kfree(sbi->s_mb_maxs);
 		return ret;
@@ -2456,9 +2720,11 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
+		ext4_mb_free_indexes(sb);
 		kfree(sbi->s_mb_offsets);
 		kfree(sbi->s_mb_maxs);
 		return -ENOMEM;
@@ -2472,9 +2738,12 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_stats_fops, sb);
+	}
 
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
@@ -2525,6 +2794,7 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		kfree(sbi->s_group_info);
 	}
+	ext4_mb_free_indexes(sb);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	if (sbi->s_buddy_cache)
@@ -2543,6 +2813,12 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_bal_2orders),
 				atomic_read(&sbi->s_bal_breaks),
 				atomic_read(&sbi->s_mb_lost_chunks));
+		printk(KERN_INFO
+		       "EXT4-fs: mballoc: %u groups scanned, %u considered, "
+				"%u index hits\n",
+				atomic_read(&sbi->s_bal_groups_scanned),
+				atomic_read(&sbi->s_bal_groups_considered),
+				atomic_read(&sbi->s_bal_index_hits));
 		printk(KERN_INFO
 		       "EXT4-fs: mballoc: %lu generated and it took %Lu\n",
 				sbi->s_mb_buddies_generated++,
@@ -2554,8 +2830,10 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		remove_proc_entry("mb_groups", sbi->s_proc);
+		remove_proc_entry("mb_stats", sbi->s_proc);
+	}
 
 	return 0;
 }
@@ -3039,6 +3317,9 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 			atomic_inc(&sbi->s_bal_goals);
 		if (ac->ac_found > sbi->s_mb_max_to_scan)
 			atomic_inc(&sbi->s_bal_breaks);
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
+		atomic_add(ac->ac_groups_considered,
+			   &sbi->s_bal_groups_considered);
 	}
 
 	if (ac->ac_op == EXT4_MB_HISTORY_ALLOC)
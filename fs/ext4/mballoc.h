@@ -94,6 +94,17 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * pick groups for criteria 0 and 1 from the free extent indexes
+ * instead of scanning them in order
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/*
+ * number of orders the free extent indexes have, same as bb_counters
+ */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -180,6 +191,7 @@ struct ext4_allocation_context {
 
 	/* number of iterations done. we have to track to limit searching */
 	unsigned long ac_ex_scanned;
+	unsigned int ac_groups_considered;
 	__u16 ac_groups_scanned;
 	__u16 ac_found;
 	__u16 ac_tail;
@@ -188,6 +200,7 @@ struct ext4_allocation_context {
 	__u8 ac_status;
 	__u8 ac_criteria;
 	__u8 ac_repeats;
+	__u8 ac_scan_linear;	/* free extent indexes are exhausted */
 	__u8 ac_2order;		/* if request is to allocate 2^N blocks and
 				 * N > 0, the field stores N, otherwise 0 */
 	__u8 ac_op;		/* operation, for history only */
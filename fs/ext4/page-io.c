@@ -0,0 +1,161 @@
+/*
+ *  linux/fs/ext4/page-io.c
+ *
+ * Bio-based page writeout for delayed allocation writeback.
+ *
+ * Instead of submitting every buffer head on its own and leaving it to
+ * the block layer to merge them again, build bios that cover as many
+ * physically contiguous blocks as the device takes, across pages.
+ * Completion goes through the buffers' end_buffer_async_write(), so
+ * page writeback state is handled exactly as for block_write_full_page().
+ */
+
+#include <linux/fs.h>
+#include <linux/time.h>
+#include <linux/highuid.h>
+#include <linux/pagemap.h>
+#include <linux/quotaops.h>
+#include <linux/string.h>
+#include <linux/buffer_head.h>
+#include <linux/writeback.h>
+#include <linux/mpage.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include "ext4.h"
+
+static void ext4_end_bio(struct bio *bio, int error)
+{
+	int uptodate = test_bit(BIO_UPTODATE, &bio->bi_flags) && !error;
+	struct bio_vec *bvec;
+	int i;
+
+	for (i = 0, bvec = bio->bi_io_vec; i < bio->bi_vcnt; i++, bvec++) {
+		struct buffer_head *bh, *next;
+		unsigned start = bvec->bv_offset;
+		unsigned end = start + bvec->bv_len;
+		unsigned offset = 0;
+
+		/*
+		 * bio_add_page() merges the buffers of a page we added one
+		 * by one, so one bio_vec may cover several of them.  Find
+		 * them all before completing any: once the last buffer of
+		 * the page completes, the page may go away under us.
+		 */
+		bh = page_buffers(bvec->bv_page);
+		while (offset < start) {
+			offset += bh->b_size;
+			bh = bh->b_this_page;
+		}
+		while (offset < end) {
+			next = bh->b_this_page;
+			offset += bh->b_size;
+			bh->b_end_io(bh, uptodate);
+			bh = next;
+		}
+	}
+	bio_put(bio);
+}
+
+void ext4_io_submit(struct ext4_io_submit *io)
+{
+	if (io->io_bio) {
+		submit_bio(io->io_op, io->io_bio);
+		io->io_bio = NULL;
+	}
+}
+
+static void io_submit_init(struct ext4_io_submit *io, struct buffer_head *bh)
+{
+	struct bio *bio;
+	int nvecs = bio_get_nr_vecs(bh->b_bdev);
+
+	/* bio_alloc() with __GFP_WAIT never fails */
+	bio = bio_alloc(GFP_NOIO, min(nvecs, BIO_MAX_PAGES));
+	bio->bi_sector = bh->b_blocknr * (bh->b_size >> 9);
+	bio->bi_bdev = bh->b_bdev;
+	bio->bi_end_io = ext4_end_bio;
+	io->io_bio = bio;
+	io->io_next_block = bh->b_blocknr;
+}
+
+static void io_submit_add_bh(struct ext4_io_submit *io, struct page *page,
+			     struct buffer_head *bh)
+{
+	if (io->io_bio && bh->b_blocknr != io->io_next_block)
+		ext4_io_submit(io);
+	if (!io->io_bio)
+		io_submit_init(io, bh);
+	while (bio_add_page(io->io_bio, page, bh->b_size,
+			    bh_offset(bh)) != bh->b_size) {
+		ext4_io_submit(io);
+		io_submit_init(io, bh);
+	}
+	io->io_next_block = bh->b_blocknr + 1;
+}
+
+/*
+ * Write out the dirty buffers of a locked page whose blocks within the
+ * first @len bytes are all mapped, adding them to the bio being built
+ * in @io.  The page is unlocked on return; the caller has to call
+ * ext4_io_submit() once it is done adding pages.
+ */
+int ext4_bio_write_page(struct ext4_io_submit *io, struct page *page,
+			int len)
+{
+	struct buffer_head *bh, *head;
+	unsigned block_start = 0;
+	int nr_to_submit = 0;
+
+	BUG_ON(!PageLocked(page));
+	BUG_ON(PageWriteback(page));
+
+	/*
+	 * The page straddles i_size: zero the part beyond it, as mmap
+	 * may have written there, and don't write that part out.
+	 */
+	if (len < PAGE_CACHE_SIZE)
+		zero_user_segment(page, len, PAGE_CACHE_SIZE);
+
+	bh = head = page_buffers(page);
+	do {
+		if (block_start >= len) {
+			clear_buffer_dirty(bh);
+			set_buffer_uptodate(bh);
+		} else if (buffer_mapped(bh) && buffer_dirty(bh)) {
+			lock_buffer(bh);
+			if (test_clear_buffer_dirty(bh)) {
+				mark_buffer_async_write(bh);
+				nr_to_submit++;
+			} else
+				unlock_buffer(bh);
+		}
+		block_start += bh->b_size;
+	} while ((bh = bh->b_this_page) != head);
+
+	set_page_writeback(page);
+	ClearPageError(page);
+
+	if (nr_to_submit) {
+		do {
+			if (buffer_async_write(bh))
+				io_submit_add_bh(io, page, bh);
+		} while ((bh = bh->b_this_page) != head);
+	}
+	unlock_page(page);
+
+	/* Nothing was dirty after all: we are done with the page */
+	if (!nr_to_submit) {
+		int uptodate = 1;
+
+		do {
+			if (!buffer_uptodate(bh)) {
+				uptodate = 0;
+				break;
+			}
+		} while ((bh = bh->b_this_page) != head);
+		if (uptodate)
+			SetPageUptodate(page);
+		end_page_writeback(page);
+	}
+	return 0;
+}
@@ -39,6 +39,8 @@
 #include <linux/ctype.h>
 #include <linux/log2.h>
 #include <linux/crc16.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <asm/uaccess.h>
 
 #include "ext4.h"
@@ -52,6 +54,8 @@
 
 struct proc_dir_entry *ext4_proc_root;
 static struct kset *ext4_kset;
+static struct ext4_lazy_init *ext4_li_info;
+static DEFINE_MUTEX(ext4_li_mtx);
 
 static int ext4_load_journal(struct super_block *, struct ext4_super_block *,
 			     unsigned long journal_devnum);
@@ -68,6 +72,7 @@ static int ext4_statfs(struct dentry *dentry, struct kstatfs *buf);
 static int ext4_unfreeze(struct super_block *sb);
 static void ext4_write_super(struct super_block *sb);
 static int ext4_freeze(struct super_block *sb);
+static void ext4_unregister_li_request(struct super_block *sb);
 static int ext4_get_sb(struct file_system_type *fs_type, int flags,
 		       const char *dev_name, void *data, struct vfsmount *mnt);
 
@@ -646,6 +651,7 @@ static void ext4_put_super(struct super_block *sb)
 	struct ext4_super_block *es = sbi->s_es;
 	int i, err;
 
+	ext4_unregister_li_request(sb);
 	dquot_disable(sb, -1, DQUOT_USAGE_ENABLED | DQUOT_LIMITS_ENABLED);
 
 	flush_workqueue(sbi->dio_unwritten_wq);
@@ -770,6 +776,13 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void ext4_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(ext4_inode_cachep, EXT4_I(inode));
+}
+
 static void ext4_destroy_inode(struct inode *inode)
 {
 	if (!list_empty(&(EXT4_I(inode)->i_orphan))) {
@@ -781,7 +794,7 @@ static void ext4_destroy_inode(struct inode *inode)
 				true);
 		dump_stack();
 	}
-	kmem_cache_free(ext4_inode_cachep, EXT4_I(inode));
+	call_rcu(&inode->i_rcu, ext4_i_callback);
 }
 
 static void init_once(void *foo)
@@ -986,6 +999,11 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DIOREAD_NOLOCK))
 		seq_puts(seq, ",dioread_nolock");
 
+	if (!test_opt(sb, INIT_INODE_TABLE))
+		seq_puts(seq, ",noinit_itable");
+	else if (sbi->s_li_wait_mult != EXT4_DEF_LI_WAIT_MULT)
+		seq_printf(seq, ",init_itable=%u", sbi->s_li_wait_mult);
+
 	ext4_show_quota_options(seq, sb);
 
 	return 0;
@@ -1161,6 +1179,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard,
+	Opt_init_inode_table, Opt_noinit_inode_table,
 };
 
 static const match_table_t tokens = {
@@ -1231,6 +1250,9 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_init_inode_table, "init_itable=%u"},
+	{Opt_init_inode_table, "init_itable"},
+	{Opt_noinit_inode_table, "noinit_itable"},
 	{Opt_err, NULL},
 };
 
@@ -1699,6 +1721,20 @@ set_qf_format:
 		case Opt_dioread_lock:
 			clear_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
+		case Opt_init_inode_table:
+			set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			if (args[0].from) {
+				if (match_int(&args[0], &option))
+					return 0;
+			} else
+				option = EXT4_DEF_LI_WAIT_MULT;
+			if (option < 0)
+				return 0;
+			sbi->s_li_wait_mult = option;
+			break;
+		case Opt_noinit_inode_table:
+			clear_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			break;
 		default:
 			ext4_msg(sb, KERN_ERR,
 			       "Unrecognized mount option \"%s\" "
@@ -2330,6 +2366,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_optimize_scan, s_mb_optimize_scan);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2344,6 +2381,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_optimize_scan),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -2431,6 +2469,227 @@ static int ext4_feature_set_ok(struct super_block *sb, int readonly)
 	return 1;
 }
 
+/*
+ * Lazy inode table initialization.
+ *
+ * mke2fs -E lazy_itable_init leaves the inode tables of the groups
+ * flagged EXT4_BG_INODE_UNINIT as they were on the disk, which is fine
+ * until e2fsck trusts a stale inode it finds there.  The ext4lazyinit
+ * thread zeroes them after mount, one group at a time.  After each
+ * group it sleeps s_li_wait_mult times as long as zeroing that group
+ * took, so it backs off when the device is busy.
+ */
+static void ext4_remove_li_request(struct ext4_li_request *elr)
+{
+	if (!elr)
+		return;
+
+	list_del(&elr->lr_request);
+	elr->lr_sbi->s_li_request = NULL;
+	kfree(elr);
+}
+
+static void ext4_unregister_li_request(struct super_block *sb)
+{
+	mutex_lock(&ext4_li_mtx);
+	if (!ext4_li_info) {
+		mutex_unlock(&ext4_li_mtx);
+		return;
+	}
+
+	mutex_lock(&ext4_li_info->li_list_mtx);
+	ext4_remove_li_request(EXT4_SB(sb)->s_li_request);
+	mutex_unlock(&ext4_li_info->li_list_mtx);
+	mutex_unlock(&ext4_li_mtx);
+}
+
+/*
+ * Zero the next group of the request.  Returns non-zero once there is
+ * nothing left to do for the request, or on error.
+ */
+static int ext4_run_li_request(struct ext4_li_request *elr)
+{
+	struct super_block *sb = elr->lr_super;
+	ext4_group_t group, ngroups = ext4_get_groups_count(sb);
+	struct ext4_group_desc *gdp;
+	unsigned long start;
+	int ret;
+
+	for (group = elr->lr_next_group; group < ngroups; group++) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp)
+			return 1;
+		if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			break;
+	}
+	if (group == ngroups)
+		return 1;
+
+	start = jiffies;
+	ret = ext4_init_inode_table(sb, group);
+	elr->lr_timeout = (jiffies - start) * elr->lr_sbi->s_li_wait_mult;
+	elr->lr_next_sched = jiffies + elr->lr_timeout;
+	elr->lr_next_group = group + 1;
+
+	return ret;
+}
+
+/*
+ * The thread runs as long as there are requests, then frees
+ * ext4_li_info and exits; the next filesystem that needs it starts a
+ * new one.  It holds a reference to the module while it runs.
+ */
+static int ext4_lazyinit_thread(void *arg)
+{
+	struct ext4_lazy_init *eli = arg;
+	struct ext4_li_request *elr, *n;
+	unsigned long next_wakeup, cur;
+
+	set_freezable();
+cont_thread:
+	while (true) {
+		next_wakeup = MAX_JIFFY_OFFSET;
+
+		mutex_lock(&eli->li_list_mtx);
+		if (list_empty(&eli->li_request_list)) {
+			mutex_unlock(&eli->li_list_mtx);
+			break;
+		}
+
+		list_for_each_entry_safe(elr, n, &eli->li_request_list,
+					 lr_request) {
+			if (time_after_eq(jiffies, elr->lr_next_sched) &&
+			    ext4_run_li_request(elr)) {
+				/* done or error, drop the request */
+				ext4_remove_li_request(elr);
+				continue;
+			}
+			if (time_before(elr->lr_next_sched, next_wakeup))
+				next_wakeup = elr->lr_next_sched;
+		}
+		mutex_unlock(&eli->li_list_mtx);
+
+		try_to_freeze();
+
+		cur = jiffies;
+		if (time_after_eq(cur, next_wakeup) ||
+		    next_wakeup == MAX_JIFFY_OFFSET) {
+			cond_resched();
+			continue;
+		}
+		schedule_timeout_interruptible(next_wakeup - cur);
+	}
+
+	/*
+	 * Recheck under ext4_li_mtx: a filesystem being mounted right now
+	 * may just have added a request, counting on us to run it.
+	 */
+	mutex_lock(&ext4_li_mtx);
+	mutex_lock(&eli->li_list_mtx);
+	if (!list_empty(&eli->li_request_list)) {
+		mutex_unlock(&eli->li_list_mtx);
+		mutex_unlock(&ext4_li_mtx);
+		goto cont_thread;
+	}
+	mutex_unlock(&eli->li_list_mtx);
+	kfree(ext4_li_info);
+	ext4_li_info = NULL;
+	mutex_unlock(&ext4_li_mtx);
+
+	module_put_and_exit(0);
+	return 0;
+}
+
+/* Called with ext4_li_mtx held */
+static int ext4_li_info_new(void)
+{
+	struct ext4_lazy_init *eli;
+	struct task_struct *task;
+
+	eli = kzalloc(sizeof(*eli), GFP_KERNEL);
+	if (!eli)
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&eli->li_request_list);
+	mutex_init(&eli->li_list_mtx);
+
+	__module_get(THIS_MODULE);
+	task = kthread_run(ext4_lazyinit_thread, eli, "ext4lazyinit");
+	if (IS_ERR(task)) {
+		module_put(THIS_MODULE);
+		kfree(eli);
+		printk(KERN_CRIT "EXT4: error %ld creating inode table "
+		       "initialization thread\n", PTR_ERR(task));
+		return PTR_ERR(task);
+	}
+	ext4_li_info = eli;
+	return 0;
+}
+
+/* First group whose inode table is not zeroed yet */
+static ext4_group_t ext4_has_uninit_itable(struct super_block *sb)
+{
+	ext4_group_t group, ngroups = ext4_get_groups_count(sb);
+	struct ext4_group_desc *gdp;
+
+	for (group = 0; group < ngroups; group++) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp)
+			continue;
+		if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			break;
+	}
+	return group;
+}
+
+static int ext4_register_li_request(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_li_request *elr;
+	ext4_group_t first_not_zeroed;
+	int ret = 0;
+
+	if (sbi->s_li_request != NULL)
+		return 0;
+
+	/* Without uninit_bg, bg_flags and bg_itable_unused mean nothing */
+	if ((sb->s_flags & MS_RDONLY) ||
+	    !test_opt(sb, INIT_INODE_TABLE) ||
+	    !EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_GDT_CSUM))
+		return 0;
+
+	first_not_zeroed = ext4_has_uninit_itable(sb);
+	if (first_not_zeroed == ext4_get_groups_count(sb))
+		return 0;
+
+	elr = kzalloc(sizeof(*elr), GFP_KERNEL);
+	if (!elr)
+		return -ENOMEM;
+
+	elr->lr_super = sb;
+	elr->lr_sbi = sbi;
+	elr->lr_next_group = first_not_zeroed;
+	/* don't have all filesystems mounted at boot start at once */
+	elr->lr_next_sched = jiffies + (random32() %
+				(EXT4_DEF_LI_MAX_START_DELAY * HZ));
+
+	mutex_lock(&ext4_li_mtx);
+	if (!ext4_li_info) {
+		ret = ext4_li_info_new();
+		if (ret)
+			goto out;
+	}
+	mutex_lock(&ext4_li_info->li_list_mtx);
+	list_add(&elr->lr_request, &ext4_li_info->li_request_list);
+	sbi->s_li_request = elr;
+	mutex_unlock(&ext4_li_info->li_list_mtx);
+	elr = NULL;
+out:
+	mutex_unlock(&ext4_li_mtx);
+	kfree(elr);
+	return ret;
+}
+
 static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				__releases(kernel_lock)
 				__acquires(kernel_lock)
@@ -2554,6 +2813,8 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	sbi->s_max_batch_time = EXT4_DEF_MAX_BATCH_TIME;
 
 	set_opt(sbi->s_mount_opt, BARRIER);
+	set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+	sbi->s_li_wait_mult = EXT4_DEF_LI_WAIT_MULT;
 
 	/*
 	 * enable delayed allocation by default
@@ -3058,6 +3319,11 @@ no_journal:
 	} else
 		descr = "out journal";
 
+	err = ext4_register_li_request(sb);
+	if (err)
+		ext4_msg(sb, KERN_WARNING, "not zeroing uninitialized "
+			 "inode tables (%d)", err);
+
 	ext4_msg(sb, KERN_INFO, "mounted filesystem with%s. "
 		"Opts: %s", descr, orig_data);
 
@@ -3746,6 +4012,12 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	if (enable_quota)
 		dquot_resume(sb, -1);
 
+	/* start or stop zeroing inode tables as ro / noinit_itable changed */
+	if ((sb->s_flags & MS_RDONLY) || !test_opt(sb, INIT_INODE_TABLE))
+		ext4_unregister_li_request(sb);
+	else
+		ext4_register_li_request(sb);
+
 	ext4_msg(sb, KERN_INFO, "re-mounted. Opts: %s", orig_data);
 	kfree(orig_data);
 	return 0;
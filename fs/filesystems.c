@@ -110,6 +110,11 @@ int unregister_filesystem(struct file_system_type * fs)
 			*tmp = fs->next;
 			fs->next = NULL;
 			write_unlock(&file_systems_lock);
+			/*
+			 * Inodes of this type are freed by RCU; wait for the
+			 * callbacks before the module's caches go away.
+			 */
+			rcu_barrier();
 			return 0;
 		}
 		tmp = &(*tmp)->next;
@@ -469,6 +469,7 @@ static void cuse_fc_release(struct fuse_conn *fc)
 static int cuse_channel_open(struct inode *inode, struct file *file)
 {
 	struct cuse_conn *cc;
+	struct fuse_dev *fud;
 	int rc;
 
 	/* set up cuse_conn */
@@ -483,12 +484,18 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
 
 	cc->fc.connected = 1;
 	cc->fc.blocked = 0;
+	fud = fuse_dev_alloc(&cc->fc);
+	if (!fud) {
+		fuse_conn_put(&cc->fc);
+		return -ENOMEM;
+	}
 	rc = cuse_send_init(cc);
 	if (rc) {
+		fuse_dev_free(fud);
 		fuse_conn_put(&cc->fc);
 		return rc;
 	}
-	file->private_data = &cc->fc;	/* channel owns base reference to cc */
+	file->private_data = fud;	/* channel owns base reference to cc */
 
 	return 0;
 }
@@ -506,7 +513,8 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
  */
 static int cuse_channel_release(struct inode *inode, struct file *file)
 {
-	struct cuse_conn *cc = fc_to_cc(file->private_data);
+	struct fuse_dev *fud = file->private_data;
+	struct cuse_conn *cc = fc_to_cc(fud->fc);
 	int rc;
 
 	/* remove from the conntbl, no more access from this point on */
@@ -524,7 +532,8 @@ static int cuse_channel_release(struct inode *inode, struct file *file)
 
 	/* kill connection and shutdown channel */
 	fuse_conn_kill(&cc->fc);
-	rc = fuse_dev_release(inode, file);	/* puts the base reference */
+	rc = fuse_dev_release(inode, file);	/* puts the channel's reference */
+	fuse_conn_put(&cc->fc);			/* and the base reference */
 
 	return rc;
 }
@@ -25,43 +25,72 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_dev *fuse_get_dev(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or clone and is valid until the file is
+	 * released.
 	 */
 	return file->private_data;
 }
 
-static void fuse_request_init(struct fuse_req *req)
+static struct fuse_conn *fuse_get_conn(struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	return fud ? fud->fc : NULL;
+}
+
+static void fuse_request_init(struct fuse_req *req, struct page **pages,
+			      unsigned npages)
 {
 	memset(req, 0, sizeof(*req));
 	INIT_LIST_HEAD(&req->list);
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	req->pages = pages;
+	req->max_pages = npages;
 }
 
-struct fuse_req *fuse_request_alloc(void)
+static struct fuse_req *__fuse_request_alloc(unsigned npages, gfp_t flags)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_KERNEL);
-	if (req)
-		fuse_request_init(req);
+	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, flags);
+	struct page **pages;
+
+	if (!req)
+		return NULL;
+
+	if (npages <= FUSE_DEFAULT_MAX_PAGES_PER_REQ) {
+		pages = req->inline_pages;
+		npages = FUSE_DEFAULT_MAX_PAGES_PER_REQ;
+	} else {
+		pages = kzalloc(npages * sizeof(struct page *), flags);
+		if (!pages) {
+			kmem_cache_free(fuse_req_cachep, req);
+			return NULL;
+		}
+	}
+	fuse_request_init(req, pages, npages);
 	return req;
 }
+
+struct fuse_req *fuse_request_alloc(void)
+{
+	return __fuse_request_alloc(0, GFP_KERNEL);
+}
 EXPORT_SYMBOL_GPL(fuse_request_alloc);
 
-struct fuse_req *fuse_request_alloc_nofs(void)
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_NOFS);
-	if (req)
-		fuse_request_init(req);
-	return req;
+	return __fuse_request_alloc(npages, GFP_NOFS);
 }
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -97,7 +126,7 @@ static void fuse_req_init_context(struct fuse_req *req)
 	req->in.h.pid = current->pid;
 }
 
-struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages)
 {
 	struct fuse_req *req;
 	sigset_t oldset;
@@ -116,7 +145,7 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	if (!fc->connected)
 		goto out;
 
-	req = fuse_request_alloc();
+	req = __fuse_request_alloc(npages, GFP_KERNEL);
 	err = -ENOMEM;
 	if (!req)
 		goto out;
@@ -129,6 +158,12 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	atomic_dec(&fc->num_waiting);
 	return ERR_PTR(err);
 }
+EXPORT_SYMBOL_GPL(fuse_get_req_pages);
+
+struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+{
+	return fuse_get_req_pages(fc, 0);
+}
 EXPORT_SYMBOL_GPL(fuse_get_req);
 
 /*
@@ -166,7 +201,7 @@ static void put_reserved_req(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_file *ff = file->private_data;
 
 	spin_lock(&fc->lock);
-	fuse_request_init(req);
+	fuse_request_init(req, req->pages, req->max_pages);
 	BUG_ON(ff->reserved_req);
 	ff->reserved_req = req;
 	wake_up_all(&fc->reserved_req_waitq);
@@ -237,19 +272,60 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/*
+ * Wake up a reader for a request queued to @fud.  If all readers of
+ * the channel are busy, wake up an idle reader of another channel
+ * instead, which will take the request from @fud.
+ *
+ * Called with fc->lock held
+ */
+static void fuse_wake_reader(struct fuse_conn *fc, struct fuse_dev *fud)
+{
+	if (!waitqueue_active(&fud->waitq)) {
+		struct fuse_dev *other;
+
+		list_for_each_entry(other, &fc->channels, entry) {
+			if (waitqueue_active(&other->waitq)) {
+				fud = other;
+				break;
+			}
+		}
+	}
+	wake_up(&fud->waitq);
+	kill_fasync(&fud->fasync, SIGIO, POLL_IN);
+}
+
+void fuse_wake_readers(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+
+	list_for_each_entry(fud, &fc->channels, entry) {
+		wake_up_all(&fud->waitq);
+		kill_fasync(&fud->fasync, SIGIO, POLL_IN);
+	}
+}
+
+/* The channel requests queued on this CPU go to */
+static struct fuse_dev *fuse_this_channel(struct fuse_conn *fc)
+{
+	return fc->chan_map[smp_processor_id()];
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_dev *fud = fuse_this_channel(fc);
+
 	req->in.h.unique = fuse_get_unique(fc);
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	list_add_tail(&req->list, &fud->pending);
+	fc->num_pending++;
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	fuse_wake_reader(fc, fud);
 }
 
 static void flush_bg_queue(struct fuse_conn *fc)
@@ -282,6 +358,8 @@ __releases(&fc->lock)
 	req->end = NULL;
 	list_del(&req->list);
 	list_del(&req->intr_entry);
+	if (req->state == FUSE_REQ_PENDING)
+		fc->num_pending--;
 	req->state = FUSE_REQ_FINISHED;
 	if (req->background) {
 		if (fc->num_background == fc->max_background) {
@@ -320,8 +398,7 @@ __acquires(&fc->lock)
 static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
 	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	fuse_wake_reader(fc, fuse_this_channel(fc));
 }
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
@@ -358,6 +435,7 @@ __acquires(&fc->lock)
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
+			fc->num_pending--;
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -880,19 +958,42 @@ static int fuse_copy_args(struct fuse_copy_state *cs, unsigned numargs,
 	return err;
 }
 
+/*
+ * Readers of a channel take requests from other channels when their
+ * own has none, so any pending request will do.
+ */
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts);
+	return fc->num_pending || !list_empty(&fc->interrupts);
+}
+
+/* Take the next pending request, preferably from channel @fud */
+static struct fuse_req *request_next(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+
+	if (list_empty(&fud->pending)) {
+		struct fuse_dev *other;
+
+		list_for_each_entry(other, &fc->channels, entry) {
+			if (!list_empty(&other->pending)) {
+				fud = other;
+				break;
+			}
+		}
+	}
+	return list_entry(fud->pending.next, struct fuse_req, list);
 }
 
-/* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
+/* Wait until a request is available on the pending lists */
+static void request_wait(struct fuse_dev *fud)
 __releases(&fc->lock)
 __acquires(&fc->lock)
 {
+	struct fuse_conn *fc = fud->fc;
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&fud->waitq, &wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -903,7 +1004,7 @@ __acquires(&fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&fud->waitq, &wait);
 }
 
 /*
@@ -953,9 +1054,10 @@ __releases(&fc->lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = fud->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -968,7 +1070,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	    !request_pending(fc))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fud);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
@@ -982,7 +1084,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		return fuse_read_interrupt(fc, cs, nbytes, req);
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = request_next(fud);
+	fc->num_pending--;
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1036,13 +1139,13 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, const struct iovec *iov,
 {
 	struct fuse_copy_state cs;
 	struct file *file = iocb->ki_filp;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (!fud)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 1, iov, nr_segs);
+	fuse_copy_init(&cs, fud->fc, 1, iov, nr_segs);
 
-	return fuse_dev_do_read(fc, file, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_read(fud, file, &cs, iov_length(iov, nr_segs));
 }
 
 static int fuse_dev_pipe_buf_steal(struct pipe_inode_info *pipe,
@@ -1070,18 +1173,18 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int do_wakeup = 0;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(in);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(in);
+	if (!fud)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
-	fuse_copy_init(&cs, fc, 1, NULL, 0);
+	fuse_copy_init(&cs, fud->fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fc, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1481,11 +1584,13 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_conn *fc;
+	if (!fud)
 		return POLLERR;
 
-	poll_wait(file, &fc->waitq, wait);
+	fc = fud->fc;
+	poll_wait(file, &fud->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
@@ -1554,9 +1659,15 @@ __acquires(&fc->lock)
 
 static void end_queued_requests(struct fuse_conn *fc)
 {
+	struct fuse_dev *fud;
+	LIST_HEAD(pending);
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
+	/* channels may go away while fc->lock is dropped below */
+	list_for_each_entry(fud, &fc->channels, entry)
+		list_splice_tail_init(&fud->pending, &pending);
+	end_requests(fc, &pending);
 	end_requests(fc, &fc->processing);
 }
 
@@ -1587,26 +1698,108 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		fc->blocked = 0;
 		end_io_requests(fc);
 		end_queued_requests(fc);
-		wake_up_all(&fc->waitq);
+		fuse_wake_readers(fc);
 		wake_up_all(&fc->blocked_waitq);
-		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
 	spin_unlock(&fc->lock);
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
-int fuse_dev_release(struct inode *inode, struct file *file)
+/* Spread the CPUs over the channels, called with fc->lock held */
+static void fuse_map_channels(struct fuse_conn *fc)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
-		spin_lock(&fc->lock);
+	struct fuse_dev *fud = NULL;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (!fc->nr_channels) {
+			fc->chan_map[cpu] = NULL;
+			continue;
+		}
+		if (!fud || list_is_last(&fud->entry, &fc->channels))
+			fud = list_first_entry(&fc->channels, struct fuse_dev,
+					       entry);
+		else
+			fud = list_entry(fud->entry.next, struct fuse_dev,
+					 entry);
+		fc->chan_map[cpu] = fud;
+	}
+}
+
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+	struct fuse_dev **chan_map = NULL;
+
+	fud = kzalloc(sizeof(struct fuse_dev), GFP_KERNEL);
+	if (!fud)
+		return NULL;
+
+	if (!fc->chan_map) {
+		chan_map = kcalloc(nr_cpu_ids, sizeof(struct fuse_dev *),
+				   GFP_KERNEL);
+		if (!chan_map) {
+			kfree(fud);
+			return NULL;
+		}
+	}
+
+	fud->fc = fuse_conn_get(fc);
+	INIT_LIST_HEAD(&fud->pending);
+	init_waitqueue_head(&fud->waitq);
+
+	spin_lock(&fc->lock);
+	if (!fc->chan_map) {
+		fc->chan_map = chan_map;
+		chan_map = NULL;
+	}
+	list_add_tail(&fud->entry, &fc->channels);
+	fc->nr_channels++;
+	fuse_map_channels(fc);
+	spin_unlock(&fc->lock);
+	kfree(chan_map);
+
+	return fud;
+}
+EXPORT_SYMBOL_GPL(fuse_dev_alloc);
+
+/*
+ * The requests still pending on the channel are moved to another one.
+ * When the last channel goes away, nobody is left to answer requests,
+ * so the connection is shut down.
+ */
+void fuse_dev_free(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+
+	spin_lock(&fc->lock);
+	if (fc->nr_channels == 1) {
 		fc->connected = 0;
 		fc->blocked = 0;
 		end_queued_requests(fc);
 		wake_up_all(&fc->blocked_waitq);
-		spin_unlock(&fc->lock);
-		fuse_conn_put(fc);
 	}
+	list_del(&fud->entry);
+	fc->nr_channels--;
+	fuse_map_channels(fc);
+	if (!list_empty(&fud->pending)) {
+		struct fuse_dev *next = fc->chan_map[smp_processor_id()];
+
+		list_splice_tail_init(&fud->pending, &next->pending);
+		fuse_wake_reader(fc, next);
+	}
+	spin_unlock(&fc->lock);
+	kfree(fud);
+	fuse_conn_put(fc);
+}
+EXPORT_SYMBOL_GPL(fuse_dev_free);
+
+int fuse_dev_release(struct inode *inode, struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	if (fud)
+		fuse_dev_free(fud);
 
 	return 0;
 }
@@ -1614,12 +1807,61 @@ EXPORT_SYMBOL_GPL(fuse_dev_release);
 
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (!fud)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fc->fasync);
+	return fasync_helper(fd, file, on, &fud->fasync);
+}
+
+/*
+ * Attach a new, not yet used /dev/fuse file as another channel of the
+ * connection the file descriptor passed in belongs to.
+ */
+static int fuse_dev_clone(struct file *file, int oldfd)
+{
+	struct file *old;
+	struct fuse_dev *fud;
+	int err = -EINVAL;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EBADF;
+
+	/* CUSE channels can't be cloned */
+	if (old->f_op != &fuse_dev_operations || !fuse_get_dev(old))
+		goto out;
+
+	mutex_lock(&fuse_mutex);
+	if (!file->private_data) {
+		err = -ENOMEM;
+		fud = fuse_dev_alloc(fuse_get_conn(old));
+		if (fud) {
+			file->private_data = fud;
+			err = 0;
+		}
+	}
+	mutex_unlock(&fuse_mutex);
+ out:
+	fput(old);
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	u32 oldfd;
+
+	switch (cmd) {
+	case FUSE_DEV_IOC_CLONE:
+		if (get_user(oldfd, (u32 __user *) arg))
+			return -EFAULT;
+		return fuse_dev_clone(file, oldfd);
+
+	default:
+		return -ENOTTY;
+	}
 }
 
 const struct file_operations fuse_dev_operations = {
@@ -1634,6 +1876,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -22,8 +22,11 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Limit on the max number of pages the filesystem can negotiate */
+#define FUSE_MAX_MAX_PAGES 1024
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -276,7 +279,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** inline page vector, used unless a larger one is needed */
+	struct page *inline_pages[FUSE_DEFAULT_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -300,6 +309,32 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+/**
+ * A channel of a Fuse connection.
+ *
+ * There is one for each /dev/fuse file attached to the connection:
+ * the one given at mount time, and any cloned from it with
+ * FUSE_DEV_IOC_CLONE.  Each CPU queues its requests to one of the
+ * channels, so that a daemon serving every channel from a thread of
+ * its own gets CPU-affine traffic.
+ */
+struct fuse_dev {
+	/** The connection, a reference is held on it */
+	struct fuse_conn *fc;
+
+	/** The list of pending requests queued to this channel */
+	struct list_head pending;
+
+	/** Readers of the channel are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** O_ASYNC requests */
+	struct fasync_struct *fasync;
+
+	/** Entry on fc->channels */
+	struct list_head entry;
+};
+
 /**
  * A Fuse connection.
  *
@@ -332,11 +367,20 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
+	/** Maximum number of pages in a request */
+	unsigned max_pages;
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** The channels of the connection */
+	struct list_head channels;
+
+	/** Number of entries on the channels list */
+	unsigned nr_channels;
+
+	/** The channel each CPU queues its requests to */
+	struct fuse_dev **chan_map;
+
+	/** Number of requests on the pending lists of all channels */
+	unsigned num_pending;
 
 	/** The list of requests being processed */
 	struct list_head processing;
@@ -403,6 +447,9 @@ struct fuse_conn {
 	/** Filesystem supports NFS exporting.  Only set in INIT */
 	unsigned export_support:1;
 
+	/** Use writeback cache for buffered writes.  Only set in INIT */
+	unsigned writeback_cache:1;
+
 	/** Set if bdi is valid */
 	unsigned bdi_initialized:1;
 
@@ -477,9 +524,6 @@ struct fuse_conn {
 	/** number of dentries used in the above array */
 	int ctl_ndents;
 
-	/** O_ASYNC requests */
-	struct fasync_struct *fasync;
-
 	/** Key for lock owner ID scrambling */
 	u32 scramble_key[4];
 
@@ -626,7 +670,7 @@ void fuse_ctl_cleanup(void);
  */
 struct fuse_req *fuse_request_alloc(void);
 
-struct fuse_req *fuse_request_alloc_nofs(void);
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages);
 
 /**
  * Free a request
@@ -638,6 +682,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for at least @npages pages
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -670,6 +719,19 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 /* Abort all requests */
 void fuse_abort_conn(struct fuse_conn *fc);
 
+/**
+ * Allocate a channel of the connection, takes a reference on it
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
+/**
+ * Detach a channel from the connection and free it
+ */
+void fuse_dev_free(struct fuse_dev *fud);
+
+/* Wake up all readers of the connection, called with fc->lock held */
+void fuse_wake_readers(struct fuse_conn *fc);
+
 /**
  * Invalidate inode attributes
  */
@@ -721,6 +783,13 @@ int fuse_update_attributes(struct inode *inode, struct kstat *stat,
 
 void fuse_flush_writepages(struct inode *inode);
 
+/**
+ * Send the locally updated mtime of the inode to the filesystem
+ */
+int fuse_flush_times(struct inode *inode, struct fuse_file *ff);
+
+int fuse_write_inode(struct inode *inode, struct writeback_control *wbc);
+
 void fuse_set_nowrite(struct inode *inode);
 void fuse_release_nowrite(struct inode *inode);
 
@@ -500,7 +500,8 @@ static struct dentry *hfs_file_lookup(struct inode *dir, struct dentry *dentry,
 	HFS_I(inode)->rsrc_inode = dir;
 	HFS_I(dir)->rsrc_inode = inode;
 	igrab(dir);
-	hlist_add_head(&inode->i_hash, &HFS_SB(dir->i_sb)->rsrc_inodes);
+	/* so that __mark_inode_dirty() files it for writeback */
+	inode_fake_hash(inode);
 	mark_inode_dirty(inode);
 out:
 	d_add(dentry, inode);
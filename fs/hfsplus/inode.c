@@ -178,7 +178,8 @@ static struct dentry *hfsplus_file_lookup(struct inode *dir, struct dentry *dent
 	HFSPLUS_I(inode).rsrc_inode = dir;
 	HFSPLUS_I(dir).rsrc_inode = inode;
 	igrab(dir);
-	hlist_add_head(&inode->i_hash, &HFSPLUS_SB(sb).rsrc_inodes);
+	/* so that __mark_inode_dirty() files it for writeback */
+	inode_fake_hash(inode);
 	mark_inode_dirty(inode);
 out:
 	d_add(dentry, inode);
@@ -90,6 +90,17 @@ extern int do_remount_sb(struct super_block *, int, void *, int);
 extern void __put_super(struct super_block *sb);
 extern void put_super(struct super_block *sb);
 
+/*
+ * inode.c
+ */
+extern int get_nr_dirty_inodes(void);
+extern void inode_lru_list_add(struct inode *inode);
+
+/*
+ * fs-writeback.c
+ */
+extern void inode_wb_list_del(struct inode *inode);
+
 /*
  * open.c
  */
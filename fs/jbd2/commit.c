@@ -849,6 +849,17 @@ wait_for_iobuf:
 	if (err)
 		jbd2_journal_abort(journal, err);
 
+	/*
+	 * The transaction is safe on disk now.  Let fsync() waiters go
+	 * while we file its buffers for checkpointing, so they can queue
+	 * up the next commit in the meantime.
+	 */
+	write_lock(&journal->j_state_lock);
+	journal->j_commit_stable = commit_transaction->t_tid;
+	write_unlock(&journal->j_state_lock);
+	trace_jbd2_commit_stable(journal, commit_transaction);
+	wake_up(&journal->j_wait_done_commit);
+
 	/* End of a transaction!  Finally, we can do checkpoint
            processing: any buffers committed as a result of this
            transaction can be removed from any checkpoint list it was on
@@ -1000,6 +1011,8 @@ restart_loop:
 	trace_jbd2_run_stats(journal->j_fs_dev->bd_dev,
 			     commit_transaction->t_tid, &stats.run);
 
+	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
+
 	/*
 	 * Calculate overall stats
 	 */
@@ -1013,13 +1026,14 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.ts_commit_hist[jbd2_hist_bucket(div_u64(commit_time,
+								1000))]++;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
-	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
 	 * weight the commit time higher than the average time so we don't
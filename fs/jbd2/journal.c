@@ -79,6 +79,8 @@ EXPORT_SYMBOL(jbd2_journal_errno);
 EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
+EXPORT_SYMBOL(jbd2_log_wait_stable);
+EXPORT_SYMBOL(jbd2_log_batch_sync);
 EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
@@ -609,6 +611,68 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Wait for the commit record of a specified transaction to reach the
+ * disk.  This is all fsync() needs: unlike jbd2_log_wait_commit() it
+ * doesn't wait for the commit thread to file the transaction's buffers
+ * for checkpointing, so the next commit can be requested while that
+ * is still going on.
+ * The caller may not hold the journal lock.
+ */
+int jbd2_log_wait_stable(journal_t *journal, tid_t tid)
+{
+	int err = 0;
+
+	read_lock(&journal->j_state_lock);
+	while (tid_gt(tid, journal->j_commit_stable) &&
+	       tid_gt(tid, journal->j_commit_sequence)) {
+		jbd_debug(1, "JBD: want %d, j_commit_stable=%d\n",
+				  tid, journal->j_commit_stable);
+		wake_up(&journal->j_wait_commit);
+		read_unlock(&journal->j_state_lock);
+		wait_event(journal->j_wait_done_commit,
+				!tid_gt(tid, journal->j_commit_stable) ||
+				!tid_gt(tid, journal->j_commit_sequence));
+		read_lock(&journal->j_state_lock);
+	}
+	read_unlock(&journal->j_state_lock);
+
+	if (unlikely(is_journal_aborted(journal))) {
+		printk(KERN_EMERG "journal commit I/O error\n");
+		err = -EIO;
+	}
+	return err;
+}
+
+/*
+ * Called from fsync() before committing transaction @tid.  If @tid is
+ * still running and another process synced last, sleep a little so
+ * that other fsync()ing processes can get their changes into the same
+ * commit.  A single process doing a stream of fsyncs never waits.
+ */
+void jbd2_log_batch_sync(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	ktime_t start_time;
+	pid_t pid = current->pid;
+
+	if (journal->j_last_sync_writer == pid)
+		return;
+	journal->j_last_sync_writer = pid;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != tid ||
+	    tid_geq(journal->j_commit_request, tid)) {
+		read_unlock(&journal->j_state_lock);
+		return;
+	}
+	start_time = transaction->t_start_time;
+	read_unlock(&journal->j_state_lock);
+
+	__jbd2_batch_sleep(journal, tid, start_time);
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -708,6 +772,22 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static void jbd2_seq_hist_show(struct seq_file *seq, const char *name,
+			       unsigned long *hist)
+{
+	int i;
+
+	seq_printf(seq, "%s histogram:\n", name);
+	for (i = 0; i < JBD2_HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == JBD2_HIST_BUCKETS - 1)
+			seq_printf(seq, "  >= %luus: %lu\n", 1UL << i, hist[i]);
+		else
+			seq_printf(seq, "  < %luus: %lu\n", 2UL << i, hist[i]);
+	}
+}
+
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
@@ -737,6 +817,9 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	jbd2_seq_hist_show(seq, "commit time", s->stats->ts_commit_hist);
+	jbd2_seq_hist_show(seq, "sync batching sleep",
+			   s->stats->ts_batch_hist);
 	return 0;
 }
 
@@ -1058,6 +1141,7 @@ static int journal_reset(journal_t *journal)
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
 	journal->j_commit_request = journal->j_commit_sequence;
+	journal->j_commit_stable = journal->j_commit_sequence;
 
 	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
 
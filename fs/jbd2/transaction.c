@@ -27,6 +27,7 @@
 #include <linux/highmem.h>
 #include <linux/hrtimer.h>
 #include <linux/backing-dev.h>
+#include <trace/events/jbd2.h>
 #include <linux/module.h>
 
 static void __jbd2_journal_temp_unlink_buffer(struct journal_head *jh);
@@ -1277,6 +1278,45 @@ drop:
 	return err;
 }
 
+/*
+ * Sleep until transaction @tid, running since @start_time, has been open
+ * for about as long as a commit takes, so that other synchronous
+ * writers get the chance to join it.  The sleep is bounded by the
+ * journal's min and max batch times.
+ */
+void __jbd2_batch_sleep(journal_t *journal, tid_t tid, ktime_t start_time)
+{
+	u64 commit_time, trans_time, slept = 0;
+	ktime_t now;
+
+	read_lock(&journal->j_state_lock);
+	commit_time = journal->j_average_commit_time;
+	read_unlock(&journal->j_state_lock);
+
+	now = ktime_get();
+	trans_time = ktime_to_ns(ktime_sub(now, start_time));
+
+	commit_time = max_t(u64, commit_time,
+			    1000*journal->j_min_batch_time);
+	commit_time = min_t(u64, commit_time,
+			    1000*journal->j_max_batch_time);
+
+	if (trans_time < commit_time) {
+		ktime_t expires = ktime_add_ns(now, commit_time - trans_time);
+
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+		slept = ktime_to_ns(ktime_sub(ktime_get(), now));
+	}
+
+	trace_jbd2_batch_sleep(journal, tid, trans_time, slept);
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_batch_hist[jbd2_hist_bucket(div_u64(slept,
+							       1000))]++;
+	spin_unlock(&journal->j_history_lock);
+}
+
 /**
  * int jbd2_journal_stop() - complete a transaction
  * @handle: tranaction to complete.
@@ -1347,28 +1387,9 @@ int jbd2_journal_stop(handle_t *handle)
 	 */
 	pid = current->pid;
 	if (handle->h_sync && journal->j_last_sync_writer != pid) {
-		u64 commit_time, trans_time;
-
 		journal->j_last_sync_writer = pid;
-
-		read_lock(&journal->j_state_lock);
-		commit_time = journal->j_average_commit_time;
-		read_unlock(&journal->j_state_lock);
-
-		trans_time = ktime_to_ns(ktime_sub(ktime_get(),
-						   transaction->t_start_time));
-
-		commit_time = max_t(u64, commit_time,
-				    1000*journal->j_min_batch_time);
-		commit_time = min_t(u64, commit_time,
-				    1000*journal->j_max_batch_time);
-
-		if (trans_time < commit_time) {
-			ktime_t expires = ktime_add_ns(ktime_get(),
-						       commit_time);
-			set_current_state(TASK_UNINTERRUPTIBLE);
-			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
-		}
+		__jbd2_batch_sleep(journal, transaction->t_tid,
+				   transaction->t_start_time);
 	}
 
 	if (handle->h_sync)
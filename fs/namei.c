@@ -482,6 +482,40 @@ ok:
 	return security_inode_permission(inode, MAY_EXEC);
 }
 
+/*
+ * exec_permission() for RCU path walk: no reference is held on @inode and
+ * nothing may block or audit.  Only the plain "DAC says yes" case is
+ * decided here; ->permission(), ACLs that are not known to be absent,
+ * capability overrides and denials all return -ECHILD so that ref-walk
+ * redoes the check with the full machinery.
+ */
+static int exec_permission_rcu(struct inode *inode)
+{
+	umode_t mode = inode->i_mode;
+
+	if (inode->i_op->permission)
+		return -ECHILD;
+
+	if (current_fsuid() == inode->i_uid)
+		mode >>= 6;
+	else {
+		if (IS_POSIXACL(inode) && (mode & S_IRWXG) &&
+		    inode->i_op->check_acl) {
+#ifdef CONFIG_FS_POSIX_ACL
+			if (ACCESS_ONCE(inode->i_acl) != NULL)
+#endif
+				return -ECHILD;
+		}
+		if (in_group_p(inode->i_gid))
+			mode >>= 3;
+	}
+
+	if (!(mode & MAY_EXEC))
+		return -ECHILD;
+
+	return security_inode_exec_permission(inode, IPERM_FLAG_RCU);
+}
+
 static __always_inline void set_root(struct nameidata *nd)
 {
 	if (!nd->root.mnt) {
@@ -1052,13 +1086,295 @@ out_fail:
 	return retval;
 }
 
+/*
+ * RCU path walk ("rcu-walk").
+ *
+ * Walks the dcache under rcu_read_lock() without taking a reference or a
+ * lock on any dentry or vfsmount on the way.  Each step records the d_seq
+ * of the dentry it stands on; the d_inode, d_parent and hash state read
+ * from a dentry are only trusted once its d_seq is re-checked, and a child
+ * found by __d_lookup_rcu() only once the parent's d_seq still matches, so
+ * a concurrent rename, unlink or d_drop() simply fails the walk.  Dentries,
+ * inodes, superblocks and vfsmounts are all freed via RCU, so whatever was
+ * read stays valid memory until rcu_read_unlock().
+ *
+ * Only the common case is handled here.  Anything that needs a reference
+ * or may sleep - ->d_revalidate(), ->d_hash() and ->d_compare(), crossing
+ * a mount point in either direction, symlinks, cache misses, lookups
+ * relative to a dfd, FS_REVAL_DOT filesystems and any permission check
+ * that is not a plain DAC grant - returns -ECHILD, and the caller redoes
+ * the whole lookup in ref-walk mode.  Definite answers (-ENOENT from a
+ * negative dentry, -ENOTDIR) are returned as they are.
+ *
+ * On success nd->path holds references and nd->root is left unset.
+ */
+static int walk_component_rcu(struct dentry **dentryp, struct inode **inodep,
+			      unsigned *seqp, struct qstr *name)
+{
+	struct dentry *parent = *dentryp;
+	struct dentry *dentry;
+	struct inode *inode;
+	unsigned seq;
+
+	if (parent->d_op && parent->d_op->d_hash)
+		return -ECHILD;
+
+	dentry = __d_lookup_rcu(parent, name, &seq);
+	if (!dentry)
+		return -ECHILD;
+	/* the parent must still be where we found it */
+	if (read_seqcount_retry(&parent->d_seq, *seqp))
+		return -ECHILD;
+
+	if (dentry->d_op && dentry->d_op->d_revalidate)
+		return -ECHILD;
+	if (d_mountpoint(dentry))
+		return -ECHILD;
+
+	inode = dentry->d_inode;
+	if (read_seqcount_retry(&dentry->d_seq, seq))
+		return -ECHILD;
+
+	*dentryp = dentry;
+	*inodep = inode;
+	*seqp = seq;
+	return 0;
+}
+
+static int follow_dotdot_rcu(struct path *root, struct vfsmount *mnt,
+			     struct dentry **dentryp, struct inode **inodep,
+			     unsigned *seqp)
+{
+	struct dentry *dentry = *dentryp;
+	struct dentry *parent;
+	struct inode *inode;
+	unsigned seq;
+
+	if (dentry == root->dentry && mnt == root->mnt)
+		return 0;
+	if (dentry == mnt->mnt_root)
+		return -ECHILD;
+
+	parent = dentry->d_parent;
+	seq = read_seqcount_begin(&parent->d_seq);
+	if (read_seqcount_retry(&dentry->d_seq, *seqp))
+		return -ECHILD;
+	if (d_mountpoint(parent))
+		return -ECHILD;
+
+	inode = parent->d_inode;
+	if (read_seqcount_retry(&parent->d_seq, seq))
+		return -ECHILD;
+
+	*dentryp = parent;
+	*inodep = inode;
+	*seqp = seq;
+	return 0;
+}
+
+static int path_walk_rcu(int dfd, const char *name, unsigned int flags,
+			 struct nameidata *nd)
+{
+	struct fs_struct *fs = current->fs;
+	unsigned int lookup_flags = flags;
+	struct vfsmount *mnt;
+	struct dentry *dentry;
+	struct inode *inode;
+	struct path root;
+	struct qstr this;
+	unsigned fs_seq, seq;
+	int err;
+
+	if (*name != '/' && dfd != AT_FDCWD)
+		return -ECHILD;
+	if (flags & LOOKUP_REVAL)
+		return -ECHILD;
+
+	nd->last_type = LAST_ROOT;
+	nd->flags = flags;
+	nd->depth = 0;
+	nd->root.mnt = NULL;
+	current->total_link_count = 0;
+
+	rcu_read_lock();
+	fs_seq = read_seqcount_begin(&fs->seq);
+	root = fs->root;
+	if (*name == '/') {
+		mnt = root.mnt;
+		dentry = root.dentry;
+	} else {
+		mnt = fs->pwd.mnt;
+		dentry = fs->pwd.dentry;
+	}
+	seq = read_seqcount_begin(&dentry->d_seq);
+	inode = dentry->d_inode;
+
+	while (*name == '/')
+		name++;
+	if (!*name)
+		goto reval;
+
+	for (;;) {
+		unsigned long hash;
+		unsigned int c;
+
+		nd->flags |= LOOKUP_CONTINUE;
+		err = exec_permission_rcu(inode);
+		if (err)
+			goto fail;
+
+		this.name = name;
+		c = *(const unsigned char *)name;
+
+		hash = init_name_hash();
+		do {
+			name++;
+			hash = partial_name_hash(c, hash);
+			c = *(const unsigned char *)name;
+		} while (c && (c != '/'));
+		this.len = name - (const char *) this.name;
+		this.hash = end_name_hash(hash);
+
+		if (!c)
+			goto last_component;
+		while (*++name == '/');
+		if (!*name) {
+			lookup_flags |= LOOKUP_FOLLOW | LOOKUP_DIRECTORY;
+			goto last_component;
+		}
+
+		if (this.name[0] == '.') switch (this.len) {
+			default:
+				break;
+			case 2:
+				if (this.name[1] != '.')
+					break;
+				err = follow_dotdot_rcu(&root, mnt, &dentry,
+							&inode, &seq);
+				if (err)
+					goto fail;
+				/* fallthrough */
+			case 1:
+				continue;
+		}
+
+		err = walk_component_rcu(&dentry, &inode, &seq, &this);
+		if (err)
+			goto fail;
+		err = -ENOENT;
+		if (!inode)
+			goto fail;
+		err = -ECHILD;
+		if (inode->i_op->follow_link)
+			goto fail;
+		err = -ENOTDIR;
+		if (!inode->i_op->lookup)
+			goto fail;
+	}
+
+last_component:
+	/* Clear LOOKUP_CONTINUE iff it was previously unset */
+	nd->flags &= lookup_flags | ~LOOKUP_CONTINUE;
+	if (lookup_flags & LOOKUP_PARENT) {
+		nd->last = this;
+		nd->last_type = LAST_NORM;
+		if (this.name[0] != '.')
+			goto done;
+		if (this.len == 1)
+			nd->last_type = LAST_DOT;
+		else if (this.len == 2 && this.name[1] == '.')
+			nd->last_type = LAST_DOTDOT;
+		else
+			goto done;
+		goto reval;
+	}
+	if (this.name[0] == '.') switch (this.len) {
+		default:
+			break;
+		case 2:
+			if (this.name[1] != '.')
+				break;
+			err = follow_dotdot_rcu(&root, mnt, &dentry, &inode, &seq);
+			if (err)
+				goto fail;
+			/* fallthrough */
+		case 1:
+			goto reval;
+	}
+	err = walk_component_rcu(&dentry, &inode, &seq, &this);
+	if (err)
+		goto fail;
+	err = -ECHILD;
+	if (follow_on_final(inode, lookup_flags))
+		goto fail;
+	err = -ENOENT;
+	if (!inode)
+		goto fail;
+	if (lookup_flags & LOOKUP_DIRECTORY) {
+		err = -ENOTDIR;
+		if (!inode->i_op->lookup)
+			goto fail;
+	}
+	goto done;
+
+reval:
+	/* ref-walk would ask ->d_revalidate() about the dentry we end on */
+	err = -ECHILD;
+	if (dentry->d_sb->s_type->fs_flags & FS_REVAL_DOT)
+		goto fail;
+
+done:
+	/*
+	 * Turn the walk into references.  The dentry is pinned under d_lock
+	 * as long as d_seq shows it unchanged since we looked at it; the
+	 * vfsmount is the one fs->root or fs->pwd pointed to, which still
+	 * holds it if fs->seq has not moved.
+	 */
+	err = -ECHILD;
+	spin_lock(&dentry->d_lock);
+	if (read_seqcount_retry(&dentry->d_seq, seq)) {
+		spin_unlock(&dentry->d_lock);
+		goto fail;
+	}
+	atomic_inc(&dentry->d_count);
+	spin_unlock(&dentry->d_lock);
+
+	if (!atomic_inc_not_zero(&mnt->mnt_count)) {
+		rcu_read_unlock();
+		dput(dentry);
+		return -ECHILD;
+	}
+	if (read_seqcount_retry(&fs->seq, fs_seq)) {
+		rcu_read_unlock();
+		dput(dentry);
+		mntput(mnt);
+		return -ECHILD;
+	}
+	rcu_read_unlock();
+
+	nd->path.mnt = mnt;
+	nd->path.dentry = dentry;
+	return 0;
+
+fail:
+	/* a definite answer only counts if the walk was not raced */
+	if (err != -ECHILD && read_seqcount_retry(&fs->seq, fs_seq))
+		err = -ECHILD;
+	rcu_read_unlock();
+	return err;
+}
+
 /* Returns 0 and nd will be valid on success; Retuns error, otherwise. */
 static int do_path_lookup(int dfd, const char *name,
 				unsigned int flags, struct nameidata *nd)
 {
-	int retval = path_init(dfd, name, flags, nd);
-	if (!retval)
-		retval = path_walk(name, nd);
+	int retval = path_walk_rcu(dfd, name, flags, nd);
+
+	if (retval == -ECHILD) {
+		retval = path_init(dfd, name, flags, nd);
+		if (!retval)
+			retval = path_walk(name, nd);
+	}
 	if (unlikely(!retval && !audit_dummy_context() && nd->path.dentry &&
 				nd->path.dentry->d_inode))
 		audit_inode(name, nd->path.dentry);
@@ -1795,14 +2111,19 @@ struct file *do_filp_open(int dfd, const char *pathname,
 
 	/* find the parent */
 reval:
-	error = path_init(dfd, pathname, LOOKUP_PARENT, &nd);
-	if (error)
-		return ERR_PTR(error);
-	if (force_reval)
-		nd.flags |= LOOKUP_REVAL;
+	error = -ECHILD;
+	if (!force_reval)
+		error = path_walk_rcu(dfd, pathname, LOOKUP_PARENT, &nd);
+	if (error == -ECHILD) {
+		error = path_init(dfd, pathname, LOOKUP_PARENT, &nd);
+		if (error)
+			return ERR_PTR(error);
+		if (force_reval)
+			nd.flags |= LOOKUP_REVAL;
 
-	current->total_link_count = 0;
-	error = link_path_walk(pathname, &nd);
+		current->total_link_count = 0;
+		error = link_path_walk(pathname, &nd);
+	}
 	if (error) {
 		filp = ERR_PTR(error);
 		goto out;
@@ -397,6 +397,13 @@ void simple_set_mnt(struct vfsmount *mnt, struct super_block *sb)
 
 EXPORT_SYMBOL(simple_set_mnt);
 
+static void free_vfsmnt_rcu(struct rcu_head *head)
+{
+	struct vfsmount *mnt = container_of(head, struct vfsmount, mnt_rcu);
+
+	kmem_cache_free(mnt_cache, mnt);
+}
+
 void free_vfsmnt(struct vfsmount *mnt)
 {
 	kfree(mnt->mnt_devname);
@@ -404,7 +411,8 @@ void free_vfsmnt(struct vfsmount *mnt)
 #ifdef CONFIG_SMP
 	free_percpu(mnt->mnt_writers);
 #endif
-	kmem_cache_free(mnt_cache, mnt);
+	/* a path walk in RCU mode may still be looking at mnt_root */
+	call_rcu(&mnt->mnt_rcu, free_vfsmnt_rcu);
 }
 
 /*
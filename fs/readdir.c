@@ -13,6 +13,10 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/dirent.h>
+#include <linux/namei.h>
+#include <linux/fs_struct.h>
+#include <linux/mount.h>
+#include <linux/kdev_t.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
@@ -307,3 +311,282 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 out:
 	return error;
 }
+
+/*
+ * getdents_stat() returns what getdents64() does, plus the stat fields
+ * asked for in @mask of every entry, so that "ls -l" and friends don't
+ * have to do a path lookup and a stat() per entry.
+ *
+ * The entries are read in rounds of up to a page of names.  The stat
+ * part is filled in after ->readdir() returns, from the dcache when the
+ * dentries are there and through lookup_one_len() otherwise, so no
+ * filesystem sees a lookup from within its own ->readdir().  Like stat(2),
+ * a mountpoint reports the root of what is mounted on it and ".." crosses
+ * to the parent mount at a mount root.  An entry that cannot be looked
+ * up, e.g. because it was just unlinked, is returned with d_stat_mask 0.
+ *
+ * Listing a big cold directory must not flush the dcache, so a dentry
+ * that only the lookup here brought in is unhashed again once it has
+ * been stat'ed: it is freed on the last dput() and only the inode stays
+ * behind, on the inode LRU, where memory pressure reclaims it cheaply.
+ */
+struct dirent_stat_entry {
+	u64		ino;
+	loff_t		offset;
+	unsigned int	d_type;
+	int		namlen;
+	char		name[0];
+};
+
+struct getdents_stat_callback {
+	void		*kbuf;		/* entries of this round */
+	int		kused;
+	int		nr;
+	int		kbuf_full;
+	int		count;		/* room left in the user buffer */
+	int		error;
+};
+
+#define DSTAT_RECLEN(namlen) \
+	ALIGN(offsetof(struct linux_dirent_stat, d_name) + (namlen) + 1, \
+	      sizeof(u64))
+
+static int filldir_stat(void *__buf, const char *name, int namlen,
+			loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct getdents_stat_callback *buf = __buf;
+	struct dirent_stat_entry *de;
+	int reclen = DSTAT_RECLEN(namlen);
+	int klen = ALIGN(sizeof(*de) + namlen, sizeof(u64));
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count)
+		return -EINVAL;
+	buf->error = 0;
+	if (buf->kused + klen > PAGE_SIZE) {
+		buf->kbuf_full = 1;
+		return -EINVAL;
+	}
+	de = buf->kbuf + buf->kused;
+	de->ino = ino;
+	de->offset = offset;
+	de->d_type = d_type;
+	de->namlen = namlen;
+	memcpy(de->name, name, namlen);
+	buf->kused += klen;
+	buf->nr++;
+	buf->count -= reclen;
+	return 0;
+}
+
+/*
+ * Unhash a dentry that lookup_one_len() just brought in, unless someone
+ * else got hold of it in the meantime.
+ */
+static void dirent_stat_uncache(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	if (atomic_read(&dentry->d_count) == 1 && !d_mountpoint(dentry))
+		__d_drop(dentry);
+	spin_unlock(&dentry->d_lock);
+}
+
+/* the ".." step of follow_dotdot(), stopping at the process root */
+static void dirent_stat_dotdot(struct path *path)
+{
+	struct fs_struct *fs = current->fs;
+	struct path root;
+
+	read_lock(&fs->lock);
+	root = fs->root;
+	path_get(&root);
+	read_unlock(&fs->lock);
+
+	while (path->dentry != root.dentry || path->mnt != root.mnt) {
+		if (path->dentry != path->mnt->mnt_root) {
+			struct dentry *old = path->dentry;
+
+			path->dentry = dget_parent(old);
+			dput(old);
+			break;
+		}
+		if (!follow_up(path))
+			break;
+	}
+	path_put(&root);
+}
+
+static int dirent_stat_lookup(struct path *dir, struct dirent_stat_entry *de,
+			      struct path *path)
+{
+	struct qstr this = { .name = de->name, .len = de->namlen };
+	struct dentry *parent = dir->dentry;
+	struct dentry *dentry;
+
+	*path = *dir;
+	path_get(path);
+	if (de->namlen == 1 && de->name[0] == '.')
+		return 0;
+	if (de->namlen == 2 && de->name[0] == '.' && de->name[1] == '.') {
+		dirent_stat_dotdot(path);
+		goto mounts;
+	}
+
+	dentry = d_hash_and_lookup(parent, &this);
+	if (!dentry) {
+		mutex_lock(&parent->d_inode->i_mutex);
+		dentry = lookup_one_len(de->name, parent, de->namlen);
+		mutex_unlock(&parent->d_inode->i_mutex);
+		if (IS_ERR(dentry))
+			goto fail;
+		dirent_stat_uncache(dentry);
+	}
+	if (!dentry->d_inode) {
+		dput(dentry);
+		goto fail;
+	}
+	dput(path->dentry);
+	path->dentry = dentry;
+mounts:
+	while (d_mountpoint(path->dentry) && follow_down(path))
+		;
+	return 0;
+fail:
+	path_put(path);
+	return -ENOENT;
+}
+
+static void dirent_stat_fill(struct file *file, struct dirent_stat_entry *de,
+			     unsigned int mask, struct linux_dirent_stat *ds)
+{
+	struct path path;
+	struct kstat stat;
+
+	if (!mask)
+		return;
+	if (dirent_stat_lookup(&file->f_path, de, &path))
+		return;
+	if (vfs_getattr(path.mnt, path.dentry, &stat))
+		goto out;
+
+	if (mask & DSTAT_DEV)
+		ds->d_stat.ds_dev = new_encode_dev(stat.dev);
+	if (mask & DSTAT_INO)
+		ds->d_stat.ds_ino = stat.ino;
+	if (mask & DSTAT_RDEV)
+		ds->d_stat.ds_rdev = new_encode_dev(stat.rdev);
+	if (mask & DSTAT_SIZE)
+		ds->d_stat.ds_size = stat.size;
+	if (mask & DSTAT_BLOCKS)
+		ds->d_stat.ds_blocks = stat.blocks;
+	if (mask & DSTAT_ATIME) {
+		ds->d_stat.ds_atime_sec = stat.atime.tv_sec;
+		ds->d_stat.ds_atime_nsec = stat.atime.tv_nsec;
+	}
+	if (mask & DSTAT_MTIME) {
+		ds->d_stat.ds_mtime_sec = stat.mtime.tv_sec;
+		ds->d_stat.ds_mtime_nsec = stat.mtime.tv_nsec;
+	}
+	if (mask & DSTAT_CTIME) {
+		ds->d_stat.ds_ctime_sec = stat.ctime.tv_sec;
+		ds->d_stat.ds_ctime_nsec = stat.ctime.tv_nsec;
+	}
+	if (mask & DSTAT_MODE)
+		ds->d_stat.ds_mode = stat.mode;
+	if (mask & DSTAT_NLINK)
+		ds->d_stat.ds_nlink = stat.nlink;
+	if (mask & DSTAT_UID)
+		ds->d_stat.ds_uid = stat.uid;
+	if (mask & DSTAT_GID)
+		ds->d_stat.ds_gid = stat.gid;
+	if (mask & DSTAT_BLKSIZE)
+		ds->d_stat.ds_blksize = stat.blksize;
+	ds->d_stat_mask = mask;
+out:
+	path_put(&path);
+}
+
+SYSCALL_DEFINE4(getdents_stat, unsigned int, fd,
+		struct linux_dirent_stat __user *, dirent, unsigned int, count,
+		unsigned int, mask)
+{
+	struct file *file;
+	struct linux_dirent_stat __user *cur = dirent;
+	struct linux_dirent_stat __user *lastdirent = NULL;
+	struct getdents_stat_callback buf;
+	struct linux_dirent_stat ds;
+	struct dirent_stat_entry *de;
+	int error, i, reclen;
+
+	error = -EINVAL;
+	if (mask & ~DSTAT_ALL)
+		goto out;
+
+	error = -EFAULT;
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		goto out;
+
+	error = -EBADF;
+	file = fget(fd);
+	if (!file)
+		goto out;
+
+	error = -ENOMEM;
+	buf.kbuf = (void *)__get_free_page(GFP_KERNEL);
+	if (!buf.kbuf)
+		goto out_fput;
+	buf.count = count;
+
+	/* stat() of the entries needs search permission on the directory */
+	if (mask && inode_permission(file->f_path.dentry->d_inode, MAY_EXEC))
+		mask = 0;
+
+	do {
+		buf.kused = 0;
+		buf.nr = 0;
+		buf.kbuf_full = 0;
+		buf.error = 0;
+
+		error = vfs_readdir(file, filldir_stat, &buf);
+		if (error >= 0)
+			error = buf.error;
+
+		for (i = 0, de = buf.kbuf; i < buf.nr; i++) {
+			if (lastdirent &&
+			    __put_user(de->offset, &lastdirent->d_off)) {
+				error = -EFAULT;
+				goto out_free;
+			}
+			reclen = DSTAT_RECLEN(de->namlen);
+			memset(&ds, 0, sizeof(ds));
+			ds.d_ino = de->ino;
+			ds.d_reclen = reclen;
+			ds.d_type = de->d_type;
+			dirent_stat_fill(file, de, mask, &ds);
+			if (copy_to_user(cur, &ds, sizeof(ds)) ||
+			    copy_to_user(cur->d_name, de->name, de->namlen) ||
+			    __put_user(0, cur->d_name + de->namlen)) {
+				error = -EFAULT;
+				goto out_free;
+			}
+			lastdirent = cur;
+			cur = (void __user *)cur + reclen;
+			de = (void *)de +
+			     ALIGN(sizeof(*de) + de->namlen, sizeof(u64));
+		}
+	} while (buf.kbuf_full && error >= 0);
+
+	if (lastdirent) {
+		typeof(lastdirent->d_off) d_off = file->f_pos;
+		if (__put_user(d_off, &lastdirent->d_off))
+			error = -EFAULT;
+		else
+			error = count - buf.count;
+	}
+out_free:
+	free_page((unsigned long)buf.kbuf);
+out_fput:
+	fput(file);
+out:
+	return error;
+}
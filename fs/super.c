@@ -54,9 +54,25 @@ static struct super_block *alloc_super(struct file_system_type *type)
 			s = NULL;
 			goto out;
 		}
+#ifdef CONFIG_SMP
+		s->s_files = alloc_percpu(struct list_head);
+		if (!s->s_files) {
+			security_sb_free(s);
+			kfree(s);
+			s = NULL;
+			goto out;
+		} else {
+			int i;
+
+			for_each_possible_cpu(i)
+				INIT_LIST_HEAD(per_cpu_ptr(s->s_files, i));
+		}
+#else
 		INIT_LIST_HEAD(&s->s_files);
+#endif
 		INIT_LIST_HEAD(&s->s_instances);
-		INIT_HLIST_HEAD(&s->s_anon);
+		INIT_HLIST_BL_HEAD(&s->s_anon);
+		spin_lock_init(&s->s_inode_list_lock);
 		INIT_LIST_HEAD(&s->s_inodes);
 		INIT_LIST_HEAD(&s->s_dentry_lru);
 		init_rwsem(&s->s_umount);
@@ -100,18 +116,29 @@ out:
 	return s;
 }
 
+static void destroy_super_rcu(struct rcu_head *head)
+{
+	struct super_block *s = container_of(head, struct super_block, s_rcu);
+
+	kfree(s);
+}
+
 /**
  *	destroy_super	-	frees a superblock
  *	@s: superblock to free
  *
- *	Frees a superblock.
+ *	Frees a superblock.  The structure itself goes after a grace period,
+ *	a path walk in RCU mode may still be looking at it through an inode.
  */
 static inline void destroy_super(struct super_block *s)
 {
+#ifdef CONFIG_SMP
+	free_percpu(s->s_files);
+#endif
 	security_sb_free(s);
 	kfree(s->s_subtype);
 	kfree(s->s_options);
-	kfree(s);
+	call_rcu(&s->s_rcu, destroy_super_rcu);
 }
 
 /* Superblock refcounting  */
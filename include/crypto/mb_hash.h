@@ -0,0 +1,57 @@
+/*
+ * Multi-buffer hash engine
+ *
+ * Collects independent hash requests from any number of callers and feeds
+ * them to a block function that hashes several messages side by side in
+ * the lanes of SIMD registers.
+ */
+
+#ifndef _CRYPTO_MB_HASH_H
+#define _CRYPTO_MB_HASH_H
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <crypto/hash.h>
+
+#define MB_HASH_MAX_LANES	8
+#define MB_HASH_BLOCK_SIZE	64
+#define MB_HASH_MAX_WORDS	8
+
+/* exported state of a request: chaining value, length and partial block */
+struct mb_hash_state {
+	u32 h[MB_HASH_MAX_WORDS];
+	u64 count;
+	u8 buf[2 * MB_HASH_BLOCK_SIZE];
+};
+
+struct mb_hash_cpu_queue;
+
+/**
+ * struct mb_hash_alg - a multi-buffer implementation of an MD-style hash
+ * @lanes: number of messages @blocks hashes at once, at most
+ *	MB_HASH_MAX_LANES
+ * @iv: initial chaining value, MB_HASH_MAX_WORDS words
+ * @blocks: hash @nblocks 64 byte blocks of @data[i] into @state[i] for
+ *	every lane i.  Called in process context; lanes without a request
+ *	get scratch state and another lane's data.
+ * @ahash: the algorithm registered with the crypto API.  The owner fills
+ *	in halg.digestsize and the cra_name, cra_driver_name,
+ *	cra_priority and cra_module of halg.base, the engine the rest.
+ *
+ * Only hashes with 64 byte blocks, a big endian bit count in the padding
+ * and a big endian digest (SHA-1, SHA-224, SHA-256) are supported.
+ */
+struct mb_hash_alg {
+	unsigned int lanes;
+	const u32 *iv;
+	void (*blocks)(u32 *state[], const u8 *data[], unsigned int nblocks);
+	struct ahash_alg ahash;
+
+	/* private */
+	struct mb_hash_cpu_queue __percpu *queue;
+};
+
+int mb_hash_register(struct mb_hash_alg *alg);
+void mb_hash_unregister(struct mb_hash_alg *alg);
+
+#endif
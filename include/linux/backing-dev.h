@@ -39,6 +39,8 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_DIRTIED,
+	BDI_WRITTEN,
 	NR_BDI_STAT_ITEMS
 };
 
@@ -53,6 +55,7 @@ struct bdi_writeback {
 	unsigned long last_old_flush;		/* last old data flush */
 
 	struct task_struct	*task;		/* writeback task */
+	spinlock_t		list_lock;	/* protects the b_* lists */
 	struct list_head	b_dirty;	/* dirty inodes */
 	struct list_head	b_io;		/* parked for writeback */
 	struct list_head	b_more_io;	/* parked for more writeback */
@@ -73,6 +76,19 @@ struct backing_dev_info {
 
 	struct percpu_counter bdi_stat[NR_BDI_STAT_ITEMS];
 
+	/*
+	 * Write bandwidth estimation and dirty throttling, updated by
+	 * bdi_update_bandwidth() under wb.list_lock.  All rates are in
+	 * pages per second.
+	 */
+	unsigned long bw_time_stamp;	/* last time bandwidth was updated */
+	unsigned long dirtied_stamp;	/* BDI_DIRTIED at bw_time_stamp */
+	unsigned long written_stamp;	/* BDI_WRITTEN at bw_time_stamp */
+	unsigned long write_bandwidth;	/* the estimated write bandwidth */
+	unsigned long avg_write_bandwidth; /* further smoothed write bw */
+	unsigned long dirty_ratelimit;	/* base rate dirtiers are held to */
+	unsigned long balanced_dirty_ratelimit; /* last estimated balance */
+
 	struct prop_local_percpu completions;
 	int dirty_exceeded;
 
@@ -108,6 +124,7 @@ void bdi_start_background_writeback(struct backing_dev_info *bdi);
 int bdi_writeback_task(struct bdi_writeback *wb);
 int bdi_has_dirty_io(struct backing_dev_info *bdi);
 void bdi_arm_supers_timer(void);
+void bdi_lock_two(struct bdi_writeback *wb1, struct bdi_writeback *wb2);
 
 extern spinlock_t bdi_lock;
 extern struct list_head bdi_list;
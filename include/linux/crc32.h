@@ -11,6 +11,14 @@
 extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
 
+/*
+ * CRC32 with the Castagnoli polynomial, as used by iSCSI, SCTP and btrfs.
+ * Same seed and no-final-xor conventions as crc32_le().  Most users want
+ * the crypto API "crc32c" hash (or libcrc32c), which may pick a hardware
+ * accelerated implementation.
+ */
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
 /*
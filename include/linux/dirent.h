@@ -9,4 +9,53 @@ struct linux_dirent64 {
 	char		d_name[0];
 };
 
+/*
+ * getdents_stat(2): getdents64 records that carry the stat fields asked
+ * for.  The layout is the same on 32 and 64 bit.
+ */
+#define DSTAT_MODE	0x0001
+#define DSTAT_NLINK	0x0002
+#define DSTAT_UID	0x0004
+#define DSTAT_GID	0x0008
+#define DSTAT_RDEV	0x0010
+#define DSTAT_ATIME	0x0020
+#define DSTAT_MTIME	0x0040
+#define DSTAT_CTIME	0x0080
+#define DSTAT_INO	0x0100
+#define DSTAT_SIZE	0x0200
+#define DSTAT_BLOCKS	0x0400
+#define DSTAT_DEV	0x0800
+#define DSTAT_BLKSIZE	0x1000
+#define DSTAT_ALL	0x1fff
+
+struct dirent_stat {
+	__u64		ds_dev;
+	__u64		ds_ino;
+	__u64		ds_rdev;
+	__s64		ds_size;
+	__u64		ds_blocks;
+	__s64		ds_atime_sec;
+	__s64		ds_mtime_sec;
+	__s64		ds_ctime_sec;
+	__u32		ds_atime_nsec;
+	__u32		ds_mtime_nsec;
+	__u32		ds_ctime_nsec;
+	__u32		ds_mode;
+	__u32		ds_nlink;
+	__u32		ds_uid;
+	__u32		ds_gid;
+	__u32		ds_blksize;
+};
+
+struct linux_dirent_stat {
+	__u64		d_ino;
+	__s64		d_off;
+	__u16		d_reclen;
+	__u8		d_type;
+	__u8		__pad;
+	__u32		d_stat_mask;	/* DSTAT_* fields valid in d_stat */
+	struct dirent_stat d_stat;
+	char		d_name[0];
+};
+
 #endif
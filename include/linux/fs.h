@@ -54,6 +54,13 @@ struct inodes_stat_t {
 #define MAY_ACCESS 16
 #define MAY_OPEN 32
 
+/*
+ * IPERM_FLAG_RCU: permission is checked during an RCU path walk, so the
+ * check must neither block nor take references.  It returns -ECHILD when
+ * it cannot decide that way and the walk is redone with references held.
+ */
+#define IPERM_FLAG_RCU 0x0001
+
 /*
  * flags in file.f_mode.  Note that FMODE_READ and FMODE_WRITE must correspond
  * to O_WRONLY and O_RDWR via the strange trick in __dentry_open()
@@ -724,11 +731,37 @@ static inline int mapping_writably_mapped(struct address_space *mapping)
 struct posix_acl;
 #define ACL_NOT_CACHED ((void *)(-1))
 
+/*
+ * Locking rules for the inode lists and state:
+ *
+ *   inode->i_state:	inode->i_lock
+ *   inode->i_hash, inode->i_hash_bucket:	bit lock of the hash bucket
+ *   inode->i_sb_list:	sb->s_inode_list_lock
+ *   inode->i_wb_list:	bdi->wb.list_lock of the inode's mapping
+ *   inode->i_lru:	inode_lru_lock (fs/inode.c)
+ *
+ * Lock ordering:
+ *   sb->s_inode_list_lock
+ *     inode->i_lock
+ *       inode_lru_lock
+ *
+ *   bdi->wb.list_lock
+ *     inode->i_lock
+ *
+ *   hash bucket lock
+ *     inode->i_lock
+ *     sb->s_inode_list_lock
+ */
 struct inode {
-	struct hlist_node	i_hash;
-	struct list_head	i_list;		/* backing dev IO list */
+	struct hlist_bl_node	i_hash;
+	struct hlist_bl_head	*i_hash_bucket;	/* bucket i_hash is on */
+	struct list_head	i_wb_list;	/* backing dev IO list */
+	struct list_head	i_lru;		/* inode LRU list */
 	struct list_head	i_sb_list;
-	struct list_head	i_dentry;
+	union {
+		struct list_head	i_dentry;
+		struct rcu_head		i_rcu;	/* inodes are freed by RCU */
+	};
 	unsigned long		i_ino;
 	atomic_t		i_count;
 	unsigned int		i_nlink;
@@ -747,7 +780,7 @@ struct inode {
 	blkcnt_t		i_blocks;
 	unsigned short          i_bytes;
 	umode_t			i_mode;
-	spinlock_t		i_lock;	/* i_blocks, i_bytes, maybe i_size */
+	spinlock_t		i_lock;	/* i_state, i_blocks, i_bytes, maybe i_size */
 	struct mutex		i_mutex;
 	struct rw_semaphore	i_alloc_sem;
 	const struct inode_operations	*i_op;
@@ -950,10 +983,10 @@ struct file {
 #ifdef CONFIG_DEBUG_WRITECOUNT
 	unsigned long f_mnt_write_state;
 #endif
+#ifdef CONFIG_SMP
+	int			f_sb_list_cpu;	/* cpu whose s_files list has us */
+#endif
 };
-extern spinlock_t files_lock;
-#define file_list_lock() spin_lock(&files_lock);
-#define file_list_unlock() spin_unlock(&files_lock);
 
 #define get_file(x)	atomic_long_inc(&(x)->f_count)
 #define fput_atomic(x)	atomic_long_add_unless(&(x)->f_count, -1, 1)
@@ -1342,10 +1375,16 @@ struct super_block {
 #endif
 	const struct xattr_handler **s_xattr;
 
+	/* s_inodes protected by s_inode_list_lock */
+	spinlock_t		s_inode_list_lock;
 	struct list_head	s_inodes;	/* all inodes */
-	struct hlist_head	s_anon;		/* anonymous dentries for (nfs) exporting */
+	struct hlist_bl_head	s_anon;		/* anonymous dentries for (nfs) exporting */
+#ifdef CONFIG_SMP
+	struct list_head __percpu *s_files;	/* protected by files_lglock */
+#else
 	struct list_head	s_files;
-	/* s_dentry_lru and s_nr_dentry_unused are protected by dcache_lock */
+#endif
+	/* s_dentry_lru, s_nr_dentry_unused protected by dcache_lru_lock */
 	struct list_head	s_dentry_lru;	/* unused dentry lru */
 	int			s_nr_dentry_unused;	/* # of dentry on lru */
 
@@ -1384,6 +1423,9 @@ struct super_block {
 	 * generic_show_options()
 	 */
 	char *s_options;
+
+	/* path walk in RCU mode may still look at a dead superblock */
+	struct rcu_head s_rcu;
 };
 
 extern struct timespec current_fs_time(struct super_block *sb);
@@ -1585,7 +1627,7 @@ struct super_operations {
 };
 
 /*
- * Inode state bits.  Protected by inode_lock.
+ * Inode state bits.  Protected by inode->i_lock.
  *
  * Three bits determine the dirty state of the inode, I_DIRTY_SYNC,
  * I_DIRTY_DATASYNC and I_DIRTY_PAGES.
@@ -2162,6 +2204,7 @@ extern int inode_init_always(struct super_block *, struct inode *);
 extern void inode_init_once(struct inode *);
 extern void inode_add_to_lists(struct super_block *, struct inode *);
 extern void iput(struct inode *);
+extern void ihold(struct inode *);
 extern struct inode * igrab(struct inode *);
 extern ino_t iunique(struct super_block *, ino_t);
 extern int inode_needs_sync(struct inode *inode);
@@ -2197,8 +2240,23 @@ static inline void insert_inode_hash(struct inode *inode) {
 	__insert_inode_hash(inode, inode->i_ino);
 }
 
-extern void file_move(struct file *f, struct list_head *list);
-extern void file_kill(struct file *f);
+static inline int inode_unhashed(struct inode *inode)
+{
+	return hlist_bl_unhashed(&inode->i_hash);
+}
+
+/*
+ * Make an inode look hashed without putting it on the inode hash, for
+ * filesystems whose inodes must not be found by lookups but should still be
+ * cached like hashed ones once unused.
+ */
+static inline void inode_fake_hash(struct inode *inode)
+{
+	hlist_bl_add_fake(&inode->i_hash);
+}
+
+extern void file_sb_list_add(struct file *f, struct super_block *sb);
+extern void file_sb_list_del(struct file *f);
 #ifdef CONFIG_BLOCK
 struct bio;
 extern void submit_bio(int, struct bio *);
@@ -2511,6 +2569,8 @@ ssize_t simple_attr_write(struct file *file, const char __user *buf,
 struct ctl_table;
 int proc_nr_files(struct ctl_table *table, int write,
 		  void __user *buffer, size_t *lenp, loff_t *ppos);
+int proc_nr_inodes(struct ctl_table *table, int write,
+		   void __user *buffer, size_t *lenp, loff_t *ppos);
 
 int __init get_filesystem_list(char *buf);
 
@@ -37,12 +37,28 @@
  *
  * 7.14
  *  - add splice support to fuse device
+ *
+ * 7.23
+ *  - add FUSE_WRITEBACK_CACHE init flag
+ *  - add time_gran to fuse_init_out
+ *
+ * 7.28
+ *  - add FUSE_MAX_PAGES init flag and max_pages field in fuse_init_out
+ *  - add FUSE_DEV_IOC_CLONE ioctl for attaching more channels to a
+ *    connection
+ *
+ * INIT flags, fuse_init_out and the minor version follow the mainline
+ * numbering, so that daemons written against newer headers agree with
+ * this kernel.  Features of the minors in between that are not listed
+ * here are not implemented: they are either negotiated with INIT flags
+ * this kernel does not send or use requests it never issues.
  */
 
 #ifndef _LINUX_FUSE_H
 #define _LINUX_FUSE_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -68,7 +84,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 14
+#define FUSE_KERNEL_MINOR_VERSION 28
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -145,6 +161,8 @@ struct fuse_file_lock {
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_WRITEBACK_CACHE: use writeback cache for buffered writes
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -153,6 +171,8 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_MAX_PAGES		(1 << 22)
 
 /**
  * CUSE INIT request/reply flags
@@ -457,6 +477,10 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	time_gran;
+	__u16	max_pages;
+	__u16	padding;
+	__u32	unused[8];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -568,4 +592,8 @@ struct fuse_notify_inval_entry_out {
 	__u32	padding;
 };
 
+/* Device ioctls: */
+#define FUSE_DEV_IOC_MAGIC		229
+#define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, __u32)
+
 #endif /* _LINUX_FUSE_H */
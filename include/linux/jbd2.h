@@ -275,6 +275,7 @@ typedef struct journal_superblock_s
 
 #include <linux/fs.h>
 #include <linux/sched.h>
+#include <linux/log2.h>
 
 #define J_ASSERT(assert)	BUG_ON(!(assert))
 
@@ -657,11 +658,25 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/*
+ * Log2 histograms of commit and sync batching times in microseconds:
+ * bucket n counts times in [2^n, 2^(n+1)), the last bucket everything
+ * longer.
+ */
+#define JBD2_HIST_BUCKETS	24
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+	unsigned long		ts_commit_hist[JBD2_HIST_BUCKETS];
+	unsigned long		ts_batch_hist[JBD2_HIST_BUCKETS];
 };
 
+static inline int jbd2_hist_bucket(u64 usecs)
+{
+	return usecs ? min_t(int, ilog2(usecs), JBD2_HIST_BUCKETS - 1) : 0;
+}
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -719,6 +734,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  *  transaction
  * @j_commit_request: Sequence number of the most recent transaction wanting
  *     commit
+ * @j_commit_stable: Sequence number of the most recent transaction whose
+ *     commit record is on disk
  * @j_uuid: Uuid of client object.
  * @j_task: Pointer to the current commit thread for this journal
  * @j_max_transaction_buffers:  Maximum number of metadata buffers to allow in a
@@ -899,6 +916,14 @@ struct journal_s
 	 */
 	tid_t			j_commit_request;
 
+	/*
+	 * Sequence number of the most recent transaction whose commit
+	 * record has reached the disk.  Runs ahead of j_commit_sequence
+	 * while the commit thread files the transaction's buffers for
+	 * checkpointing.  [j_state_lock]
+	 */
+	tid_t			j_commit_stable;
+
 	/*
 	 * Journal uuid: identifies the object (filesystem, LVM volume etc)
 	 * backed by this journal.  This will eventually be replaced by an array
@@ -1189,6 +1214,9 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+int jbd2_log_wait_stable(journal_t *journal, tid_t tid);
+void jbd2_log_batch_sync(journal_t *journal, tid_t tid);
+void __jbd2_batch_sleep(journal_t *journal, tid_t tid, ktime_t start_time);
 int jbd2_log_do_checkpoint(journal_t *journal);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
@@ -13,6 +13,7 @@
 #include <linux/list.h>
 #include <linux/nodemask.h>
 #include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #include <asm/atomic.h>
 
 struct super_block;
@@ -81,6 +82,7 @@ struct vfsmount {
 #else
 	int mnt_writers;
 #endif
+	struct rcu_head mnt_rcu;	/* freed by RCU, see path_walk_rcu() */
 };
 
 static inline int *get_mnt_writers_ptr(struct vfsmount *mnt)
@@ -1458,6 +1458,12 @@ struct task_struct {
 	int make_it_fail;
 #endif
 	struct prop_local_single dirties;
+	/*
+	 * Pages dirtied since the last balance_dirty_pages(), and how many
+	 * may be dirtied before it is called again.
+	 */
+	int nr_dirtied;
+	int nr_dirtied_pause;
 #ifdef CONFIG_LATENCYTOP
 	int latency_record_count;
 	struct latency_record latency_record[LT_SAVECOUNT];
@@ -459,6 +459,16 @@ static inline void security_free_mnt_opts(struct security_mnt_opts *opts)
  *	@mask contains the permission mask.
  *	@nd contains the nameidata (may be NULL).
  *	Return 0 if permission is granted.
+ * @inode_exec_permission:
+ *	Check search permission on a directory during pathname resolution.
+ *	Only called with IPERM_FLAG_RCU set in @flags: the caller holds
+ *	rcu_read_lock() and no reference on @inode, so the module must not
+ *	block, audit or touch anything that is not RCU-freed, and returns
+ *	-ECHILD whenever it cannot decide under those rules so that the
+ *	lookup is retried in ref-walk mode.  Ref-walk uses @inode_permission.
+ *	@inode contains the directory inode.
+ *	@flags contains the IPERM_FLAG_* lookup flags.
+ *	Return 0 if permission is granted.
  * @inode_setattr:
  *	Check permission before setting file attributes.  Note that the kernel
  *	call to notify_change is performed from several locations, whenever
@@ -1446,6 +1456,7 @@ struct security_operations {
 	int (*inode_readlink) (struct dentry *dentry);
 	int (*inode_follow_link) (struct dentry *dentry, struct nameidata *nd);
 	int (*inode_permission) (struct inode *inode, int mask);
+	int (*inode_exec_permission) (struct inode *inode, unsigned int flags);
 	int (*inode_setattr)	(struct dentry *dentry, struct iattr *attr);
 	int (*inode_getattr) (struct vfsmount *mnt, struct dentry *dentry);
 	int (*inode_setxattr) (struct dentry *dentry, const char *name,
@@ -1703,6 +1714,7 @@ int security_inode_rename(struct inode *old_dir, struct dentry *old_dentry,
 int security_inode_readlink(struct dentry *dentry);
 int security_inode_follow_link(struct dentry *dentry, struct nameidata *nd);
 int security_inode_permission(struct inode *inode, int mask);
+int security_inode_exec_permission(struct inode *inode, unsigned int flags);
 int security_inode_setattr(struct dentry *dentry, struct iattr *attr);
 int security_inode_getattr(struct vfsmount *mnt, struct dentry *dentry);
 int security_inode_setxattr(struct dentry *dentry, const char *name,
@@ -2092,6 +2104,12 @@ static inline int security_inode_permission(struct inode *inode, int mask)
 	return 0;
 }
 
+static inline int security_inode_exec_permission(struct inode *inode,
+						 unsigned int flags)
+{
+	return 0;
+}
+
 static inline int security_inode_setattr(struct dentry *dentry,
 					  struct iattr *attr)
 {
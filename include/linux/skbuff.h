@@ -170,6 +170,8 @@ struct skb_shared_hwtstamps {
  * @in_progress:	device driver is going to provide
  *			hardware time stamp
  * @prevent_sk_orphan:	make sk reference available on driver level
+ * @zerocopy:		frags are pinned user pages, destructor_arg
+ *			points to the &struct ubuf_info to complete
  * @flags:		all shared_tx flags
  *
  * These flags are attached to packets as part of the
@@ -180,11 +182,28 @@ union skb_shared_tx {
 		__u8	hardware:1,
 			software:1,
 			in_progress:1,
-			prevent_sk_orphan:1;
+			prevent_sk_orphan:1,
+			zerocopy:1;
 	};
 	__u8 flags;
 };
 
+/**
+ * struct ubuf_info - completion of a zerocopy send
+ * @id:		notification id, sequential per socket
+ * @zerocopy:	cleared if the data had to be copied after all
+ * @refcnt:	number of skb data areas still referencing the user pages
+ *
+ * Lives in the control block of the skb that is queued on the socket
+ * error queue once the last reference is dropped, see
+ * sock_zerocopy_alloc().
+ */
+struct ubuf_info {
+	u32		id;
+	u16		zerocopy:1;
+	atomic_t	refcnt;
+};
+
 /* This data is invariant across clones and lives at
  * the end of the header data, ie. at skb->end.
  */
@@ -244,6 +263,11 @@ enum {
 	SKB_GSO_TCPV6 = 1 << 4,
 
 	SKB_GSO_FCOE = 1 << 5,
+
+	/* The TCP segments are carried in GRE or a UDP tunnel. */
+	SKB_GSO_GRE = 1 << 6,
+
+	SKB_GSO_UDP_TUNNEL = 1 << 7,
 };
 
 #if BITS_PER_LONG > 32
@@ -582,6 +606,35 @@ static inline union skb_shared_tx *skb_tx(struct sk_buff *skb)
 	return &skb_shinfo(skb)->tx_flags;
 }
 
+extern struct ubuf_info *sock_zerocopy_alloc(struct sock *sk);
+extern void sock_zerocopy_put(struct ubuf_info *uarg);
+extern void sock_zerocopy_put_abort(struct ubuf_info *uarg);
+extern int skb_zerocopy_add_frag(struct sk_buff *skb, char __user *from,
+				 int copy, struct ubuf_info *uarg);
+
+static inline void sock_zerocopy_get(struct ubuf_info *uarg)
+{
+	atomic_inc(&uarg->refcnt);
+}
+
+/* Returns the completion if the frags of @skb are pinned user pages */
+static inline struct ubuf_info *skb_zcopy(struct sk_buff *skb)
+{
+	if (skb && skb_shinfo(skb)->tx_flags.zerocopy)
+		return skb_shinfo(skb)->destructor_arg;
+	return NULL;
+}
+
+/* Make @skb hold a reference on @uarg, unless it already carries one */
+static inline void skb_zcopy_set(struct sk_buff *skb, struct ubuf_info *uarg)
+{
+	if (uarg && !skb_zcopy(skb)) {
+		sock_zerocopy_get(uarg);
+		skb_shinfo(skb)->destructor_arg = uarg;
+		skb_shinfo(skb)->tx_flags.zerocopy = 1;
+	}
+}
+
 /**
  *	skb_queue_empty - check if a queue is empty
  *	@list: queue head
@@ -811,6 +864,24 @@ static inline struct sk_buff *skb_peek(struct sk_buff_head *list_)
 	return list;
 }
 
+/**
+ *	skb_peek_next - peek skb following the given one from a queue
+ *	@skb: skb to start from
+ *	@list_: list to peek at
+ *
+ *	Returns %NULL when the end of the list is met or a pointer to the
+ *	next element. The reference count is not incremented and the
+ *	reference is therefore volatile. Use with caution.
+ */
+static inline struct sk_buff *skb_peek_next(struct sk_buff *skb,
+		const struct sk_buff_head *list_)
+{
+	struct sk_buff *next = skb->next;
+	if (next == (struct sk_buff *)list_)
+		next = NULL;
+	return next;
+}
+
 /**
  *	skb_peek_tail - peek at the tail of an &sk_buff_head
  *	@list_: list to peek at
@@ -2105,6 +2176,15 @@ static inline bool skb_rx_queue_recorded(const struct sk_buff *skb)
 extern u16 skb_tx_hash(const struct net_device *dev,
 		       const struct sk_buff *skb);
 
+extern __u32 __skb_get_rxhash(struct sk_buff *skb);
+static inline __u32 skb_get_rxhash(struct sk_buff *skb)
+{
+	if (!skb->rxhash)
+		skb->rxhash = __skb_get_rxhash(skb);
+
+	return skb->rxhash;
+}
+
 #ifdef CONFIG_XFRM
 static inline struct sec_path *skb_sec_path(struct sk_buff *skb)
 {
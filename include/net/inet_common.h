@@ -17,6 +17,9 @@ extern int			inet_release(struct socket *sock);
 extern int			inet_stream_connect(struct socket *sock,
 						    struct sockaddr * uaddr,
 						    int addr_len, int flags);
+extern int			__inet_stream_connect(struct socket *sock,
+						      struct sockaddr *uaddr,
+						      int addr_len, int flags);
 extern int			inet_dgram_connect(struct socket *sock, 
 						   struct sockaddr * uaddr,
 						   int addr_len, int flags);
@@ -45,6 +45,10 @@ struct fib_config {
 
 struct fib_info;
 
+/* routes kept per nexthop while the route cache is bypassed */
+#define FIB_NH_RTH_INPUT	4
+#define FIB_NH_RTH_OUTPUT	8
+
 struct fib_nh {
 	struct net_device	*nh_dev;
 	struct hlist_node	nh_hash;
@@ -60,6 +64,8 @@ struct fib_nh {
 #endif
 	int			nh_oif;
 	__be32			nh_gw;
+	struct rtable		*nh_rth_input[FIB_NH_RTH_INPUT];
+	struct rtable		*nh_rth_output[FIB_NH_RTH_OUTPUT];
 };
 
 /*
@@ -74,6 +74,15 @@ print_tuple(struct seq_file *s, const struct nf_conntrack_tuple *tuple,
             const struct nf_conntrack_l3proto *l3proto,
             const struct nf_conntrack_l4proto *proto);
 
+/* nf_conntrack_lock protects expectations and helper assignment only,
+ * the conntrack hash is covered by nf_conntrack_locks[] (by bucket) and
+ * the unconfirmed/dying lists by the per-cpu ct_pcpu locks.  Lock
+ * order is nf_conntrack_lock, bucket locks, ct_pcpu locks.
+ */
 extern spinlock_t nf_conntrack_lock ;
 
+#define CONNTRACK_LOCKS 1024
+extern spinlock_t nf_conntrack_locks[CONNTRACK_LOCKS];
+extern void nf_conntrack_bucket_lock(spinlock_t *lock);
+
 #endif /* _NF_CONNTRACK_CORE_H */
@@ -12,6 +12,7 @@ struct ipv4_devconf;
 struct fib_rules_ops;
 struct hlist_head;
 struct sock;
+struct tcp_fastopen_cache;
 
 struct netns_ipv4 {
 #ifdef CONFIG_SYSCTL
@@ -30,6 +31,7 @@ struct netns_ipv4 {
 
 	struct sock		**icmp_sk;
 	struct sock		*tcp_sock;
+	struct tcp_fastopen_cache *tfo_cache;
 
 	struct netns_frags	frags;
 #ifdef CONFIG_NETFILTER
@@ -54,6 +56,7 @@ struct netns_ipv4 {
 	int sysctl_icmp_errors_use_inbound_ifaddr;
 	int sysctl_rt_cache_rebuild_count;
 	int current_rt_cache_rebuild_count;
+	int sysctl_rt_cache_bypass;
 
 	atomic_t rt_genid;
 
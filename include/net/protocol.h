@@ -36,14 +36,24 @@
 struct net_protocol {
 	int			(*handler)(struct sk_buff *skb);
 	void			(*err_handler)(struct sk_buff *skb, u32 info);
+	unsigned int		no_policy:1,
+				netns_ok:1;
+};
+
+/*
+ * This is used to register GSO and GRO handlers of IP protocols.  They
+ * are kept apart from the receive handler, so that the handlers of a
+ * modular protocol can live in built-in code: GRO may hold its packets
+ * across the protocol module going away.
+ */
+struct net_offload {
 	int			(*gso_send_check)(struct sk_buff *skb);
 	struct sk_buff	       *(*gso_segment)(struct sk_buff *skb,
 					       int features);
 	struct sk_buff	      **(*gro_receive)(struct sk_buff **head,
 					       struct sk_buff *skb);
-	int			(*gro_complete)(struct sk_buff *skb);
-	unsigned int		no_policy:1,
-				netns_ok:1;
+	int			(*gro_complete)(struct sk_buff *skb,
+						int thoff);
 };
 
 #if defined(CONFIG_IPV6) || defined (CONFIG_IPV6_MODULE)
@@ -60,7 +70,7 @@ struct inet6_protocol {
 				       int features);
 	struct sk_buff **(*gro_receive)(struct sk_buff **head,
 					struct sk_buff *skb);
-	int	(*gro_complete)(struct sk_buff *skb);
+	int	(*gro_complete)(struct sk_buff *skb, int thoff);
 
 	unsigned int	flags;	/* INET6_PROTO_xxx */
 };
@@ -90,6 +100,7 @@ struct inet_protosw {
 #define INET_PROTOSW_ICSK      0x04  /* Is this an inet_connection_sock? */
 
 extern const struct net_protocol *inet_protos[MAX_INET_PROTOS];
+extern const struct net_offload *inet_offloads[MAX_INET_PROTOS];
 
 #if defined(CONFIG_IPV6) || defined (CONFIG_IPV6_MODULE)
 extern const struct inet6_protocol *inet6_protos[MAX_INET_PROTOS];
@@ -97,6 +108,8 @@ extern const struct inet6_protocol *inet6_protos[MAX_INET_PROTOS];
 
 extern int	inet_add_protocol(const struct net_protocol *prot, unsigned char num);
 extern int	inet_del_protocol(const struct net_protocol *prot, unsigned char num);
+extern int	inet_add_offload(const struct net_offload *prot, unsigned char num);
+extern int	inet_del_offload(const struct net_offload *prot, unsigned char num);
 extern void	inet_register_protosw(struct inet_protosw *p);
 extern void	inet_unregister_protosw(struct inet_protosw *p);
 
@@ -105,12 +105,26 @@ struct listen_sock {
 	struct request_sock	*syn_table[0];
 };
 
+/** struct fastopen_queue - TCP Fast Open state of a listener
+ *
+ * @lock - protects the reqsk of pending Fast Open children, which is
+ *	   co-owned by the listener and the child socket
+ * @qlen - pending TFO requests (children still in TCP_SYN_RECV)
+ * @max_qlen - max TFO reqs allowed before TFO is disabled, 0 means off
+ */
+struct fastopen_queue {
+	spinlock_t		lock;
+	int			qlen;
+	int			max_qlen;
+};
+
 /** struct request_sock_queue - queue of request_socks
  *
  * @rskq_accept_head - FIFO head of established children
  * @rskq_accept_tail - FIFO tail of established children
  * @rskq_defer_accept - User waits for some data after accept()
  * @syn_wait_lock - serializer
+ * @fastopenq - TCP Fast Open children not yet past the handshake
  *
  * %syn_wait_lock is necessary only to avoid proc interface having to grab the main
  * lock sock while browsing the listening hash (otherwise it's deadlock prone).
@@ -128,6 +142,7 @@ struct request_sock_queue {
 	u8			rskq_defer_accept;
 	/* 3 bytes hole, try to pack */
 	struct listen_sock	*listen_opt;
+	struct fastopen_queue	fastopenq;
 };
 
 extern int reqsk_queue_alloc(struct request_sock_queue *queue,
@@ -135,6 +150,8 @@ extern int reqsk_queue_alloc(struct request_sock_queue *queue,
 
 extern void __reqsk_queue_destroy(struct request_sock_queue *queue);
 extern void reqsk_queue_destroy(struct request_sock_queue *queue);
+extern void reqsk_fastopen_remove(struct sock *sk,
+				  struct request_sock *req);
 
 static inline struct request_sock *
 	reqsk_queue_yank_acceptq(struct request_sock_queue *queue)
@@ -245,4 +245,30 @@ extern void udp_init(void);
 
 extern int udp4_ufo_send_check(struct sk_buff *skb);
 extern struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb, int features);
+
+/*
+ * GRO and GSO for a tunnel on UDP destination port @port.  The
+ * callbacks see the packet from the start of the UDP payload:
+ * @gro_receive and @gro_complete as for a packet_type, @gso_segment
+ * with data at the payload and returning segments as
+ * skb_tunnel_gso_segment() does.  The outer UDP header is taken care
+ * of by the caller.  The tunnel clears SKB_GSO_UDP_TUNNEL from the
+ * gso_type of aggregates it decapsulates.
+ */
+struct udp_offload {
+	__be16			port;
+	struct sk_buff		**(*gro_receive)(struct sk_buff **head,
+						 struct sk_buff *skb);
+	int			(*gro_complete)(struct sk_buff *skb,
+						int nhoff);
+	struct sk_buff		*(*gso_segment)(struct sk_buff *skb,
+						int features);
+	struct list_head	list;
+};
+
+extern int udp_add_offload(struct udp_offload *uo);
+extern void udp_del_offload(struct udp_offload *uo);
+extern struct sk_buff **udp4_gro_receive(struct sk_buff **head,
+					 struct sk_buff *skb);
+extern int udp4_gro_complete(struct sk_buff *skb, int nhoff);
 #endif	/* _UDP_H */
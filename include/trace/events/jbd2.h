@@ -81,6 +81,13 @@ DEFINE_EVENT(jbd2_commit, jbd2_commit_logging,
 	TP_ARGS(journal, commit_transaction)
 );
 
+DEFINE_EVENT(jbd2_commit, jbd2_commit_stable,
+
+	TP_PROTO(journal_t *journal, transaction_t *commit_transaction),
+
+	TP_ARGS(journal, commit_transaction)
+);
+
 TRACE_EVENT(jbd2_end_commit,
 	TP_PROTO(journal_t *journal, transaction_t *commit_transaction),
 
@@ -227,6 +234,32 @@ TRACE_EVENT(jbd2_cleanup_journal_tail,
 		  __entry->first_tid, __entry->block_nr, __entry->freed)
 );
 
+TRACE_EVENT(jbd2_batch_sleep,
+
+	TP_PROTO(journal_t *journal, tid_t tid, u64 running, u64 slept),
+
+	TP_ARGS(journal, tid, running, slept),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,	dev			)
+		__field(	tid_t,	tid			)
+		__field(	u64,	running			)
+		__field(	u64,	slept			)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= journal->j_fs_dev->bd_dev;
+		__entry->tid		= tid;
+		__entry->running	= running;
+		__entry->slept		= slept;
+	),
+
+	TP_printk("dev %s tid %u running %lluus slept %lluus",
+		  jbd2_dev_to_name(__entry->dev), __entry->tid,
+		  div_u64(__entry->running, 1000),
+		  div_u64(__entry->slept, 1000))
+);
+
 #endif /* _TRACE_JBD2_H */
 
 /* This part must be outside protection */
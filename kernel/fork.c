@@ -285,6 +285,8 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	err = prop_local_init_single(&tsk->dirties);
 	if (err)
 		goto out;
+	tsk->nr_dirtied = 0;
+	tsk->nr_dirtied_pause = 128 >> (PAGE_SHIFT - 10);
 
 	setup_thread_stack(tsk, orig);
 	clear_user_return_notifier(tsk);
@@ -0,0 +1,309 @@
+/*
+ * Self test and benchmark for the CRC32 and CRC32c implementations.
+ *
+ * Checks crc32_le(), crc32_be() and __crc32c_le() against a bit at a time
+ * reference for random seeds, lengths and alignments, then checks every
+ * "crc32" and "crc32c" crypto API driver that is available against the
+ * library, and finally reports the throughput of each of them at a range
+ * of buffer sizes, next to a byte at a time table lookup for comparison.
+ *
+ * Load it with "modprobe crc32test"; the results go to the kernel log.
+ * Like tcrypt, the module refuses to stay loaded once it has run.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/hash.h>
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include "crc32defs.h"
+
+#define BUF_SIZE	(64 * 1024)
+#define ALIGN_SLACK	16
+#define NR_RANDOM	1000
+
+/* bytes to checksum per variant and buffer size when benchmarking */
+static unsigned int bench_kb = 4096;
+module_param(bench_kb, uint, 0);
+MODULE_PARM_DESC(bench_kb, "KiB to checksum per measurement (0: no benchmark)");
+
+static const unsigned int bench_sizes[] = {
+	16, 64, 256, 1024, 4096, 65536,
+};
+
+static const struct {
+	const char *name;
+	int castagnoli;
+} drivers[] = {
+	{ "crc32-generic",	0 },
+	{ "crc32-pclmul",	0 },
+	{ "crc32c-generic",	1 },
+	{ "crc32c-intel",	1 },
+};
+
+static u8 *buf;
+static u32 sarwate_table[256];
+static u32 crc32test_sink;
+
+static u32 crc32_le_bitwise(u32 crc, unsigned char const *p, size_t len,
+			    u32 polynomial)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+	}
+	return crc;
+}
+
+static u32 crc32_be_bitwise(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+/* the classic one table, byte at a time lookup, as a baseline */
+static u32 crc32_le_sarwate(u32 crc, unsigned char const *p, size_t len)
+{
+	while (len--)
+		crc = (crc >> 8) ^ sarwate_table[(crc ^ *p++) & 255];
+	return crc;
+}
+
+static void __init sarwate_init(void)
+{
+	u32 crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+		sarwate_table[i] = crc;
+	}
+}
+
+static int __init crc32test_check(const char *name, u32 got, u32 expect)
+{
+	if (got == expect)
+		return 0;
+	printk(KERN_ERR "crc32test: %s: got %08x, expected %08x\n",
+	       name, got, expect);
+	return 1;
+}
+
+static int __init crc32test_lib(void)
+{
+	static const unsigned char check[] = "123456789";
+	unsigned int i, off, len, split;
+	u32 seed;
+	int errors = 0;
+
+	errors += crc32test_check("crc32_le check",
+				  crc32_le(~0, check, 9) ^ ~0, 0xcbf43926);
+	errors += crc32test_check("crc32_be check",
+				  crc32_be(~0, check, 9) ^ ~0, 0xfc891918);
+	errors += crc32test_check("__crc32c_le check",
+				  __crc32c_le(~0, check, 9) ^ ~0, 0xe3069283);
+
+	for (i = 0; i < NR_RANDOM && errors < 10; i++) {
+		off = random32() % ALIGN_SLACK;
+		len = random32() % (i < NR_RANDOM / 2 ? 256 : 4096);
+		split = len ? random32() % len : 0;
+		seed = random32();
+
+		errors += crc32test_check("crc32_le",
+			crc32_le(seed, buf + off, len),
+			crc32_le_bitwise(seed, buf + off, len, CRCPOLY_LE));
+		errors += crc32test_check("crc32_be",
+			crc32_be(seed, buf + off, len),
+			crc32_be_bitwise(seed, buf + off, len));
+		errors += crc32test_check("__crc32c_le",
+			__crc32c_le(seed, buf + off, len),
+			crc32_le_bitwise(seed, buf + off, len, CRC32C_POLY_LE));
+		/* continuing from a partial crc must give the same result */
+		errors += crc32test_check("crc32_le split",
+			crc32_le(crc32_le(seed, buf + off, split),
+				 buf + off + split, len - split),
+			crc32_le(seed, buf + off, len));
+	}
+	return errors;
+}
+
+static struct shash_desc *__init crc32test_alloc_desc(const char *driver)
+{
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+
+	tfm = crypto_alloc_shash(driver, 0, 0);
+	if (IS_ERR(tfm))
+		return NULL;
+
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc) {
+		crypto_free_shash(tfm);
+		return NULL;
+	}
+	desc->tfm = tfm;
+	desc->flags = 0;
+	return desc;
+}
+
+static void __init crc32test_free_desc(struct shash_desc *desc)
+{
+	crypto_free_shash(desc->tfm);
+	kfree(desc);
+}
+
+static int __init crc32test_driver(struct shash_desc *desc, int castagnoli)
+{
+	const char *name = crypto_tfm_alg_driver_name(
+					crypto_shash_tfm(desc->tfm));
+	unsigned int i, off, len;
+	__le32 out;
+	u32 expect;
+	int errors = 0;
+
+	for (i = 0; i < NR_RANDOM && errors < 10; i++) {
+		off = random32() % ALIGN_SLACK;
+		len = random32() % 4096;
+		expect = castagnoli ? __crc32c_le(~0, buf + off, len) :
+				      crc32_le(~0, buf + off, len);
+
+		if (crypto_shash_digest(desc, buf + off, len, (u8 *)&out)) {
+			printk(KERN_ERR "crc32test: %s: digest failed\n", name);
+			return errors + 1;
+		}
+		errors += crc32test_check(name, ~le32_to_cpu(out), expect);
+	}
+	return errors;
+}
+
+/* returns MB/s for checksumming bench_kb KiB in pieces of @size bytes */
+static unsigned long __init crc32test_time(
+		u32 (*fn)(u32, unsigned char const *, size_t),
+		struct shash_desc *desc, unsigned int size)
+{
+	u64 bytes = 0, total = (u64)bench_kb << 10;
+	ktime_t start;
+	s64 ns;
+	u32 out = 0;
+
+	start = ktime_get();
+	while (bytes < total) {
+		if (fn)
+			out = fn(out, buf, size);
+		else
+			crypto_shash_digest(desc, buf, size, (u8 *)&out);
+		bytes += size;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	crc32test_sink ^= out;
+
+	cond_resched();
+	return ns > 0 ? (unsigned long)div64_u64(bytes * 1000, ns) : 0;
+}
+
+static void __init crc32test_bench_line(const char *name,
+		u32 (*fn)(u32, unsigned char const *, size_t),
+		struct shash_desc *desc)
+{
+	char line[16 * ARRAY_SIZE(bench_sizes) + 1];
+	unsigned int i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++)
+		n += scnprintf(line + n, sizeof(line) - n, " %8lu",
+			       crc32test_time(fn, desc, bench_sizes[i]));
+	printk(KERN_INFO "crc32test: %-16s%s\n", name, line);
+}
+
+static void __init crc32test_bench(void)
+{
+	char line[16 * ARRAY_SIZE(bench_sizes) + 1];
+	struct shash_desc *desc;
+	unsigned int i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++)
+		n += scnprintf(line + n, sizeof(line) - n, " %8u",
+			       bench_sizes[i]);
+	printk(KERN_INFO "crc32test: MB/s, lib tables for %d bits at a time\n",
+	       CRC_LE_BITS);
+	printk(KERN_INFO "crc32test: %-16s%s\n", "bytes", line);
+
+	crc32test_bench_line("sarwate", crc32_le_sarwate, NULL);
+	crc32test_bench_line("crc32_le", crc32_le, NULL);
+	crc32test_bench_line("crc32_be", crc32_be, NULL);
+	crc32test_bench_line("__crc32c_le", __crc32c_le, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(drivers); i++) {
+		desc = crc32test_alloc_desc(drivers[i].name);
+		if (!desc)
+			continue;
+		crc32test_bench_line(drivers[i].name, NULL, desc);
+		crc32test_free_desc(desc);
+	}
+}
+
+static int __init crc32test_init(void)
+{
+	struct shash_desc *desc;
+	unsigned int i;
+	int errors;
+
+	buf = vmalloc(BUF_SIZE + ALIGN_SLACK);
+	if (!buf)
+		return -ENOMEM;
+	get_random_bytes(buf, BUF_SIZE + ALIGN_SLACK);
+	sarwate_init();
+
+	errors = crc32test_lib();
+	for (i = 0; i < ARRAY_SIZE(drivers); i++) {
+		desc = crc32test_alloc_desc(drivers[i].name);
+		if (!desc)
+			continue;
+		errors += crc32test_driver(desc, drivers[i].castagnoli);
+		crc32test_free_desc(desc);
+	}
+
+	if (errors) {
+		printk(KERN_ERR "crc32test: %d self tests failed\n", errors);
+	} else {
+		printk(KERN_INFO "crc32test: self tests passed\n");
+		if (bench_kb)
+			crc32test_bench();
+	}
+
+	vfree(buf);
+
+	/* nothing to keep loaded, see tcrypt */
+	return errors ? -EINVAL : -EAGAIN;
+}
+
+static void __exit crc32test_exit(void) { }
+
+module_init(crc32test_init);
+module_exit(crc32test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32 and CRC32c self test and benchmark");
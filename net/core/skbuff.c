@@ -340,6 +340,9 @@ static void skb_release_data(struct sk_buff *skb)
 				put_page(skb_shinfo(skb)->frags[i].page);
 		}
 
+		if (skb_zcopy(skb))
+			sock_zerocopy_put(skb_zcopy(skb));
+
 		if (skb_has_frags(skb))
 			skb_drop_fraglist(skb);
 
@@ -492,6 +495,9 @@ bool skb_recycle_check(struct sk_buff *skb, int skb_size)
 	if (skb_is_nonlinear(skb) || skb->fclone != SKB_FCLONE_UNAVAILABLE)
 		return false;
 
+	if (skb_zcopy(skb))
+		return false;
+
 	skb_size = SKB_DATA_ALIGN(skb_size + NET_SKB_PAD);
 	if (skb_end_pointer(skb) - skb->head < skb_size)
 		return false;
@@ -757,6 +763,7 @@ struct sk_buff *pskb_copy(struct sk_buff *skb, gfp_t gfp_mask)
 			get_page(skb_shinfo(n)->frags[i].page);
 		}
 		skb_shinfo(n)->nr_frags = i;
+		skb_zcopy_set(n, skb_zcopy(skb));
 	}
 
 	if (skb_has_frags(skb)) {
@@ -822,6 +829,10 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 		get_page(skb_shinfo(skb)->frags[i].page);
 
+	/* the new shared info carries its own zerocopy reference */
+	if (skb_zcopy(skb))
+		sock_zerocopy_get(skb_zcopy(skb));
+
 	if (skb_has_frags(skb))
 		skb_clone_fraglist(skb);
 
@@ -2080,6 +2091,8 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 {
 	int pos = skb_headlen(skb);
 
+	skb_zcopy_set(skb1, skb_zcopy(skb));
+
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2122,6 +2135,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* Pinned user pages must stay with their own completion */
+	if (skb_zcopy(tgt) != skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2596,6 +2613,7 @@ struct sk_buff *skb_segment(struct sk_buff *skb, int features)
 		}
 
 		frag = skb_shinfo(nskb)->frags;
+		skb_zcopy_set(nskb, skb_zcopy(skb));
 
 		skb_copy_from_linear_data_offset(skb, offset,
 						 skb_put(nskb, hsize), hsize);
@@ -3039,6 +3057,180 @@ void skb_tstamp_tx(struct sk_buff *orig_skb,
 }
 EXPORT_SYMBOL_GPL(skb_tstamp_tx);
 
+static inline struct sk_buff *skb_from_uarg(struct ubuf_info *uarg)
+{
+	return container_of((void *)uarg, struct sk_buff, cb);
+}
+
+/**
+ *	sock_zerocopy_alloc - allocate the completion of a zerocopy send
+ *	@sk: socket the data is sent on
+ *
+ *	The completion lives in the control block of an empty skb, which
+ *	holds a reference on @sk and becomes the error queue notification
+ *	once the last skb using the pinned pages is freed. The caller owns
+ *	the initial reference and drops it with sock_zerocopy_put().
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+
+	skb = alloc_skb(0, sk->sk_allocation);
+	if (!skb)
+		return NULL;
+
+	sock_hold(sk);
+	skb->sk = sk;
+
+	uarg = (void *)skb->cb;
+	uarg->id = sk->sk_zckey++;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_alloc);
+
+/* Extends the notification at the tail of the error queue if @id follows
+ * it, so a stream of sends completes with few notifications.
+ */
+static bool sock_zerocopy_extend(struct sk_buff *tail, u32 id, u8 code)
+{
+	struct sock_exterr_skb *serr;
+
+	if (!tail)
+		return false;
+	serr = SKB_EXT_ERR(tail);
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    serr->ee.ee_code != code || serr->ee.ee_data + 1 != id)
+		return false;
+
+	serr->ee.ee_data = id;
+	return true;
+}
+
+static void sock_zerocopy_callback(struct ubuf_info *uarg)
+{
+	struct sk_buff *skb = skb_from_uarg(uarg);
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q = &sk->sk_error_queue;
+	struct sock_exterr_skb *serr;
+	unsigned long flags;
+	bool merged;
+	u32 id = uarg->id;
+	u8 code = uarg->zerocopy ? 0 : SO_EE_CODE_ZEROCOPY_COPIED;
+
+	skb->sk = NULL;
+
+	spin_lock_irqsave(&q->lock, flags);
+	merged = sock_zerocopy_extend(skb_peek_tail(q), id, code);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	if (merged) {
+		kfree_skb(skb);
+		goto out;
+	}
+
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = code;
+	serr->ee.ee_info = id;
+	serr->ee.ee_data = id;
+
+	if (sock_queue_err_skb(sk, skb))
+		kfree_skb(skb);
+out:
+	sock_put(sk);
+}
+
+/**
+ *	sock_zerocopy_put - drop a reference on a zerocopy completion
+ *	@uarg: completion
+ *
+ *	Queues the notification for ids [ee_info, ee_data] on the error
+ *	queue of the socket once the last reference is gone.
+ */
+void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg && atomic_dec_and_test(&uarg->refcnt))
+		sock_zerocopy_callback(uarg);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put);
+
+/**
+ *	sock_zerocopy_put_abort - drop the reference of a failed send
+ *	@uarg: completion
+ *
+ *	If no data was queued with @uarg, it is freed without notification
+ *	and its id is given back. Must be called under the socket lock.
+ */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	struct sk_buff *skb;
+	struct sock *sk;
+
+	if (!uarg)
+		return;
+
+	if (atomic_read(&uarg->refcnt) != 1) {
+		sock_zerocopy_put(uarg);
+		return;
+	}
+
+	skb = skb_from_uarg(uarg);
+	sk = skb->sk;
+	sk->sk_zckey--;
+	skb->sk = NULL;
+	kfree_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
+
+/**
+ *	skb_zerocopy_add_frag - append a piece of a user buffer to an skb
+ *	@skb: buffer to append to
+ *	@from: user address of the data
+ *	@copy: number of bytes, must not cross a page boundary
+ *	@uarg: completion the pinned page is charged to
+ *
+ *	Pins the user page backing @from and adds it as a new fragment, or
+ *	extends the last fragment if the data continues it. The caller has
+ *	to make sure a fragment slot is free. Updates the length fields of
+ *	@skb but does no socket memory accounting.
+ */
+int skb_zerocopy_add_frag(struct sk_buff *skb, char __user *from, int copy,
+			  struct ubuf_info *uarg)
+{
+	int i = skb_shinfo(skb)->nr_frags;
+	int off = (unsigned long)from & ~PAGE_MASK;
+	struct page *page;
+
+	BUG_ON(off + copy > PAGE_SIZE);
+
+	if (get_user_pages_fast((unsigned long)from, 1, 0, &page) != 1)
+		return -EFAULT;
+
+	if (skb_can_coalesce(skb, i, page, off)) {
+		skb_shinfo(skb)->frags[i - 1].size += copy;
+		put_page(page);
+	} else {
+		BUG_ON(i >= MAX_SKB_FRAGS);
+		skb_fill_page_desc(skb, i, page, off, copy);
+	}
+	skb_zcopy_set(skb, uarg);
+
+	skb->len += copy;
+	skb->data_len += copy;
+	skb->truesize += copy;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_add_frag);
+
 
 /**
  * skb_partial_csum_set - set up and verify partial csum values for packet
@@ -146,6 +146,7 @@ void free_fib_info(struct fib_info *fi)
 		return;
 	}
 	change_nexthops(fi) {
+		rt_release_nh_routes(nexthop_nh);
 		if (nexthop_nh->nh_dev)
 			dev_put(nexthop_nh->nh_dev);
 		nexthop_nh->nh_dev = NULL;
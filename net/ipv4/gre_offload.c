@@ -0,0 +1,196 @@
+/*
+ *	GRE GRO and GSO for IPv4.
+ *
+ *	Built in even when ip_gre is a module: GRO may hold aggregated GRE
+ *	packets in a NAPI context while the module is unloaded, and
+ *	inet_gro_complete() needs the handler to still be there.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_tunnel.h>
+#include <linux/in.h>
+#include <net/checksum.h>
+#include <net/protocol.h>
+
+/*
+ * Only version 0 headers with at most a key and a checksum are
+ * aggregated: sequence numbers differ from one packet to the next and
+ * routing headers are not supported at all.
+ */
+static unsigned int gre_gro_hlen(__be16 flags)
+{
+	unsigned int hlen = 4;
+
+	if (flags & GRE_CSUM)
+		hlen += 4;
+	if (flags & GRE_KEY)
+		hlen += 4;
+	return hlen;
+}
+
+static struct sk_buff **gre_gro_receive(struct sk_buff **head,
+					struct sk_buff *skb)
+{
+	struct packet_type *ptype;
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	unsigned int grehlen;
+	unsigned int hlen;
+	unsigned int off;
+	__be16 *greh;
+	int flush = 1;
+	__wsum csum;
+
+	off = skb_gro_offset(skb);
+	hlen = off + 4;
+	greh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	if (greh[0] & ~(GRE_CSUM | GRE_KEY))
+		goto out;
+
+	grehlen = gre_gro_hlen(greh[0]);
+	hlen = off + grehlen;
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	/* The outer IP header sums to zero, so skb->csum is that of the
+	 * GRE header and payload, which is zero if the GRE checksum is good.
+	 */
+	if ((greh[0] & GRE_CSUM) && skb->ip_summed == CHECKSUM_COMPLETE &&
+	    csum_fold(skb->csum))
+		goto out;
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(greh[1]);
+	if (!ptype)
+		goto out_unlock;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		__be16 *greh2;
+
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		/* Flags, protocol and key must match, the checksum need not */
+		greh2 = skb_gro_held_header(p, skb, off);
+		if (*(__be32 *)greh != *(__be32 *)greh2 ||
+		    ((greh[0] & GRE_KEY) &&
+		     *(__be32 *)((u8 *)greh + grehlen - 4) !=
+		     *(__be32 *)((u8 *)greh2 + grehlen - 4))) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, grehlen);
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, greh, grehlen);
+
+	pp = ptype->gro_receive(head, skb);
+
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+static int gre_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	__be16 *greh = (__be16 *)(skb->data + nhoff);
+	struct packet_type *ptype;
+	int err = -ENOENT;
+
+	/* The GRE checksum goes stale, the merged packet is marked
+	 * CHECKSUM_PARTIAL by TCP so ipgre_rcv() does not look at it.
+	 */
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(greh[1]);
+	if (ptype)
+		err = ptype->gro_complete(skb, nhoff +
+					  gre_gro_hlen(greh[0]));
+	rcu_read_unlock();
+
+	/* after the inner protocol, which sets the gso_type */
+	if (!err)
+		skb_shinfo(skb)->gso_type |= SKB_GSO_GRE;
+
+	return err;
+}
+
+/* Splits up an aggregate from gre_gro_receive() that is forwarded */
+static struct sk_buff *gre_gso_segment(struct sk_buff *skb, int features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	unsigned int grehlen, greoff;
+	__be16 *greh;
+	__be16 protocol;
+	bool csum;
+
+	if (!(skb_shinfo(skb)->gso_type & SKB_GSO_GRE) ||
+	    !pskb_may_pull(skb, 4))
+		goto out;
+
+	greh = (__be16 *)skb->data;
+	if (greh[0] & ~(GRE_CSUM | GRE_KEY))
+		goto out;
+
+	grehlen = gre_gro_hlen(greh[0]);
+	if (!pskb_may_pull(skb, grehlen))
+		goto out;
+
+	greh = (__be16 *)skb->data;
+	csum = !!(greh[0] & GRE_CSUM);
+	protocol = greh[1];
+
+	__skb_pull(skb, grehlen);
+	segs = skb_tunnel_gso_segment(skb, protocol);
+	__skb_push(skb, grehlen);
+
+	if (IS_ERR_OR_NULL(segs) || !csum)
+		goto out;
+
+	greoff = skb_transport_header(skb) - skb_mac_header(skb);
+	for (skb = segs; skb; skb = skb->next) {
+		__sum16 *check = (__sum16 *)(skb_transport_header(skb) + 4);
+
+		*check = 0;
+		*check = csum_fold(skb_checksum(skb, greoff,
+						skb->len - greoff, 0));
+	}
+out:
+	return segs;
+}
+
+static const struct net_offload gre_offload = {
+	.gso_segment	=	gre_gso_segment,
+	.gro_receive	=	gre_gro_receive,
+	.gro_complete	=	gre_gro_complete,
+};
+
+static int __init gre_offload_init(void)
+{
+	return inet_add_offload(&gre_offload, IPPROTO_GRE);
+}
+device_initcall(gre_offload_init);
@@ -645,6 +645,9 @@ static int ipgre_rcv(struct sk_buff *skb)
 		skb_reset_network_header(skb);
 		ipgre_ecn_decapsulate(iph, skb);
 
+		/* an aggregate from GRO is now plain TCP */
+		skb_shinfo(skb)->gso_type &= ~SKB_GSO_GRE;
+
 		netif_rx(skb);
 		rcu_read_unlock();
 		return(0);
@@ -1275,7 +1278,6 @@ static void ipgre_fb_tunnel_init(struct net_device *dev)
 	ign->tunnels_wc[0]	= tunnel;
 }
 
-
 static const struct net_protocol ipgre_protocol = {
 	.handler	=	ipgre_rcv,
 	.err_handler	=	ipgre_err,
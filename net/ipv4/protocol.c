@@ -29,6 +29,7 @@
 #include <net/protocol.h>
 
 const struct net_protocol *inet_protos[MAX_INET_PROTOS] ____cacheline_aligned_in_smp;
+const struct net_offload *inet_offloads[MAX_INET_PROTOS] __read_mostly;
 static DEFINE_SPINLOCK(inet_proto_lock);
 
 /*
@@ -77,5 +78,49 @@ int inet_del_protocol(const struct net_protocol *prot, unsigned char protocol)
 	return ret;
 }
 
+/*
+ *	Add and remove the GSO/GRO handlers of a protocol.
+ */
+
+int inet_add_offload(const struct net_offload *prot, unsigned char protocol)
+{
+	int hash, ret;
+
+	hash = protocol & (MAX_INET_PROTOS - 1);
+
+	spin_lock_bh(&inet_proto_lock);
+	if (inet_offloads[hash]) {
+		ret = -1;
+	} else {
+		inet_offloads[hash] = prot;
+		ret = 0;
+	}
+	spin_unlock_bh(&inet_proto_lock);
+
+	return ret;
+}
+
+int inet_del_offload(const struct net_offload *prot, unsigned char protocol)
+{
+	int hash, ret;
+
+	hash = protocol & (MAX_INET_PROTOS - 1);
+
+	spin_lock_bh(&inet_proto_lock);
+	if (inet_offloads[hash] == prot) {
+		inet_offloads[hash] = NULL;
+		ret = 0;
+	} else {
+		ret = -1;
+	}
+	spin_unlock_bh(&inet_proto_lock);
+
+	synchronize_net();
+
+	return ret;
+}
+
 EXPORT_SYMBOL(inet_add_protocol);
 EXPORT_SYMBOL(inet_del_protocol);
+EXPORT_SYMBOL(inet_add_offload);
+EXPORT_SYMBOL(inet_del_offload);
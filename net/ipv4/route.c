@@ -677,7 +677,8 @@ static inline u32 rt_score(struct rtable *rt)
 
 static inline bool rt_caching(const struct net *net)
 {
-	return net->ipv4.current_rt_cache_rebuild_count <=
+	return !net->ipv4.sysctl_rt_cache_bypass &&
+		net->ipv4.current_rt_cache_rebuild_count <=
 		net->ipv4.sysctl_rt_cache_rebuild_count;
 }
 
@@ -709,6 +710,73 @@ static inline int rt_is_expired(struct rtable *rth)
 	return rth->rt_genid != rt_genid(dev_net(rth->u.dst.dev));
 }
 
+/*
+ * Nexthop route slots.
+ *
+ * While the route cache is bypassed, routes that come out the same for
+ * every lookup with the same key are kept in a few slots hung off the
+ * FIB nexthop instead of being allocated per lookup:
+ *  - forwarded packets whose route does not depend on the flow (a
+ *    gateway nexthop, no redirect, no source validation tag) share one
+ *    input route per input device, in the slot picked by its ifindex;
+ *  - output routes are kept per lookup key (destination, source, oif,
+ *    tos, mark), in the slot picked by a hash of the key.
+ * A slot holding a route for another key, or a stale one, is simply
+ * replaced, so keys that map to the same slot take turns.  The slot
+ * owns one reference; readers run under rcu_read_lock_bh(), a replaced
+ * route is released through rt_drop().
+ */
+static inline bool rt_nh_slot_valid(struct rtable *rth)
+{
+	return !rt_is_expired(rth) &&
+		!(rth->u.dst.expires &&
+		  time_after_eq(jiffies, rth->u.dst.expires));
+}
+
+static inline struct rtable **rt_nh_input_slot(struct fib_nh *nh, int iif)
+{
+	return &nh->nh_rth_input[iif & (FIB_NH_RTH_INPUT - 1)];
+}
+
+static inline struct rtable **rt_nh_output_slot(struct fib_nh *nh,
+						const struct flowi *flp)
+{
+	u32 hash = jhash_3words((__force u32)flp->fl4_dst,
+				(__force u32)flp->fl4_src, flp->oif, 0);
+
+	return &nh->nh_rth_output[hash & (FIB_NH_RTH_OUTPUT - 1)];
+}
+
+static inline bool rt_nh_output_match(struct rtable *rth,
+				      const struct flowi *flp)
+{
+	return rth->fl.fl4_dst == flp->fl4_dst &&
+		rth->fl.fl4_src == flp->fl4_src &&
+		rth->fl.oif == flp->oif &&
+		rth->fl.mark == flp->mark &&
+		!((rth->fl.fl4_tos ^ flp->fl4_tos) &
+		  (IPTOS_RT_MASK | RTO_ONLINK));
+}
+
+static void rt_set_nh_slot(struct rtable **slot, struct rtable *rt)
+{
+	struct rtable *orig;
+
+	orig = xchg(slot, rt);
+	if (orig)
+		rt_drop(orig);
+}
+
+void rt_release_nh_routes(struct fib_nh *nh)
+{
+	int i;
+
+	for (i = 0; i < FIB_NH_RTH_INPUT; i++)
+		rt_set_nh_slot(&nh->nh_rth_input[i], NULL);
+	for (i = 0; i < FIB_NH_RTH_OUTPUT; i++)
+		rt_set_nh_slot(&nh->nh_rth_output[i], NULL);
+}
+
 /*
  * Perform a full scan of hash table and free all entries.
  * Can be called by a softirq or a process.
@@ -1956,19 +2024,24 @@ static void ip_handle_martian_source(struct net_device *dev,
 #endif
 }
 
+/*
+ * On success *result is the new route, or NULL when a nexthop route
+ * was attached to the skb directly.
+ */
 static int __mkroute_input(struct sk_buff *skb,
 			   struct fib_result *res,
 			   struct in_device *in_dev,
 			   __be32 daddr, __be32 saddr, u32 tos,
-			   struct rtable **result)
+			   bool noref, struct rtable **result)
 {
 
-	struct rtable *rth;
+	struct rtable *rth, **slot = NULL;
 	int err;
 	struct in_device *out_dev;
 	unsigned flags = 0;
 	__be32 spec_dst;
 	u32 itag;
+	bool do_cache;
 
 	/* get a working reference to the output device */
 	out_dev = in_dev_get(FIB_RES_DEV(*res));
@@ -2013,6 +2086,29 @@ static int __mkroute_input(struct sk_buff *skb,
 		}
 	}
 
+	/* Only routes that look the same for every flow through this
+	 * nexthop can be shared: no redirect or source flags, no realm,
+	 * no IP options (they read rt_dst and rt_spec_dst), and a gateway
+	 * so that rt_gateway and the bound neighbour are per nexthop.
+	 */
+	do_cache = noref && !flags && !itag &&
+		   !rt_caching(dev_net(in_dev->dev)) &&
+		   skb->protocol == htons(ETH_P_IP) &&
+		   ip_hdr(skb)->ihl == 5 &&
+		   FIB_RES_GW(*res) &&
+		   FIB_RES_NH(*res).nh_scope == RT_SCOPE_LINK;
+	if (do_cache) {
+		slot = rt_nh_input_slot(&FIB_RES_NH(*res),
+					in_dev->dev->ifindex);
+		rth = rcu_dereference_bh(*slot);
+		if (rth && rth->fl.iif == in_dev->dev->ifindex &&
+		    rt_nh_slot_valid(rth)) {
+			skb_dst_set_noref(skb, &rth->u.dst);
+			*result = NULL;
+			err = 0;
+			goto cleanup;
+		}
+	}
 
 	rth = dst_alloc(&ipv4_dst_ops);
 	if (!rth) {
@@ -2050,6 +2146,18 @@ static int __mkroute_input(struct sk_buff *skb,
 
 	rth->rt_flags = flags;
 
+	if (do_cache) {
+		err = arp_bind_neighbour(&rth->u.dst);
+		if (err) {
+			rt_drop(rth);
+			goto cleanup;
+		}
+		/* the nexthop slot takes over our reference */
+		rt_set_nh_slot(slot, rth);
+		skb_dst_set_noref(skb, &rth->u.dst);
+		rth = NULL;
+	}
+
 	*result = rth;
 	err = 0;
  cleanup:
@@ -2062,7 +2170,8 @@ static int ip_mkroute_input(struct sk_buff *skb,
 			    struct fib_result *res,
 			    const struct flowi *fl,
 			    struct in_device *in_dev,
-			    __be32 daddr, __be32 saddr, u32 tos)
+			    __be32 daddr, __be32 saddr, u32 tos,
+			    bool noref)
 {
 	struct rtable* rth = NULL;
 	int err;
@@ -2074,8 +2183,9 @@ static int ip_mkroute_input(struct sk_buff *skb,
 #endif
 
 	/* create a routing cache entry */
-	err = __mkroute_input(skb, res, in_dev, daddr, saddr, tos, &rth);
-	if (err)
+	err = __mkroute_input(skb, res, in_dev, daddr, saddr, tos, noref,
+			      &rth);
+	if (err || !rth)
 		return err;
 
 	/* put it into the cache */
@@ -2095,7 +2205,7 @@ static int ip_mkroute_input(struct sk_buff *skb,
  */
 
 static int ip_route_input_slow(struct sk_buff *skb, __be32 daddr, __be32 saddr,
-			       u8 tos, struct net_device *dev)
+			       u8 tos, struct net_device *dev, bool noref)
 {
 	struct fib_result res;
 	struct in_device *in_dev = in_dev_get(dev);
@@ -2175,7 +2285,8 @@ static int ip_route_input_slow(struct sk_buff *skb, __be32 daddr, __be32 saddr,
 	if (res.type != RTN_UNICAST)
 		goto martian_destination;
 
-	err = ip_mkroute_input(skb, &res, &fl, in_dev, daddr, saddr, tos);
+	err = ip_mkroute_input(skb, &res, &fl, in_dev, daddr, saddr, tos,
+			       noref);
 done:
 	in_dev_put(in_dev);
 	if (free_res)
@@ -2353,7 +2464,7 @@ skip_cache:
 		rcu_read_unlock();
 		return -EINVAL;
 	}
-	return ip_route_input_slow(skb, daddr, saddr, tos, dev);
+	return ip_route_input_slow(skb, daddr, saddr, tos, dev, noref);
 }
 EXPORT_SYMBOL(ip_route_input_common);
 
@@ -2485,16 +2596,48 @@ static int ip_mkroute_output(struct rtable **rp,
 			     struct net_device *dev_out,
 			     unsigned flags)
 {
-	struct rtable *rth = NULL;
-	int err = __mkroute_output(&rth, res, fl, oldflp, dev_out, flags);
+	struct rtable *rth = NULL, **slot = NULL;
+	int err;
 	unsigned hash;
-	if (err == 0) {
-		hash = rt_hash(oldflp->fl4_dst, oldflp->fl4_src, oldflp->oif,
-			       rt_genid(dev_net(dev_out)));
-		err = rt_intern_hash(hash, rth, rp, NULL, oldflp->oif);
+
+	/* Without the cache, plain unicast routes are kept per nexthop */
+	if (!rt_caching(dev_net(dev_out)) && !flags && res->fi &&
+	    res->type == RTN_UNICAST && !(dev_out->flags & IFF_LOOPBACK) &&
+	    !ipv4_is_multicast(fl->fl4_dst) && !ipv4_is_lbcast(fl->fl4_dst)) {
+		slot = rt_nh_output_slot(&FIB_RES_NH(*res), oldflp);
+		rcu_read_lock_bh();
+		rth = rcu_dereference_bh(*slot);
+		if (rth && rt_nh_output_match(rth, oldflp) &&
+		    rt_nh_slot_valid(rth)) {
+			dst_use(&rth->u.dst, jiffies);
+			rcu_read_unlock_bh();
+			*rp = rth;
+			return 0;
+		}
+		rcu_read_unlock_bh();
+		rth = NULL;
 	}
 
-	return err;
+	err = __mkroute_output(&rth, res, fl, oldflp, dev_out, flags);
+	if (err)
+		return err;
+
+	if (slot) {
+		err = arp_bind_neighbour(&rth->u.dst);
+		if (err) {
+			rt_drop(rth);
+			return err;
+		}
+		/* one reference for the slot, one for the caller */
+		dst_hold(&rth->u.dst);
+		rt_set_nh_slot(slot, rth);
+		*rp = rth;
+		return 0;
+	}
+
+	hash = rt_hash(oldflp->fl4_dst, oldflp->fl4_src, oldflp->oif,
+		       rt_genid(dev_net(dev_out)));
+	return rt_intern_hash(hash, rth, rp, NULL, oldflp->oif);
 }
 
 /*
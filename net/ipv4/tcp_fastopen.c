@@ -0,0 +1,245 @@
+/*
+ * TCP Fast Open: data in the SYN, accepted by the server when the SYN
+ * carries a cookie that the server handed out on an earlier connection.
+ *
+ * The server side cookie is the client address encrypted with a local
+ * AES key, see tcp_fastopen_cookie_gen().  The client remembers cookies
+ * per destination in a small table below, one per network namespace.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/jiffies.h>
+#include <linux/random.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/crypto.h>
+#include <linux/ipv6.h>
+#include <net/inet_sock.h>
+#include <net/net_namespace.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+struct tcp_fastopen_context *tcp_fastopen_ctx;
+
+static DEFINE_SPINLOCK(tcp_fastopen_ctx_lock);
+
+static void tcp_fastopen_ctx_free(struct rcu_head *head)
+{
+	struct tcp_fastopen_context *ctx =
+	    container_of(head, struct tcp_fastopen_context, rcu);
+	crypto_free_cipher(ctx->tfm);
+	kfree(ctx);
+}
+
+int tcp_fastopen_reset_cipher(void *key, unsigned int len)
+{
+	int err;
+	struct tcp_fastopen_context *ctx, *octx;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->tfm = crypto_alloc_cipher("aes", 0, 0);
+
+	if (IS_ERR(ctx->tfm)) {
+		err = PTR_ERR(ctx->tfm);
+error:		kfree(ctx);
+		pr_err("TCP: TFO aes cipher alloc error: %d\n", err);
+		return err;
+	}
+	err = crypto_cipher_setkey(ctx->tfm, key, len);
+	if (err) {
+		pr_err("TCP: TFO cipher key error: %d\n", err);
+		crypto_free_cipher(ctx->tfm);
+		goto error;
+	}
+	memcpy(ctx->key, key, len);
+
+	spin_lock(&tcp_fastopen_ctx_lock);
+
+	octx = rcu_dereference_protected(tcp_fastopen_ctx,
+				lockdep_is_held(&tcp_fastopen_ctx_lock));
+	rcu_assign_pointer(tcp_fastopen_ctx, ctx);
+	spin_unlock(&tcp_fastopen_ctx_lock);
+
+	if (octx)
+		call_rcu(&octx->rcu, tcp_fastopen_ctx_free);
+	return err;
+}
+
+/* Computes the fastopen cookie for the peer.
+ * The peer address is a 128 bits long (pad with zeros for IPv4).
+ *
+ * The caller must check foc->len to determine if a valid cookie
+ * has been generated successfully.
+*/
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__be32 peer_addr[4] = { addr, 0, 0, 0 };
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx) {
+		crypto_cipher_encrypt_one(ctx->tfm,
+					  foc->val,
+					  (__u8 *)peer_addr);
+		foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Client side cookie cache.  Each destination hashes to a bucket of a
+ * few entries; a new destination takes the least recently updated one.
+ * Only connect() and the SYN-ACK of a Fast Open touch it, so a single
+ * lock per namespace does.
+ */
+#define TFO_CACHE_BITS		6
+#define TFO_CACHE_BUCKETS	(1 << TFO_CACHE_BITS)
+#define TFO_CACHE_DEPTH		4
+
+struct tcp_fastopen_cache_entry {
+	unsigned long			stamp;	/* 0 if unused */
+	unsigned long			last_syn_loss;
+	__be32				addr[4];
+	u16				family;
+	u16				mss;
+	u16				syn_loss;
+	struct tcp_fastopen_cookie	cookie;
+};
+
+struct tcp_fastopen_cache {
+	spinlock_t			lock;
+	struct tcp_fastopen_cache_entry	bucket[TFO_CACHE_BUCKETS]
+					      [TFO_CACHE_DEPTH];
+};
+
+static void tfo_cache_key(struct sock *sk, __be32 *addr)
+{
+	memset(addr, 0, 4 * sizeof(__be32));
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+	if (sk->sk_family == AF_INET6) {
+		memcpy(addr, &inet6_sk(sk)->daddr, 4 * sizeof(__be32));
+		return;
+	}
+#endif
+	addr[0] = inet_sk(sk)->inet_daddr;
+}
+
+static struct tcp_fastopen_cache_entry *
+tfo_cache_lookup(struct tcp_fastopen_cache *cache, struct sock *sk,
+		 bool create)
+{
+	struct tcp_fastopen_cache_entry *bucket, *e, *oldest;
+	__be32 addr[4];
+	int i;
+
+	tfo_cache_key(sk, addr);
+	bucket = cache->bucket[jhash2((u32 *)addr, 4, sk->sk_family) &
+			       (TFO_CACHE_BUCKETS - 1)];
+
+	oldest = bucket;
+	for (i = 0; i < TFO_CACHE_DEPTH; i++) {
+		e = &bucket[i];
+		if (e->stamp && e->family == sk->sk_family &&
+		    !memcmp(e->addr, addr, sizeof(addr)))
+			return e;
+		if (!e->stamp ||
+		    (oldest->stamp && time_before(e->stamp, oldest->stamp)))
+			oldest = e;
+	}
+	if (!create)
+		return NULL;
+
+	memset(oldest, 0, sizeof(*oldest));
+	memcpy(oldest->addr, addr, sizeof(addr));
+	oldest->family = sk->sk_family;
+	oldest->cookie.len = 0;
+	return oldest;
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct tcp_fastopen_cache *cache = sock_net(sk)->ipv4.tfo_cache;
+	struct tcp_fastopen_cache_entry *e;
+
+	if (!cache)
+		return;
+
+	spin_lock_bh(&cache->lock);
+	e = tfo_cache_lookup(cache, sk, false);
+	if (e) {
+		if (e->mss)
+			*mss = e->mss;
+		*cookie = e->cookie;
+		*syn_loss = e->syn_loss;
+		*last_syn_loss = *syn_loss ? e->last_syn_loss : 0;
+	}
+	spin_unlock_bh(&cache->lock);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct tcp_fastopen_cache *cache = sock_net(sk)->ipv4.tfo_cache;
+	struct tcp_fastopen_cache_entry *e;
+
+	if (!cache)
+		return;
+
+	spin_lock_bh(&cache->lock);
+	e = tfo_cache_lookup(cache, sk, true);
+	if (mss)
+		e->mss = mss;
+	if (!syn_lost) {
+		e->syn_loss = 0;
+	} else {
+		e->syn_loss++;
+		e->last_syn_loss = jiffies;
+	}
+	if (cookie->len > 0)
+		e->cookie = *cookie;
+	e->stamp = jiffies ? : 1;
+	spin_unlock_bh(&cache->lock);
+}
+
+static int __net_init tcp_fastopen_net_init(struct net *net)
+{
+	struct tcp_fastopen_cache *cache;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return -ENOMEM;
+	spin_lock_init(&cache->lock);
+	net->ipv4.tfo_cache = cache;
+	return 0;
+}
+
+static void __net_exit tcp_fastopen_net_exit(struct net *net)
+{
+	kfree(net->ipv4.tfo_cache);
+	net->ipv4.tfo_cache = NULL;
+}
+
+static struct pernet_operations tcp_fastopen_net_ops = {
+	.init = tcp_fastopen_net_init,
+	.exit = tcp_fastopen_net_exit,
+};
+
+static int __init tcp_fastopen_init(void)
+{
+	__u8 key[TCP_FASTOPEN_KEY_LENGTH];
+
+	get_random_bytes(key, sizeof(key));
+	tcp_fastopen_reset_cipher(key, sizeof(key));
+	return register_pernet_subsys(&tcp_fastopen_net_ops);
+}
+
+late_initcall(tcp_fastopen_init);
@@ -2202,6 +2202,202 @@ int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/*
+ * Tunnels over UDP register the destination port they listen on here,
+ * for GRO to aggregate what they carry and for GSO to split it up again
+ * when the aggregate is forwarded instead.  Lookups are done under RCU
+ * from the receive and transmit paths.
+ */
+static LIST_HEAD(udp_offload_list);
+static DEFINE_SPINLOCK(udp_offload_lock);
+
+int udp_add_offload(struct udp_offload *uo)
+{
+	struct udp_offload *tmp;
+	int err = 0;
+
+	spin_lock(&udp_offload_lock);
+	list_for_each_entry(tmp, &udp_offload_list, list) {
+		if (tmp->port == uo->port) {
+			err = -EEXIST;
+			goto out;
+		}
+	}
+	list_add_rcu(&uo->list, &udp_offload_list);
+out:
+	spin_unlock(&udp_offload_lock);
+	return err;
+}
+EXPORT_SYMBOL(udp_add_offload);
+
+void udp_del_offload(struct udp_offload *uo)
+{
+	spin_lock(&udp_offload_lock);
+	list_del_rcu(&uo->list);
+	spin_unlock(&udp_offload_lock);
+
+	synchronize_net();
+}
+EXPORT_SYMBOL(udp_del_offload);
+
+static struct udp_offload *udp_offload_lookup(__be16 port)
+{
+	struct udp_offload *uo;
+
+	list_for_each_entry_rcu(uo, &udp_offload_list, list) {
+		if (uo->port == port)
+			return uo;
+	}
+	return NULL;
+}
+
+struct sk_buff **udp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	struct udp_offload *uo;
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	struct udphdr *uh;
+	struct iphdr *iph;
+	unsigned int hlen;
+	unsigned int off;
+	int flush = 1;
+	__wsum csum;
+
+	if (list_empty(&udp_offload_list))
+		goto out;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*uh);
+	uh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto out;
+	}
+
+	if (ntohs(uh->len) != skb_gro_len(skb))
+		goto out;
+
+	/* A datagram with the checksum in use sums to zero, pseudo
+	 * header included.  Without it the inner packet is checked.
+	 */
+	if (uh->check) {
+		if (skb->ip_summed != CHECKSUM_COMPLETE)
+			goto out;
+		iph = skb_gro_network_header(skb);
+		if (csum_tcpudp_magic(iph->saddr, iph->daddr,
+				      skb_gro_len(skb), IPPROTO_UDP,
+				      skb->csum))
+			goto out;
+	}
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(uh->dest);
+	if (!uo)
+		goto out_unlock;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		struct udphdr *uh2;
+
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = skb_gro_held_header(p, skb, off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, sizeof(*uh));
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, uh, sizeof(*uh));
+
+	pp = uo->gro_receive(head, skb);
+
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+int udp4_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+	struct udp_offload *uo;
+	int err = -ENOSYS;
+
+	/* The checksum goes stale here, the merged packet is marked
+	 * CHECKSUM_PARTIAL by TCP so nobody looks at it on receive and
+	 * segmentation computes it afresh.
+	 */
+	uh->len = htons(skb->len - nhoff);
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(uh->dest);
+	if (uo)
+		err = uo->gro_complete(skb, nhoff + sizeof(*uh));
+	rcu_read_unlock();
+
+	if (!err)
+		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL;
+
+	return err;
+}
+
+static struct sk_buff *udp4_tunnel_segment(struct sk_buff *skb, int features)
+{
+	struct sk_buff *segs = ERR_PTR(-EPROTONOSUPPORT);
+	struct udp_offload *uo;
+	struct udphdr *uh;
+	struct iphdr *iph;
+	unsigned int uhoff, len;
+	bool csum;
+
+	if (!pskb_may_pull(skb, sizeof(*uh)))
+		return ERR_PTR(-EINVAL);
+
+	uh = udp_hdr(skb);
+	csum = !!uh->check;
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(uh->dest);
+	if (uo && uo->gso_segment) {
+		__skb_pull(skb, sizeof(*uh));
+		segs = uo->gso_segment(skb, features);
+		__skb_push(skb, sizeof(*uh));
+	}
+	rcu_read_unlock();
+
+	if (IS_ERR_OR_NULL(segs))
+		return segs;
+
+	uhoff = skb_transport_header(skb) - skb_mac_header(skb);
+	for (skb = segs; skb; skb = skb->next) {
+		len = skb->len - uhoff;
+		uh = udp_hdr(skb);
+		uh->len = htons(len);
+		if (!csum)
+			continue;
+
+		iph = ip_hdr(skb);
+		uh->check = 0;
+		uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr, len,
+					      IPPROTO_UDP,
+					      skb_checksum(skb, uhoff, len, 0));
+		if (!uh->check)
+			uh->check = CSUM_MANGLED_0;
+	}
+
+	return segs;
+}
+
 struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb, int features)
 {
 	struct sk_buff *segs = ERR_PTR(-EINVAL);
@@ -2209,6 +2405,9 @@ struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb, int features)
 	int offset;
 	__wsum csum;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_TUNNEL)
+		return udp4_tunnel_segment(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
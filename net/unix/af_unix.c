@@ -133,12 +133,22 @@ static inline void unix_set_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 {
 	scm->secid = *UNIXSID(skb);
 }
+
+static inline bool unix_secdata_eq(struct scm_cookie *scm, struct sk_buff *skb)
+{
+	return scm->secid == *UNIXSID(skb);
+}
 #else
 static inline void unix_get_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 { }
 
 static inline void unix_set_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 { }
+
+static inline bool unix_secdata_eq(struct scm_cookie *scm, struct sk_buff *skb)
+{
+	return true;
+}
 #endif /* CONFIG_SECURITY_NETWORK */
 
 /*
@@ -505,6 +515,15 @@ static int unix_dgram_connect(struct socket *, struct sockaddr *,
 static int unix_seqpacket_sendmsg(struct kiocb *, struct socket *,
 				  struct msghdr *, size_t);
 
+static void unix_set_peek_off(struct sock *sk, int val)
+{
+	struct unix_sock *u = unix_sk(sk);
+
+	mutex_lock(&u->readlock);
+	sk->sk_peek_off = val;
+	mutex_unlock(&u->readlock);
+}
+
 static const struct proto_ops unix_stream_ops = {
 	.family =	PF_UNIX,
 	.owner =	THIS_MODULE,
@@ -524,6 +543,7 @@ static const struct proto_ops unix_stream_ops = {
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
 	.sendpage =	sock_no_sendpage,
+	.set_peek_off =	unix_set_peek_off,
 };
 
 static const struct proto_ops unix_dgram_ops = {
@@ -1525,6 +1545,70 @@ out:
 }
 
 
+/*
+ * Writes of up to UNIX_STREAM_COALESCE_MAX bytes without fds are
+ * appended to the last skb on the peer's queue if we queued it with the
+ * same credentials and security label and the reader has not got to it
+ * yet, and new small skbs are allocated with
+ * room for that.
+ */
+#define UNIX_STREAM_COALESCE_MAX	512
+#define UNIX_STREAM_COALESCE_SKB	SKB_WITH_OVERHEAD(1024)
+
+/*
+ * Holding the peer's readlock keeps readers off the tail skb while it
+ * grows; the new length is published under the peer's state lock,
+ * which is where unix_stream_data_wait() looks at it.
+ *
+ * Returns the number of bytes appended, 0 if a new skb is needed or a
+ * negative error.
+ */
+static int unix_stream_coalesce(struct sock *sk, struct sock *other,
+				struct msghdr *msg, struct scm_cookie *scm,
+				int size)
+{
+	struct unix_sock *u = unix_sk(other);
+	struct sk_buff *skb;
+	int err = 0;
+
+	if (!mutex_trylock(&u->readlock))
+		return 0;
+
+	unix_state_lock(other);
+	skb = skb_peek_tail(&other->sk_receive_queue);
+	if (!skb || skb->sk != sk || UNIXCB(skb).fp ||
+	    skb_tailroom(skb) < size ||
+	    memcmp(UNIXCREDS(skb), &scm->creds, sizeof(scm->creds)) ||
+	    !unix_secdata_eq(scm, skb) ||
+	    sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		goto out;
+	}
+	skb_get(skb);
+	unix_state_unlock(other);
+
+	err = memcpy_fromiovec(skb_tail_pointer(skb), msg->msg_iov, size);
+	if (err)
+		goto out_free;
+
+	unix_state_lock(other);
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		err = -EPIPE;
+	} else {
+		skb_put(skb, size);
+		err = size;
+	}
+	unix_state_unlock(other);
+
+out_free:
+	kfree_skb(skb);
+out:
+	mutex_unlock(&u->readlock);
+	return err;
+}
+
 static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			       struct msghdr *msg, size_t len)
 {
@@ -1532,7 +1616,7 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct sock *sk = sock->sk;
 	struct sock *other = NULL;
 	struct sockaddr_un *sunaddr = msg->msg_name;
-	int err, size;
+	int err, size, alloc;
 	struct sk_buff *skb;
 	int sent = 0;
 	struct scm_cookie tmp_scm;
@@ -1579,11 +1663,36 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (size > SKB_MAX_ALLOC)
 			size = SKB_MAX_ALLOC;
 
+		alloc = size;
+		if (size <= UNIX_STREAM_COALESCE_MAX && !siocb->scm->fp) {
+			err = unix_stream_coalesce(sk, other, msg, siocb->scm,
+						   size);
+			if (err == -EPIPE)
+				goto pipe_err;
+			if (err < 0)
+				goto out_err;
+			if (err > 0) {
+				/*
+				 * The skb was already queued, so anyone
+				 * waiting for data has been woken for it.
+				 * Only a reader peeking at an offset may
+				 * be waiting for the skb to grow.
+				 */
+				if (other->sk_peek_off >= 0)
+					other->sk_data_ready(other, size);
+				sent += size;
+				continue;
+			}
+			alloc = max_t(int, size,
+				      min_t(int, UNIX_STREAM_COALESCE_SKB,
+					    (sk->sk_sndbuf >> 1) - 64));
+		}
+
 		/*
 		 *	Grab a buffer
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
+		skb = sock_alloc_send_skb(sk, alloc, msg->msg_flags&MSG_DONTWAIT,
 					  &err);
 
 		if (skb == NULL)
@@ -1599,6 +1708,7 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		size = min_t(int, size, skb_tailroom(skb));
 
 		memcpy(UNIXCREDS(skb), &siocb->scm->creds, sizeof(struct ucred));
+		unix_get_secdata(siocb->scm, skb);
 		/* Only send the fds in the first buffer */
 		if (siocb->scm->fp && !fds_sent) {
 			err = unix_attach_fds(siocb->scm, skb);
@@ -1765,8 +1875,10 @@ out:
  *	Sleep until data has arrive. But check for races..
  */
 
-static long unix_stream_data_wait(struct sock *sk, long timeo)
+static long unix_stream_data_wait(struct sock *sk, long timeo,
+				  struct sk_buff *last, unsigned int last_len)
 {
+	struct sk_buff *tail;
 	DEFINE_WAIT(wait);
 
 	unix_state_lock(sk);
@@ -1774,7 +1886,10 @@ static long unix_stream_data_wait(struct sock *sk, long timeo)
 	for (;;) {
 		prepare_to_wait(sk_sleep(sk), &wait, TASK_INTERRUPTIBLE);
 
-		if (!skb_queue_empty(&sk->sk_receive_queue) ||
+		/* A send may have been appended to the skb we stopped at */
+		tail = skb_peek_tail(&sk->sk_receive_queue);
+		if (tail != last ||
+		    (tail && tail->len != last_len) ||
 		    sk->sk_err ||
 		    (sk->sk_shutdown & RCV_SHUTDOWN) ||
 		    signal_pending(current) ||
@@ -1809,6 +1924,7 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 	int target;
 	int err = 0;
 	long timeo;
+	int skip;
 
 	err = -EINVAL;
 	if (sk->sk_state != TCP_ESTABLISHED)
@@ -1836,10 +1952,13 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 	do {
 		int chunk;
-		struct sk_buff *skb;
+		struct sk_buff *skb, *last;
+		unsigned int last_len;
 
 		unix_state_lock(sk);
-		skb = skb_dequeue(&sk->sk_receive_queue);
+		last = skb = skb_peek(&sk->sk_receive_queue);
+		last_len = last ? last->len : 0;
+again:
 		if (skb == NULL) {
 			unix_sk(sk)->recursion_level = 0;
 			if (copied >= target)
@@ -1861,7 +1980,8 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 				break;
 			mutex_unlock(&u->readlock);
 
-			timeo = unix_stream_data_wait(sk, timeo);
+			timeo = unix_stream_data_wait(sk, timeo, last,
+						      last_len);
 
 			if (signal_pending(current)) {
 				err = sock_intr_errno(timeo);
@@ -1873,15 +1993,25 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			unix_state_unlock(sk);
 			break;
 		}
+
+		/* Skip what earlier MSG_PEEKs with SO_PEEK_OFF returned */
+		skip = sk_peek_offset(sk, flags);
+		while (skip >= skb->len) {
+			skip -= skb->len;
+			last = skb;
+			last_len = skb->len;
+			skb = skb_peek_next(skb, &sk->sk_receive_queue);
+			if (!skb)
+				goto again;
+		}
+
 		unix_state_unlock(sk);
 
 		if (check_creds) {
 			/* Never glue messages from different writers */
 			if (memcmp(UNIXCREDS(skb), &siocb->scm->creds,
-				   sizeof(siocb->scm->creds)) != 0) {
-				skb_queue_head(&sk->sk_receive_queue, skb);
+				   sizeof(siocb->scm->creds)) != 0)
 				break;
-			}
 		} else {
 			/* Copy credentials */
 			siocb->scm->creds = *UNIXCREDS(skb);
@@ -1894,9 +2024,8 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			sunaddr = NULL;
 		}
 
-		chunk = min_t(unsigned int, skb->len, size);
-		if (memcpy_toiovec(msg->msg_iov, skb->data, chunk)) {
-			skb_queue_head(&sk->sk_receive_queue, skb);
+		chunk = min_t(unsigned int, skb->len - skip, size);
+		if (skb_copy_datagram_iovec(skb, skip, msg->msg_iov, chunk)) {
 			if (copied == 0)
 				copied = -EFAULT;
 			break;
@@ -1908,16 +2037,17 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 		if (!(flags & MSG_PEEK)) {
 			skb_pull(skb, chunk);
 
+			sk_peek_offset_bwd(sk, chunk);
+
 			if (UNIXCB(skb).fp)
 				unix_detach_fds(siocb->scm, skb);
 
-			/* put the skb back if we didn't use it up.. */
-			if (skb->len) {
-				skb_queue_head(&sk->sk_receive_queue, skb);
+			/* leave the skb queued if we didn't use it up.. */
+			if (skb->len)
 				break;
-			}
 
-			kfree_skb(skb);
+			skb_unlink(skb, &sk->sk_receive_queue);
+			consume_skb(skb);
 
 			if (siocb->scm->fp)
 				break;
@@ -1927,8 +2057,8 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			if (UNIXCB(skb).fp)
 				siocb->scm->fp = scm_fp_dup(UNIXCB(skb).fp);
 
-			/* put message back and return */
-			skb_queue_head(&sk->sk_receive_queue, skb);
+			sk_peek_offset_fwd(sk, chunk);
+
 			break;
 		}
 	} while (size);
@@ -180,6 +180,17 @@ static int cap_inode_permission(struct inode *inode, int mask)
 	return 0;
 }
 
+static int cap_inode_exec_permission(struct inode *inode, unsigned int flags)
+{
+	return 0;
+}
+
+static int cap_inode_exec_permission_refwalk(struct inode *inode,
+					     unsigned int flags)
+{
+	return -ECHILD;
+}
+
 static int cap_inode_setattr(struct dentry *dentry, struct iattr *iattr)
 {
 	return 0;
@@ -898,6 +909,14 @@ void __init security_fixup_ops(struct security_operations *ops)
 	set_to_cap_if_null(ops, inode_readlink);
 	set_to_cap_if_null(ops, inode_follow_link);
 	set_to_cap_if_null(ops, inode_permission);
+	/*
+	 * A module that checks permissions but has no RCU-safe variant of
+	 * the check must see every lookup, so send those to ref-walk.
+	 */
+	if (!ops->inode_exec_permission &&
+	    ops->inode_permission != cap_inode_permission)
+		ops->inode_exec_permission = cap_inode_exec_permission_refwalk;
+	set_to_cap_if_null(ops, inode_exec_permission);
 	set_to_cap_if_null(ops, inode_setattr);
 	set_to_cap_if_null(ops, inode_getattr);
 	set_to_cap_if_null(ops, inode_setxattr);
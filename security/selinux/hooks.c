@@ -215,6 +215,14 @@ static int inode_alloc_security(struct inode *inode)
 	return 0;
 }
 
+static void inode_free_rcu(struct rcu_head *head)
+{
+	struct inode_security_struct *isec;
+
+	isec = container_of(head, struct inode_security_struct, rcu);
+	kmem_cache_free(sel_inode_cache, isec);
+}
+
 static void inode_free_security(struct inode *inode)
 {
 	struct inode_security_struct *isec = inode->i_security;
@@ -226,7 +234,7 @@ static void inode_free_security(struct inode *inode)
 	spin_unlock(&sbsec->isec_lock);
 
 	inode->i_security = NULL;
-	kmem_cache_free(sel_inode_cache, isec);
+	call_rcu(&isec->rcu, inode_free_rcu);
 }
 
 static int file_alloc_security(struct file *file)
@@ -2219,7 +2227,7 @@ static inline void flush_unauthorized_files(const struct cred *cred,
 
 	tty = get_current_tty();
 	if (tty) {
-		file_list_lock();
+		spin_lock(&tty_files_lock);
 		if (!list_empty(&tty->tty_files)) {
 			struct inode *inode;
 
@@ -2235,7 +2243,7 @@ static inline void flush_unauthorized_files(const struct cred *cred,
 				drop_tty = 1;
 			}
 		}
-		file_list_unlock();
+		spin_unlock(&tty_files_lock);
 		tty_kref_put(tty);
 	}
 	/* Reset controlling tty. */
@@ -2686,6 +2694,31 @@ static int selinux_inode_permission(struct inode *inode, int mask)
 			      file_mask_to_av(inode->i_mode, mask), NULL);
 }
 
+/*
+ * Search permission for RCU path walk.  Only an AVC decision that is
+ * allowed and needs no audit record can be taken here; anything else
+ * goes back to ref-walk and selinux_inode_permission().
+ */
+static int selinux_inode_exec_permission(struct inode *inode,
+					 unsigned int flags)
+{
+	struct inode_security_struct *isec;
+	struct av_decision avd;
+	u32 av;
+	int rc;
+
+	isec = rcu_dereference(inode->i_security);
+	if (!isec || !isec->initialized)
+		return -ECHILD;
+
+	av = file_mask_to_av(inode->i_mode, MAY_EXEC);
+	rc = avc_has_perm_noaudit(current_sid(), isec->sid, isec->sclass,
+				  av, AVC_STRICT, &avd);
+	if (rc || (avd.auditallow & av))
+		return -ECHILD;
+	return 0;
+}
+
 static int selinux_inode_setattr(struct dentry *dentry, struct iattr *iattr)
 {
 	const struct cred *cred = current_cred();
@@ -5477,6 +5510,7 @@ static struct security_operations selinux_ops = {
 	.inode_readlink =		selinux_inode_readlink,
 	.inode_follow_link =		selinux_inode_follow_link,
 	.inode_permission =		selinux_inode_permission,
+	.inode_exec_permission =	selinux_inode_exec_permission,
 	.inode_setattr =		selinux_inode_setattr,
 	.inode_getattr =		selinux_inode_getattr,
 	.inode_setxattr =		selinux_inode_setxattr,
@@ -44,6 +44,7 @@ struct inode_security_struct {
 	u16 sclass;		/* security class of this object */
 	unsigned char initialized;	/* initialization flag */
 	struct mutex lock;
+	struct rcu_head rcu;	/* RCU-walk may still be reading sid */
 };
 
 struct file_security_struct {
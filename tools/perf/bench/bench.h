@@ -4,6 +4,13 @@
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_net_packet_filter(int argc, const char **argv, const char *prefix);
+extern int bench_net_route_lookup(int argc, const char **argv, const char *prefix);
+extern int bench_net_conntrack(int argc, const char **argv, const char *prefix);
+extern int bench_net_unix_stream(int argc, const char **argv, const char *prefix);
+extern int bench_fs_stat(int argc, const char **argv, const char *prefix);
+extern int bench_fs_files(int argc, const char **argv, const char *prefix);
+extern int bench_md_write(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -14,4 +21,13 @@ extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __us
 
 extern int bench_format;
 
+/* bench/procs.c */
+typedef void (*bench_proc_fn)(int nr, void *arg);
+
+extern unsigned long long bench_run_procs(int nr_procs, bench_proc_fn fn,
+					  void *arg);
+extern void bench_print_procs(const char *label, const char *unit,
+			      int nr_procs, unsigned long long usecs,
+			      double total);
+
 #endif
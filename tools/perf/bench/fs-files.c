@@ -0,0 +1,208 @@
+/*
+ *
+ * fs-files.c
+ *
+ * files: Benchmark for parallel file creation and opening
+ *
+ * Has 1 up to the number of online cpus processes either create and
+ * unlink files or open and close a file, as fast as they can.  Every
+ * process works in a directory of its own, so the processes share
+ * nothing but the superblock: how well this scales shows how well the
+ * inode cache, the superblock's inode list and its list of open files
+ * scale.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define LOOPS_DEFAULT	100000
+#define COMPONENT	"perf-bench-files"
+
+static const char *base_dir = "/tmp";
+static const char *mode_str = "all";
+static int loops = LOOPS_DEFAULT;
+static int max_procs;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "dir",
+		   "Specify the directory to work in (default: /tmp)"),
+	OPT_STRING('m', "mode", &mode_str, "mode",
+		   "Specify the test to run: create, open or all (default)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of operations per process"),
+	OPT_INTEGER('p', "procs", &max_procs,
+		    "Specify maximum number of processes (default: online cpus)"),
+	OPT_END()
+};
+
+static const char * const bench_fs_files_usage[] = {
+	"perf bench fs files <options>",
+	NULL
+};
+
+enum files_mode {
+	MODE_CREATE,
+	MODE_OPEN,
+};
+
+static const char * const mode_names[] = {
+	[MODE_CREATE]	= "create+unlink",
+	[MODE_OPEN]	= "open+close",
+};
+
+/* working directory of process nr */
+static char *dir_path(int nr)
+{
+	char *path = malloc(strlen(base_dir) + sizeof("/" COMPONENT "-") + 12);
+
+	if (!path)
+		die("no memory");
+	sprintf(path, "%s/" COMPONENT "-%d", base_dir, nr);
+	return path;
+}
+
+static char *file_path(const char *dir, int nr)
+{
+	char *path = malloc(strlen(dir) + sizeof("/file-") + 12);
+
+	if (!path)
+		die("no memory");
+	sprintf(path, "%s/file-%d", dir, nr);
+	return path;
+}
+
+static void build_dirs(int nr_procs)
+{
+	char *dir, *file;
+	int i, fd;
+
+	for (i = 0; i < nr_procs; i++) {
+		dir = dir_path(i);
+		if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+			die("mkdir %s: %s", dir, strerror(errno));
+		/* the file that the open test opens */
+		file = file_path(dir, -1);
+		fd = open(file, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0)
+			die("create %s: %s", file, strerror(errno));
+		close(fd);
+		free(file);
+		free(dir);
+	}
+}
+
+static void remove_dirs(int nr_procs)
+{
+	char *dir, *file;
+	int i;
+
+	for (i = 0; i < nr_procs; i++) {
+		dir = dir_path(i);
+		file = file_path(dir, -1);
+		unlink(file);
+		rmdir(dir);
+		free(file);
+		free(dir);
+	}
+}
+
+static void create_loop(const char *dir)
+{
+	char *file;
+	int i, fd;
+
+	for (i = 0; i < loops; i++) {
+		file = file_path(dir, i);
+		fd = open(file, O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd < 0)
+			die("create %s: %s", file, strerror(errno));
+		close(fd);
+		if (unlink(file) < 0)
+			die("unlink %s: %s", file, strerror(errno));
+		free(file);
+	}
+}
+
+static void open_loop(const char *dir)
+{
+	char *file = file_path(dir, -1);
+	int i, fd;
+
+	for (i = 0; i < loops; i++) {
+		fd = open(file, O_RDONLY);
+		if (fd < 0)
+			die("open %s: %s", file, strerror(errno));
+		close(fd);
+	}
+	free(file);
+}
+
+static void files_proc(int nr, void *arg)
+{
+	enum files_mode mode = *(enum files_mode *)arg;
+	char *dir = dir_path(nr);
+
+	if (mode == MODE_CREATE)
+		create_loop(dir);
+	else
+		open_loop(dir);
+	free(dir);
+}
+
+static void run_mode(enum files_mode mode)
+{
+	int i;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d %s per process in %s\n\n", loops,
+		       mode_names[mode], base_dir);
+
+	for (i = 1; i <= max_procs; i++)
+		bench_print_procs(mode_names[mode], mode_names[mode], i,
+				  bench_run_procs(i, files_proc, &mode),
+				  (double)loops * i);
+}
+
+int bench_fs_files(int argc, const char **argv, const char *prefix __used)
+{
+	int do_create, do_open;
+
+	argc = parse_options(argc, argv, options, bench_fs_files_usage, 0);
+
+	do_create = !strcmp(mode_str, "all") || !strcmp(mode_str, "create");
+	do_open = !strcmp(mode_str, "all") || !strcmp(mode_str, "open");
+	if (!do_create && !do_open) {
+		fprintf(stderr, "Unknown mode: %s\n", mode_str);
+		return 1;
+	}
+	if (loops <= 0) {
+		fprintf(stderr, "Invalid loop count\n");
+		return 1;
+	}
+	if (max_procs <= 0)
+		max_procs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	build_dirs(max_procs);
+
+	if (do_create)
+		run_mode(MODE_CREATE);
+	if (do_open)
+		run_mode(MODE_OPEN);
+
+	remove_dirs(max_procs);
+
+	return 0;
+}
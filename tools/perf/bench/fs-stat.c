@@ -0,0 +1,152 @@
+/*
+ *
+ * fs-stat.c
+ *
+ * stat: Benchmark for parallel path lookup
+ *
+ * Builds a chain of nested directories with a file at the bottom and has
+ * 1 up to the number of online cpus processes stat() that file, all
+ * through the same directories, as fast as they can.  Every lookup walks
+ * every component of the path, so this shows how well path walking
+ * scales when all cpus share the same dentries.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define LOOPS_DEFAULT	1000000
+#define COMPONENT	"perf-bench-fs"
+
+static const char *base_dir = "/tmp";
+static int loops = LOOPS_DEFAULT;
+static int depth = 8;
+static int max_procs;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "dir",
+		   "Specify the directory to build the tree in (default: /tmp)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of stat() calls per process"),
+	OPT_INTEGER('D', "depth", &depth,
+		    "Specify number of directories in the path"),
+	OPT_INTEGER('p', "procs", &max_procs,
+		    "Specify maximum number of processes (default: online cpus)"),
+	OPT_END()
+};
+
+static const char * const bench_fs_stat_usage[] = {
+	"perf bench fs stat <options>",
+	NULL
+};
+
+/* path of the directory at level (0 is the top one) */
+static char *dir_path(int level)
+{
+	size_t len = strlen(base_dir) + (level + 1) * (sizeof(COMPONENT) + 8);
+	char *path = malloc(len + 1);
+	int i;
+
+	if (!path)
+		die("no memory");
+	strcpy(path, base_dir);
+	for (i = 0; i <= level; i++)
+		sprintf(path + strlen(path), "/" COMPONENT "-%d", i);
+	return path;
+}
+
+static char *file_path(void)
+{
+	char *dir = dir_path(depth - 1);
+	char *path = malloc(strlen(dir) + sizeof("/file"));
+
+	if (!path)
+		die("no memory");
+	sprintf(path, "%s/file", dir);
+	free(dir);
+	return path;
+}
+
+static void build_tree(const char *file)
+{
+	char *path;
+	int i, fd;
+
+	for (i = 0; i < depth; i++) {
+		path = dir_path(i);
+		if (mkdir(path, 0755) < 0 && errno != EEXIST)
+			die("mkdir %s: %s", path, strerror(errno));
+		free(path);
+	}
+	fd = open(file, O_WRONLY | O_CREAT, 0644);
+	if (fd < 0)
+		die("create %s: %s", file, strerror(errno));
+	close(fd);
+}
+
+static void remove_tree(const char *file)
+{
+	char *path;
+	int i;
+
+	unlink(file);
+	for (i = depth - 1; i >= 0; i--) {
+		path = dir_path(i);
+		rmdir(path);
+		free(path);
+	}
+}
+
+static void stat_loop(int nr __used, void *arg)
+{
+	const char *file = arg;
+	struct stat st;
+	int i;
+
+	for (i = 0; i < loops; i++)
+		if (stat(file, &st) < 0)
+			die("stat %s: %s", file, strerror(errno));
+}
+
+int bench_fs_stat(int argc, const char **argv, const char *prefix __used)
+{
+	char *file;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_fs_stat_usage, 0);
+
+	if (loops <= 0 || depth <= 0) {
+		fprintf(stderr, "Invalid loop count or depth\n");
+		return 1;
+	}
+	if (max_procs <= 0)
+		max_procs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	file = file_path();
+	build_tree(file);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d stat() calls per process of %s\n\n", loops, file);
+
+	for (i = 1; i <= max_procs; i++)
+		bench_print_procs(NULL, "stats", i,
+				  bench_run_procs(i, stat_loop, file),
+				  (double)loops * i);
+
+	remove_tree(file);
+	free(file);
+
+	return 0;
+}
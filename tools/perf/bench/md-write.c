@@ -0,0 +1,207 @@
+/*
+ *
+ * md-write.c
+ *
+ * write: Benchmark for parallel writes to a RAID4/5/6 array
+ *
+ * Has 1 up to the number of online cpus processes write a region of the
+ * array each with O_DIRECT, as fast as they can, once with the array's
+ * stripes all handled by raid5d and once with the per-cpu stripe workers
+ * (the stripe_workers attribute of the array).  How the throughput grows
+ * with the number of writers shows how well stripe handling and parity
+ * computation scale.
+ *
+ * To take the disks out of the picture, build the array on RAM-backed
+ * loop devices, e.g.:
+ *
+ *	for i in 0 1 2 3; do
+ *		dd if=/dev/zero of=/dev/shm/md-bench-$i bs=1M count=1024
+ *		losetup /dev/loop$i /dev/shm/md-bench-$i
+ *	done
+ *	mdadm --create /dev/md0 --level=5 --raid-devices=4 \
+ *		--assume-clean /dev/loop[0-3]
+ *	perf bench md write -d /dev/md0
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define SIZE_DEFAULT	64	/* MB per process */
+#define BLOCK_DEFAULT	1024	/* KB per write */
+
+static const char *device;
+static const char *mode_str = "all";
+static int size_mb = SIZE_DEFAULT;
+static int block_kb = BLOCK_DEFAULT;
+static int max_procs;
+
+static const struct option options[] = {
+	OPT_STRING('d', "device", &device, "dev",
+		   "Specify the md device to write to (its data is destroyed)"),
+	OPT_STRING('m', "mode", &mode_str, "mode",
+		   "Specify the stripe handling: raid5d, workers or all (default)"),
+	OPT_INTEGER('s', "size", &size_mb,
+		    "Specify megabytes written per process (default: 64)"),
+	OPT_INTEGER('b', "block", &block_kb,
+		    "Specify kilobytes per write (default: 1024)"),
+	OPT_INTEGER('p', "procs", &max_procs,
+		    "Specify maximum number of processes (default: online cpus)"),
+	OPT_END()
+};
+
+static const char * const bench_md_write_usage[] = {
+	"perf bench md write -d <device> <options>",
+	NULL
+};
+
+/* sysfs attribute switching between raid5d and the stripe workers */
+static char workers_path[PATH_MAX];
+
+static int read_workers(void)
+{
+	char buf[16];
+	int fd, len;
+
+	fd = open(workers_path, O_RDONLY);
+	if (fd < 0)
+		die("open %s: %s", workers_path, strerror(errno));
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		die("read %s: %s", workers_path, strerror(errno));
+	buf[len] = '\0';
+	return atoi(buf);
+}
+
+static void write_workers(int on)
+{
+	int fd;
+
+	fd = open(workers_path, O_WRONLY);
+	if (fd < 0)
+		die("open %s: %s", workers_path, strerror(errno));
+	if (write(fd, on ? "1" : "0", 1) != 1)
+		die("write %s: %s", workers_path, strerror(errno));
+	close(fd);
+}
+
+static void find_workers_path(void)
+{
+	char real[PATH_MAX];
+	const char *name;
+
+	if (!realpath(device, real))
+		die("%s: %s", device, strerror(errno));
+	name = strrchr(real, '/');
+	name = name ? name + 1 : real;
+	snprintf(workers_path, sizeof(workers_path),
+		 "/sys/block/%s/md/stripe_workers", name);
+	if (access(workers_path, R_OK | W_OK) < 0)
+		die("%s: %s (not a RAID4/5/6 array, or not root?)",
+		    workers_path, strerror(errno));
+}
+
+static void write_loop(int nr, void *arg __used)
+{
+	size_t block = (size_t)block_kb * 1024;
+	off_t off = (off_t)nr * size_mb * 1024 * 1024;
+	off_t end = off + (off_t)size_mb * 1024 * 1024;
+	void *buf;
+	int fd;
+
+	if (posix_memalign(&buf, 4096, block))
+		die("no memory");
+	memset(buf, nr + 1, block);
+
+	fd = open(device, O_WRONLY | O_DIRECT);
+	if (fd < 0)
+		die("open %s: %s", device, strerror(errno));
+	for (; off < end; off += block) {
+		if (pwrite(fd, buf, block, off) != (ssize_t)block)
+			die("write %s: %s", device, strerror(errno));
+	}
+	close(fd);
+	free(buf);
+}
+
+static void run_mode(int workers)
+{
+	int i;
+
+	write_workers(workers);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d MB per process in %d KB writes to %s, "
+		       "stripes handled by %s\n\n", size_mb, block_kb, device,
+		       workers ? "per-cpu workers" : "raid5d");
+
+	for (i = 1; i <= max_procs; i++)
+		bench_print_procs(workers ? "workers" : "raid5d", "MB", i,
+				  bench_run_procs(i, write_loop, NULL),
+				  (double)size_mb * i);
+}
+
+int bench_md_write(int argc, const char **argv, const char *prefix __used)
+{
+	int do_raid5d, do_workers, saved, fd;
+	unsigned long long dev_size;
+
+	argc = parse_options(argc, argv, options, bench_md_write_usage, 0);
+
+	if (!device) {
+		fprintf(stderr, "No device given\n");
+		usage_with_options(bench_md_write_usage, options);
+	}
+	do_raid5d = !strcmp(mode_str, "all") || !strcmp(mode_str, "raid5d");
+	do_workers = !strcmp(mode_str, "all") || !strcmp(mode_str, "workers");
+	if (!do_raid5d && !do_workers) {
+		fprintf(stderr, "Unknown mode: %s\n", mode_str);
+		return 1;
+	}
+	if (size_mb <= 0 || block_kb <= 0 || block_kb % 4) {
+		fprintf(stderr, "Invalid size or block size\n");
+		return 1;
+	}
+	if (max_procs <= 0)
+		max_procs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	fd = open(device, O_RDONLY);
+	if (fd < 0)
+		die("open %s: %s", device, strerror(errno));
+	if (ioctl(fd, BLKGETSIZE64, &dev_size) < 0)
+		die("%s: %s", device, strerror(errno));
+	close(fd);
+	if (dev_size < (unsigned long long)size_mb * max_procs * 1024 * 1024) {
+		fprintf(stderr, "%s is too small for %d processes writing "
+			"%d MB each\n", device, max_procs, size_mb);
+		return 1;
+	}
+
+	find_workers_path();
+	saved = read_workers();
+
+	if (do_raid5d)
+		run_mode(0);
+	if (do_workers)
+		run_mode(1);
+
+	write_workers(saved);
+
+	return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ *
+ * net-conntrack.c
+ *
+ * conntrack-new: Benchmark for the connection tracking new flow rate
+ *
+ * Creates a veth pair and lets pktgen threads, one per cpu in use,
+ * send UDP packets with random source addresses and ports into it, so
+ * that nearly every packet received on the peer creates and confirms a
+ * new conntrack entry.  The rate is taken from the 'insert' counters in
+ * /proc/net/stat/nf_conntrack, for 1 up to the number of online cpus.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define CT_STAT		"/proc/net/stat/nf_conntrack"
+#define CT_UDP_TIMEOUT	"/proc/sys/net/netfilter/nf_conntrack_udp_timeout"
+#define PG_DIR		"/proc/net/pktgen"
+
+/* pktgen sends on TX_DEV, conntrack sees the packets coming in on RX_DEV */
+#define TX_DEV		"pbct0"
+#define RX_DEV		"pbct1"
+#define RX_ADDR		"10.201.0.1"
+#define SRC_MIN		"10.202.0.0"
+#define SRC_MAX		"10.202.255.255"
+
+static int max_threads;
+static int duration = 5;
+static bool keep_veth;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &max_threads,
+		    "Specify maximum number of pktgen threads (default: online cpus)"),
+	OPT_INTEGER('d', "duration", &duration,
+		    "Specify seconds to run for each thread count"),
+	OPT_BOOLEAN('k', "keep", &keep_veth,
+		    "Do not delete the veth pair afterwards"),
+	OPT_END()
+};
+
+static const char * const bench_net_conntrack_usage[] = {
+	"perf bench net conntrack-new <options>",
+	NULL
+};
+
+struct ct_counts {
+	unsigned long long insert;
+	unsigned long long insert_failed;
+	unsigned long long drop;
+};
+
+static int read_sysctl(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	int val = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static int write_proc(const char *path, const char *fmt, ...)
+{
+	FILE *f = fopen(path, "w");
+	va_list ap;
+
+	if (!f)
+		return -1;
+	va_start(ap, fmt);
+	vfprintf(f, fmt, ap);
+	va_end(ap);
+	return fclose(f);
+}
+
+static void pg_cmd(const char *file, const char *cmd)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), PG_DIR "/%s", file);
+	if (write_proc(path, "%s\n", cmd) < 0)
+		die("pktgen: '%s' > %s: %s", cmd, path, strerror(errno));
+}
+
+/* sums the per cpu lines of /proc/net/stat/nf_conntrack */
+static void read_ct_counts(struct ct_counts *c)
+{
+	unsigned int v[13];
+	char line[256];
+	FILE *f;
+
+	memset(c, 0, sizeof(*c));
+	f = fopen(CT_STAT, "r");
+	if (!f)
+		die("cannot open %s: %s", CT_STAT, strerror(errno));
+	/* skip the header */
+	if (!fgets(line, sizeof(line), f))
+		die("cannot read %s", CT_STAT);
+	while (fgets(line, sizeof(line), f)) {
+		/* entries searched found new invalid ignore delete
+		 * delete_list insert insert_failed drop early_drop ... */
+		if (sscanf(line, "%x %x %x %x %x %x %x %x %x %x %x %x %x",
+			   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+			   &v[7], &v[8], &v[9], &v[10], &v[11], &v[12]) != 13)
+			continue;
+		c->insert += v[8];
+		c->insert_failed += v[9];
+		c->drop += v[10];
+	}
+	fclose(f);
+}
+
+static void read_mac(const char *dev, char *mac, size_t len)
+{
+	char path[64];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/address", dev);
+	f = fopen(path, "r");
+	if (!f || !fgets(mac, len, f))
+		die("cannot read %s", path);
+	fclose(f);
+	mac[strcspn(mac, "\n")] = '\0';
+}
+
+static void setup_veth(void)
+{
+	if (system("ip link del " TX_DEV " 2>/dev/null") < 0 ||
+	    system("ip link add " TX_DEV " type veth peer name " RX_DEV) ||
+	    system("ip addr add " RX_ADDR "/24 dev " RX_DEV) ||
+	    system("ip link set " RX_DEV " up") ||
+	    system("ip link set " TX_DEV " up"))
+		die("cannot set up veth pair " TX_DEV "/" RX_DEV);
+
+	/* the random sources would otherwise fail reverse path checks */
+	write_proc("/proc/sys/net/ipv4/conf/" RX_DEV "/rp_filter", "0\n");
+}
+
+static void setup_pktgen(int nr_threads, const char *dst_mac)
+{
+	char thread[32], dev[32], cmd[64];
+	int i;
+
+	for (i = 0; i < max_threads; i++) {
+		snprintf(thread, sizeof(thread), "kpktgend_%d", i);
+		pg_cmd(thread, "rem_device_all");
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		snprintf(thread, sizeof(thread), "kpktgend_%d", i);
+		snprintf(dev, sizeof(dev), TX_DEV "@%d", i);
+		snprintf(cmd, sizeof(cmd), "add_device %s", dev);
+		pg_cmd(thread, cmd);
+
+		pg_cmd(dev, "count 0");
+		pg_cmd(dev, "clone_skb 0");
+		pg_cmd(dev, "delay 0");
+		pg_cmd(dev, "pkt_size 60");
+		pg_cmd(dev, "dst " RX_ADDR);
+		snprintf(cmd, sizeof(cmd), "dst_mac %s", dst_mac);
+		pg_cmd(dev, cmd);
+		pg_cmd(dev, "src_min " SRC_MIN);
+		pg_cmd(dev, "src_max " SRC_MAX);
+		pg_cmd(dev, "flag IPSRC_RND");
+		pg_cmd(dev, "udp_src_min 1024");
+		pg_cmd(dev, "udp_src_max 65535");
+		pg_cmd(dev, "flag UDPSRC_RND");
+	}
+}
+
+/* returns elapsed time in usecs, c holds the counter deltas */
+static unsigned long long run_flows(struct ct_counts *c)
+{
+	struct ct_counts before, after;
+	struct timeval start, stop, diff;
+	pid_t pid;
+
+	/* "start" only returns once pktgen is stopped again */
+	pid = fork();
+	if (pid < 0)
+		die("fork: %s", strerror(errno));
+	if (!pid) {
+		pg_cmd("pgctrl", "start");
+		exit(0);
+	}
+
+	/* let the threads get going before taking the first sample */
+	sleep(1);
+	read_ct_counts(&before);
+	gettimeofday(&start, NULL);
+	sleep(duration);
+	read_ct_counts(&after);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	pg_cmd("pgctrl", "stop");
+	waitpid(pid, NULL, 0);
+
+	c->insert = after.insert - before.insert;
+	c->insert_failed = after.insert_failed - before.insert_failed;
+	c->drop = after.drop - before.drop;
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+static void print_result(int nr_threads, struct ct_counts *c,
+			 unsigned long long usecs)
+{
+	double secs = (double)usecs / 1000000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %3d threads: %llu.%03llu [sec]\n", nr_threads,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		printf(" %14d new flows/sec\n", (int)((double)c->insert / secs));
+		printf(" %14d new flows/sec/thread\n",
+		       (int)((double)c->insert / secs / nr_threads));
+		printf(" %14llu insert_failed, %llu drop\n\n",
+		       c->insert_failed, c->drop);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%d %d\n", nr_threads, (int)((double)c->insert / secs));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_net_conntrack(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct ct_counts c;
+	char dst_mac[32];
+	int old_timeout, ncpus, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_conntrack_usage, 0);
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (!max_threads || max_threads > ncpus)
+		max_threads = ncpus;
+	if (max_threads < 0 || duration <= 0) {
+		fprintf(stderr, "Invalid thread count or duration\n");
+		return 1;
+	}
+
+	if (access(CT_STAT, R_OK) < 0) {
+		fprintf(stderr, "%s not available, load nf_conntrack_ipv4\n",
+			CT_STAT);
+		return 1;
+	}
+	if (access(PG_DIR "/pgctrl", W_OK) < 0) {
+		fprintf(stderr, "%s not available, load pktgen\n",
+			PG_DIR "/pgctrl");
+		return 1;
+	}
+
+	/* keep the table from filling up and falling back to early drop */
+	old_timeout = read_sysctl(CT_UDP_TIMEOUT);
+	if (old_timeout > 0)
+		write_proc(CT_UDP_TIMEOUT, "1\n");
+
+	setup_veth();
+	read_mac(RX_DEV, dst_mac, sizeof(dst_mac));
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Sending random UDP flows from pktgen over "
+		       TX_DEV " to " RX_ADDR " on " RX_DEV
+		       ", %d seconds per run\n\n", duration);
+
+	for (i = 1; i <= max_threads; i++) {
+		unsigned long long usecs;
+
+		setup_pktgen(i, dst_mac);
+		usecs = run_flows(&c);
+		print_result(i, &c, usecs);
+	}
+
+	for (i = 0; i < max_threads; i++) {
+		char thread[32];
+
+		snprintf(thread, sizeof(thread), "kpktgend_%d", i);
+		pg_cmd(thread, "rem_device_all");
+	}
+	if (!keep_veth && system("ip link del " TX_DEV) < 0)
+		fprintf(stderr, "cannot delete " TX_DEV "\n");
+	if (old_timeout > 0)
+		write_proc(CT_UDP_TIMEOUT, "%d\n", old_timeout);
+
+	return 0;
+}
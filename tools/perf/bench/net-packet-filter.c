@@ -0,0 +1,464 @@
+/*
+ *
+ * net-packet-filter.c
+ *
+ * packet-filter: Benchmark for classic BPF socket filters
+ *
+ * Sends UDP datagrams over the loopback device while an AF_PACKET
+ * socket with a tcpdump style filter is bound to it, once with the
+ * filter interpreted and once with it compiled by the BPF JIT
+ * (/proc/sys/net/core/bpf_jit_enable).
+ *
+ * With --check it instead runs a set of small filters covering the
+ * absolute, indirect, SKF_NET_OFF/SKF_LL_OFF relative and ancillary
+ * loads in both modes, and fails if the JIT and the interpreter do not
+ * accept the same datagrams.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/poll.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netpacket/packet.h>
+#include <linux/filter.h>
+
+#ifndef ETH_P_ALL
+#define ETH_P_ALL	0x0003
+#endif
+
+#define BPF_JIT_SYSCTL	"/proc/sys/net/core/bpf_jit_enable"
+
+#define LOOPS_DEFAULT	1000000
+static int loops = LOOPS_DEFAULT;
+static int size = 64;
+static bool only_jit;
+static bool only_interp;
+static bool check;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of datagrams to send"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify UDP payload size"),
+	OPT_BOOLEAN('j', "jit", &only_jit,
+		    "Only run with the BPF JIT enabled"),
+	OPT_BOOLEAN('i', "interp", &only_interp,
+		    "Only run with the BPF interpreter"),
+	OPT_BOOLEAN('c', "check", &check,
+		    "Compare what the JIT and the interpreter accept"),
+	OPT_END()
+};
+
+static const char * const bench_net_packet_filter_usage[] = {
+	"perf bench net packet-filter <options>",
+	NULL
+};
+
+/*
+ * tcpdump -dd 'udp dst port 9': every datagram we send walks the
+ * whole IPv4 branch and is then rejected, so the packet socket
+ * receive queue never becomes the bottleneck.
+ */
+static struct sock_filter udp_port_filter[] = {
+	{ 0x28, 0, 0, 0x0000000c },
+	{ 0x15, 0, 4, 0x000086dd },
+	{ 0x30, 0, 0, 0x00000014 },
+	{ 0x15, 0, 11, 0x00000011 },
+	{ 0x28, 0, 0, 0x00000038 },
+	{ 0x15, 8, 9, 0x00000009 },
+	{ 0x15, 0, 8, 0x00000800 },
+	{ 0x30, 0, 0, 0x00000017 },
+	{ 0x15, 0, 6, 0x00000011 },
+	{ 0x28, 0, 0, 0x00000014 },
+	{ 0x45, 4, 0, 0x00001fff },
+	{ 0xb1, 0, 0, 0x0000000e },
+	{ 0x48, 0, 0, 0x00000010 },
+	{ 0x15, 0, 1, 0x00000009 },
+	{ 0x06, 0, 0, 0x0000ffff },
+	{ 0x06, 0, 0, 0x00000000 },
+};
+
+#define ACCEPT		BPF_STMT(BPF_RET | BPF_K, 0xffff)
+#define REJECT		BPF_STMT(BPF_RET | BPF_K, 0)
+
+/* payload of the --check datagrams */
+#define CHECK_SIZE	32
+#define CHECK_LOOPS	16
+
+struct check_filter {
+	const char		*name;
+	struct sock_filter	*insns;
+	unsigned int		len;
+	bool			accept;
+};
+
+#define CHECK_FILTER(n, a, ...)					\
+	{							\
+		.name	= n,					\
+		.insns	= (struct sock_filter []){ __VA_ARGS__ },	\
+		.len	= sizeof((struct sock_filter []){ __VA_ARGS__ }) \
+			  / sizeof(struct sock_filter),		\
+		.accept	= a,					\
+	}
+
+/*
+ * Each filter runs behind a header that rejects everything but our own
+ * datagrams (see check_filter()), so it sees an Ethernet header from lo
+ * followed by an IPv4 header without options, UDP and CHECK_SIZE bytes.
+ */
+static struct check_filter check_filters[] = {
+	CHECK_FILTER("ld abs", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 26),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, INADDR_LOOPBACK, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ldb net_off abs", true,
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + 9),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ldh ll_off abs", true,
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 12),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x0800, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ld net_off ind", true,
+		BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, 16),
+		BPF_STMT(BPF_LD | BPF_W | BPF_IND, SKF_NET_OFF),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, INADDR_LOOPBACK, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ld net_off beyond the packet", false,
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 0x8000),
+		ACCEPT),
+	CHECK_FILTER("ldh beyond the packet", false,
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0x8000),
+		ACCEPT),
+	CHECK_FILTER("ldxb msh", true,
+		BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+		BPF_STMT(BPF_MISC | BPF_TXA, 0),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ancillary protocol", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x0800, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("ancillary ifindex", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_IFINDEX),
+		BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 0, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("len and alu", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+		BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 14 + 20 + 8),
+		BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 3),
+		BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 8),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, CHECK_SIZE, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("div by zero X", false,
+		BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, 0),
+		BPF_STMT(BPF_LD | BPF_W | BPF_IMM, 1),
+		BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+		ACCEPT),
+	CHECK_FILTER("scratch memory", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_IMM, 0x10),
+		BPF_STMT(BPF_ST, 3),
+		BPF_STMT(BPF_LDX | BPF_W | BPF_MEM, 3),
+		BPF_STMT(BPF_MISC | BPF_TXA, 0),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x10, 0, 1),
+		ACCEPT, REJECT),
+	CHECK_FILTER("unwritten scratch memory", true,
+		BPF_STMT(BPF_LD | BPF_W | BPF_MEM, 5),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 1),
+		ACCEPT, REJECT),
+};
+
+static int read_jit_sysctl(void)
+{
+	FILE *f = fopen(BPF_JIT_SYSCTL, "r");
+	int val = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static int write_jit_sysctl(int val)
+{
+	FILE *f = fopen(BPF_JIT_SYSCTL, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%d\n", val);
+	return fclose(f);
+}
+
+static void attach_filter(int psock, struct sock_filter *insns,
+			  unsigned int len)
+{
+	struct sock_fprog fprog = {
+		.len	= len,
+		.filter	= insns,
+	};
+
+	if (setsockopt(psock, SOL_SOCKET, SO_ATTACH_FILTER,
+		       &fprog, sizeof(fprog)) < 0)
+		die("SO_ATTACH_FILTER: %s", strerror(errno));
+}
+
+/*
+ * A packet socket bound to lo, and a pair of UDP sockets to send from
+ * ssock to *sin. Returns the packet socket, or -1 without CAP_NET_RAW.
+ */
+static int open_sockets(int *rsock, int *ssock, struct sockaddr_in *sin)
+{
+	struct sockaddr_ll sll;
+	socklen_t slen = sizeof(*sin);
+	int psock;
+
+	psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (psock < 0) {
+		fprintf(stderr, "socket(PF_PACKET): %s\n", strerror(errno));
+		return -1;
+	}
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	sll.sll_ifindex = if_nametoindex("lo");
+	if (bind(psock, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+		die("bind(PF_PACKET): %s", strerror(errno));
+
+	/* an unread sink, so sendto() never sees ICMP errors */
+	*rsock = socket(AF_INET, SOCK_DGRAM, 0);
+	*ssock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (*rsock < 0 || *ssock < 0)
+		die("socket(AF_INET): %s", strerror(errno));
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(*rsock, (struct sockaddr *)sin, sizeof(*sin)) < 0 ||
+	    getsockname(*rsock, (struct sockaddr *)sin, &slen) < 0)
+		die("bind(AF_INET): %s", strerror(errno));
+
+	return psock;
+}
+
+/* returns elapsed time in usecs, or 0 on failure */
+static unsigned long long run_filter(void)
+{
+	struct sockaddr_in sin;
+	struct timeval start, stop, diff;
+	int psock, rsock, ssock, i;
+	char *buf;
+
+	buf = zalloc(size);
+	if (!buf)
+		die("no memory");
+
+	psock = open_sockets(&rsock, &ssock, &sin);
+	if (psock < 0) {
+		free(buf);
+		return 0;
+	}
+	attach_filter(psock, udp_port_filter, ARRAY_SIZE(udp_port_filter));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++)
+		if (sendto(ssock, buf, size, 0,
+			   (struct sockaddr *)&sin, sizeof(sin)) < 0 &&
+		    errno != ENOBUFS)
+			die("sendto: %s", strerror(errno));
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	close(ssock);
+	close(rsock);
+	close(psock);
+	free(buf);
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+/*
+ * Returns how many copies of CHECK_LOOPS datagrams the filter let through
+ * to the packet socket, or -1 on failure. Every datagram passes lo twice,
+ * once outgoing and once incoming.
+ */
+static int check_filter(const struct check_filter *cf)
+{
+	struct sock_filter insns[64];
+	struct sockaddr_in sin;
+	struct pollfd pfd;
+	char buf[CHECK_SIZE], pkt[256];
+	int psock, rsock, ssock, i, count = 0;
+
+	psock = open_sockets(&rsock, &ssock, &sin);
+	if (psock < 0)
+		return -1;
+
+	/* ldh [36] (UDP dport); jeq #port, 1, 0; ret #0; ...cf->insns */
+	insns[0] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 36);
+	insns[1] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+						ntohs(sin.sin_port), 1, 0);
+	insns[2] = (struct sock_filter)REJECT;
+	if (cf->len > ARRAY_SIZE(insns) - 3)
+		die("filter %s too long", cf->name);
+	memcpy(insns + 3, cf->insns, cf->len * sizeof(*insns));
+	attach_filter(psock, insns, cf->len + 3);
+
+	/* the filter only applies to what is queued from now on */
+	while (recv(psock, pkt, sizeof(pkt), MSG_DONTWAIT) >= 0)
+		;
+
+	memset(buf, 0, sizeof(buf));
+	for (i = 0; i < CHECK_LOOPS; i++)
+		if (sendto(ssock, buf, sizeof(buf), 0,
+			   (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			die("sendto: %s", strerror(errno));
+
+	pfd.fd = psock;
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, 100) > 0)
+		if (recv(psock, pkt, sizeof(pkt), MSG_DONTWAIT) >= 0)
+			count++;
+
+	close(ssock);
+	close(rsock);
+	close(psock);
+
+	return count;
+}
+
+static int run_check(int old_jit)
+{
+	unsigned int i;
+	int interp, jit, failed = 0;
+
+	for (i = 0; i < ARRAY_SIZE(check_filters); i++) {
+		const struct check_filter *cf = &check_filters[i];
+
+		if (write_jit_sysctl(0) < 0)
+			die("cannot write %s: %s", BPF_JIT_SYSCTL,
+			    strerror(errno));
+		interp = check_filter(cf);
+		if (write_jit_sysctl(1) < 0)
+			die("cannot write %s: %s", BPF_JIT_SYSCTL,
+			    strerror(errno));
+		jit = check_filter(cf);
+		if (interp < 0 || jit < 0) {
+			write_jit_sysctl(old_jit);
+			return 1;
+		}
+
+		if (interp != jit || (interp != 0) != cf->accept) {
+			failed++;
+			printf(" %-30s FAILED: interpreter %d, jit %d, "
+			       "expected %s\n", cf->name, interp, jit,
+			       cf->accept ? "accept" : "reject");
+		} else if (bench_format == BENCH_FORMAT_DEFAULT) {
+			printf(" %-30s ok\n", cf->name);
+		}
+	}
+	write_jit_sysctl(old_jit);
+
+	printf("# %u filters, %d failed\n",
+	       (unsigned int)ARRAY_SIZE(check_filters), failed);
+	return failed ? 1 : 0;
+}
+
+static void print_result(const char *mode, unsigned long long usecs)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %llu.%03llu [sec]\n", mode,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		printf(" %14lf usecs/packet\n",
+		       (double)usecs / (double)loops);
+		printf(" %14d packets/sec\n\n",
+		       (int)((double)loops / ((double)usecs / 1000000.0)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu.%03llu\n", mode,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_net_packet_filter(int argc, const char **argv,
+			    const char *prefix __used)
+{
+	unsigned long long usecs;
+	int old_jit;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_packet_filter_usage, 0);
+
+	if (loops <= 0 || size <= 0) {
+		fprintf(stderr, "Invalid loop count or size\n");
+		return 1;
+	}
+
+	old_jit = read_jit_sysctl();
+	if (old_jit < 0 && (only_jit || check)) {
+		fprintf(stderr, "%s not available, kernel built without "
+			"CONFIG_BPF_JIT?\n", BPF_JIT_SYSCTL);
+		return 1;
+	}
+
+	if (check)
+		return run_check(old_jit);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Sending %d UDP datagrams of %d bytes over lo "
+		       "through a packet socket filter\n\n", loops, size);
+
+	if (!only_jit) {
+		if (old_jit >= 0 && write_jit_sysctl(0) < 0)
+			die("cannot write %s: %s", BPF_JIT_SYSCTL,
+			    strerror(errno));
+		usecs = run_filter();
+		if (!usecs) {
+			if (old_jit >= 0)
+				write_jit_sysctl(old_jit);
+			return 1;
+		}
+		print_result("interpreter", usecs);
+	}
+
+	if (!only_interp && old_jit >= 0) {
+		if (write_jit_sysctl(1) < 0)
+			die("cannot write %s: %s", BPF_JIT_SYSCTL,
+			    strerror(errno));
+		usecs = run_filter();
+		if (!usecs) {
+			write_jit_sysctl(old_jit);
+			return 1;
+		}
+		print_result("jit", usecs);
+	}
+
+	if (old_jit >= 0)
+		write_jit_sysctl(old_jit);
+
+	return 0;
+}
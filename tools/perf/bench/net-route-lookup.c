@@ -0,0 +1,346 @@
+/*
+ *
+ * net-route-lookup.c
+ *
+ * route-lookup: Benchmark for IPv4 route lookups
+ *
+ * Sets up two tun devices, one that packets come in on and one that
+ * they are routed out of via a gateway, and measures, once through the
+ * route cache and once with the cache bypassed
+ * (/proc/sys/net/ipv4/rt_cache_bypass), for several flow counts:
+ *
+ *  output:  UDP datagrams sent from an unconnected socket round robin
+ *           to that many destinations, so that every sendto() has to
+ *           look up an output route
+ *  forward: IPv4 packets written into the input tun device round robin
+ *           to that many destinations, so that every packet takes the
+ *           input route lookup and is forwarded
+ *
+ * Whatever comes out of the output device is dropped by the tun driver.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <net/if.h>
+
+/* from <linux/if_tun.h>, which does not mix with the kernel headers */
+#define TUNSETIFF	_IOW('T', 202, int)
+#define IFF_TUN		0x0001
+#define IFF_NO_PI	0x1000
+#define IFF_ONE_QUEUE	0x2000
+
+#define RT_BYPASS_SYSCTL	"/proc/sys/net/ipv4/rt_cache_bypass"
+#define IP_FORWARD_SYSCTL	"/proc/sys/net/ipv4/ip_forward"
+
+/*
+ * Packets come in on IN_DEV from SRC_ADDR, which is routed back via a
+ * gateway so that the source is not directly connected, and go out on
+ * OUT_DEV via a gateway to the DST_BASE/16 destinations.
+ */
+#define IN_DEV		"pbrt0"
+#define OUT_DEV		"pbrt1"
+#define SRC_ADDR	0x0ac90002	/* 10.201.0.2 */
+#define DST_BASE	0x0acb0000	/* 10.203.0.0 */
+#define FLOWS_MAX	(1 << 16)
+
+#define LOOPS_DEFAULT	1000000
+static int loops = LOOPS_DEFAULT;
+static int flows;
+static const char *mode_str = "all";
+static bool only_cache;
+static bool only_bypass;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of packets to send"),
+	OPT_INTEGER('f', "flows", &flows,
+		    "Specify number of destinations (default: 1 to 65536)"),
+	OPT_STRING('m', "mode", &mode_str, "mode",
+		   "Specify the lookups to run: output, forward or all (default)"),
+	OPT_BOOLEAN('c', "cache", &only_cache,
+		    "Only run with the route cache"),
+	OPT_BOOLEAN('b', "bypass", &only_bypass,
+		    "Only run with the route cache bypassed"),
+	OPT_END()
+};
+
+static const char * const bench_net_route_lookup_usage[] = {
+	"perf bench net route-lookup <options>",
+	NULL
+};
+
+enum lookup_mode {
+	MODE_OUTPUT,
+	MODE_FORWARD,
+};
+
+static const char * const mode_names[] = {
+	[MODE_OUTPUT]	= "output",
+	[MODE_FORWARD]	= "forward",
+};
+
+static const int default_flows[] = { 1, 16, 256, 4096, 65536 };
+
+static int in_fd = -1, out_fd = -1;
+
+static int read_sysctl(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	int val = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static int write_proc(const char *path, const char *fmt, ...)
+{
+	FILE *f = fopen(path, "w");
+	va_list ap;
+
+	if (!f)
+		return -1;
+	va_start(ap, fmt);
+	vfprintf(f, fmt, ap);
+	va_end(ap);
+	return fclose(f);
+}
+
+/* the device goes away again when the file is closed */
+static int open_tun(const char *name)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open("/dev/net/tun", O_RDWR);
+	if (fd < 0)
+		die("cannot open /dev/net/tun: %s", strerror(errno));
+
+	memset(&ifr, 0, sizeof(ifr));
+	/* drop what nobody reads instead of stopping the queue */
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI | IFF_ONE_QUEUE;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+		die("TUNSETIFF %s: %s", name, strerror(errno));
+	return fd;
+}
+
+static void setup_tun(void)
+{
+	in_fd = open_tun(IN_DEV);
+	out_fd = open_tun(OUT_DEV);
+
+	if (system("ip addr add 10.200.0.1/24 dev " IN_DEV) ||
+	    system("ip link set " IN_DEV " up") ||
+	    system("ip route add 10.201.0.0/16 via 10.200.0.2 dev " IN_DEV) ||
+	    system("ip addr add 10.202.0.1/24 dev " OUT_DEV) ||
+	    system("ip link set " OUT_DEV " up") ||
+	    system("ip route add 10.203.0.0/16 via 10.202.0.2 dev " OUT_DEV))
+		die("cannot set up " IN_DEV "/" OUT_DEV);
+}
+
+static unsigned short ip_csum(const unsigned short *p, int len)
+{
+	unsigned int sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *p++;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += sum >> 16;
+	return ~sum;
+}
+
+#define PKT_LEN		(sizeof(struct iphdr) + sizeof(struct udphdr) + 1)
+
+/* a UDP packet with a one byte payload from SRC_ADDR to daddr */
+static void build_packet(struct iphdr *iph, unsigned int daddr)
+{
+	struct udphdr *uh = (struct udphdr *)(iph + 1);
+
+	memset(iph, 0, PKT_LEN);
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->tot_len = htons(PKT_LEN);
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_UDP;
+	iph->saddr = htonl(SRC_ADDR);
+	iph->daddr = htonl(daddr);
+	iph->check = ip_csum((unsigned short *)iph, sizeof(*iph));
+	uh->source = htons(9);
+	uh->dest = htons(9);
+	uh->len = htons(sizeof(*uh) + 1);
+}
+
+static void output_loop(int nr_flows)
+{
+	struct sockaddr_in sin;
+	char buf[1] = { 0 };
+	int sock, i;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		die("socket(AF_INET): %s", strerror(errno));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(9);
+
+	for (i = 0; i < loops; i++) {
+		sin.sin_addr.s_addr = htonl(DST_BASE + i % nr_flows);
+		if (sendto(sock, buf, sizeof(buf), 0,
+			   (struct sockaddr *)&sin, sizeof(sin)) < 0 &&
+		    errno != ENOBUFS)
+			die("sendto: %s", strerror(errno));
+	}
+	close(sock);
+}
+
+static void forward_loop(int nr_flows)
+{
+	struct iphdr pkt[4];
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		build_packet(pkt, DST_BASE + i % nr_flows);
+		if (write(in_fd, pkt, PKT_LEN) < 0)
+			die("write " IN_DEV ": %s", strerror(errno));
+	}
+}
+
+/* returns elapsed time in usecs */
+static unsigned long long run_lookups(enum lookup_mode mode, int nr_flows)
+{
+	struct timeval start, stop, diff;
+
+	gettimeofday(&start, NULL);
+	if (mode == MODE_OUTPUT)
+		output_loop(nr_flows);
+	else
+		forward_loop(nr_flows);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+static void print_result(enum lookup_mode mode, const char *cache,
+			 int nr_flows, unsigned long long usecs)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %7s %6s %8d flows: %llu.%03llu [sec]\n",
+		       mode_names[mode], cache, nr_flows,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		printf(" %14lf usecs/packet\n",
+		       (double)usecs / (double)loops);
+		printf(" %14d packets/sec\n\n",
+		       (int)((double)loops / ((double)usecs / 1000000.0)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %s %d %llu.%03llu\n", mode_names[mode], cache,
+		       nr_flows, usecs / 1000000, (usecs % 1000000) / 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+static void run_mode(enum lookup_mode mode, const char *cache, int bypass)
+{
+	unsigned int i;
+
+	if (write_proc(RT_BYPASS_SYSCTL, "%d\n", bypass) < 0)
+		die("cannot write %s: %s", RT_BYPASS_SYSCTL, strerror(errno));
+
+	if (flows) {
+		print_result(mode, cache, flows, run_lookups(mode, flows));
+		return;
+	}
+	for (i = 0; i < ARRAY_SIZE(default_flows); i++)
+		print_result(mode, cache, default_flows[i],
+			     run_lookups(mode, default_flows[i]));
+}
+
+static void run_both(enum lookup_mode mode)
+{
+	if (!only_bypass)
+		run_mode(mode, "cache", 0);
+	if (!only_cache)
+		run_mode(mode, "bypass", 1);
+}
+
+int bench_net_route_lookup(int argc, const char **argv,
+			   const char *prefix __used)
+{
+	int old_bypass, old_forward;
+	int do_output, do_forward;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_route_lookup_usage, 0);
+
+	do_output = !strcmp(mode_str, "all") || !strcmp(mode_str, "output");
+	do_forward = !strcmp(mode_str, "all") || !strcmp(mode_str, "forward");
+	if (!do_output && !do_forward) {
+		fprintf(stderr, "Unknown mode: %s\n", mode_str);
+		return 1;
+	}
+	if (loops <= 0 || flows < 0 || flows > FLOWS_MAX) {
+		fprintf(stderr, "Invalid loop or flow count\n");
+		return 1;
+	}
+
+	old_bypass = read_sysctl(RT_BYPASS_SYSCTL);
+	if (old_bypass < 0) {
+		fprintf(stderr, "%s not available\n", RT_BYPASS_SYSCTL);
+		return 1;
+	}
+	old_forward = read_sysctl(IP_FORWARD_SYSCTL);
+
+	setup_tun();
+	if (do_forward && write_proc(IP_FORWARD_SYSCTL, "1\n") < 0)
+		die("cannot write %s: %s", IP_FORWARD_SYSCTL, strerror(errno));
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d packets round robin to 10.203.0.0 and up "
+		       "via " OUT_DEV "\n\n", loops);
+
+	if (do_output)
+		run_both(MODE_OUTPUT);
+	if (do_forward)
+		run_both(MODE_FORWARD);
+
+	write_proc(RT_BYPASS_SYSCTL, "%d\n", old_bypass);
+	if (do_forward && old_forward >= 0)
+		write_proc(IP_FORWARD_SYSCTL, "%d\n", old_forward);
+	close(in_fd);
+	close(out_fd);
+
+	return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ *
+ * net-unix-stream.c
+ *
+ * unix-stream: Benchmark for small messages over AF_UNIX stream sockets
+ *
+ * Two processes connected by a socketpair(), either passing a message
+ * back and forth (ping-pong, the latency of a request/reply exchange
+ * between two daemons) or with one of them writing messages as fast as
+ * it can and the other reading them in large chunks (streaming, where
+ * small writes can be coalesced on the receive queue).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#define LOOPS_DEFAULT	1000000
+#define READ_CHUNK	65536
+
+static int loops = LOOPS_DEFAULT;
+static int size = 64;
+static bool only_pingpong;
+static bool only_stream;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of messages"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify message size in bytes"),
+	OPT_BOOLEAN('p', "pingpong", &only_pingpong,
+		    "Only run the ping-pong test"),
+	OPT_BOOLEAN('S', "stream", &only_stream,
+		    "Only run the streaming test"),
+	OPT_END()
+};
+
+static const char * const bench_net_unix_stream_usage[] = {
+	"perf bench net unix-stream <options>",
+	NULL
+};
+
+static void write_all(int fd, const char *buf, int len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			die("write: %s", strerror(errno));
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+static void read_all(int fd, char *buf, int len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = read(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			die("read: %s", strerror(errno));
+		}
+		if (!ret)
+			die("read: unexpected EOF");
+		buf += ret;
+		len -= ret;
+	}
+}
+
+static void pingpong_child(int fd, char *buf)
+{
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		read_all(fd, buf, size);
+		write_all(fd, buf, size);
+	}
+}
+
+static void stream_child(int fd)
+{
+	unsigned long long left = (unsigned long long)loops * size;
+	char *buf = malloc(READ_CHUNK);
+	ssize_t ret;
+
+	if (!buf)
+		die("no memory");
+	while (left) {
+		ret = read(fd, buf, READ_CHUNK);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			die("read: %s", strerror(errno));
+		}
+		if (!ret)
+			die("read: unexpected EOF");
+		left -= ret;
+	}
+	free(buf);
+}
+
+/* returns elapsed time in usecs */
+static unsigned long long run(bool pingpong)
+{
+	struct timeval start, stop, diff;
+	int fds[2], i, status;
+	pid_t pid;
+	char *buf;
+
+	buf = zalloc(size);
+	if (!buf)
+		die("no memory");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+		die("socketpair: %s", strerror(errno));
+
+	pid = fork();
+	if (pid < 0)
+		die("fork: %s", strerror(errno));
+	if (!pid) {
+		close(fds[0]);
+		if (pingpong)
+			pingpong_child(fds[1], buf);
+		else
+			stream_child(fds[1]);
+		exit(0);
+	}
+	close(fds[1]);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++) {
+		write_all(fds[0], buf, size);
+		if (pingpong)
+			read_all(fds[0], buf, size);
+	}
+	if (waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		die("reader failed");
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	close(fds[0]);
+	free(buf);
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+static void print_result(const char *mode, unsigned long long usecs)
+{
+	double secs = (double)usecs / 1000000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %llu.%03llu [sec]\n", mode,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		printf(" %14lf usecs/msg\n",
+		       (double)usecs / (double)loops);
+		printf(" %14d msgs/sec\n", (int)((double)loops / secs));
+		printf(" %14lf MB/sec\n\n",
+		       (double)loops * size / secs / (1024 * 1024));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu.%03llu\n", mode,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_net_unix_stream(int argc, const char **argv,
+			  const char *prefix __used)
+{
+	argc = parse_options(argc, argv, options,
+			     bench_net_unix_stream_usage, 0);
+
+	if (loops <= 0 || size <= 0) {
+		fprintf(stderr, "Invalid loop count or size\n");
+		return 1;
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Passing %d messages of %d bytes over a "
+		       "socketpair(AF_UNIX, SOCK_STREAM)\n\n", loops, size);
+
+	if (!only_stream)
+		print_result("ping-pong", run(true));
+	if (!only_pingpong)
+		print_result("stream", run(false));
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ *
+ * procs.c
+ *
+ * Helpers for benchmarks that run the same loop in 1 up to N processes
+ * at once: start the processes together, time them until the last one
+ * is done, and print the throughput.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+ * Fork nr_procs processes that each call fn(nr, arg), nr counting from 0,
+ * and exit.  They all wait on a pipe so that the clock only starts once
+ * every process is there.  Returns the elapsed time in usecs.
+ */
+unsigned long long bench_run_procs(int nr_procs, bench_proc_fn fn, void *arg)
+{
+	struct timeval start, stop, diff;
+	int go[2], i, status;
+	char c;
+
+	if (pipe(go) < 0)
+		die("pipe: %s", strerror(errno));
+
+	/* don't let the children print our buffered output again */
+	fflush(stdout);
+
+	for (i = 0; i < nr_procs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork: %s", strerror(errno));
+		if (!pid) {
+			close(go[1]);
+			/* wait until all processes are there */
+			if (read(go[0], &c, 1) < 0)
+				die("read: %s", strerror(errno));
+			fn(i, arg);
+			exit(0);
+		}
+	}
+	close(go[0]);
+
+	gettimeofday(&start, NULL);
+	close(go[1]);
+	for (i = 0; i < nr_procs; i++) {
+		if (wait(&status) < 0 ||
+		    !WIFEXITED(status) || WEXITSTATUS(status))
+			die("benchmark process failed");
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+/*
+ * Print the result of bench_run_procs(): total is the amount of work
+ * done by all processes together, counted in unit.  label, if not NULL,
+ * tells apart the runs of a benchmark in the simple format.
+ */
+void bench_print_procs(const char *label, const char *unit, int nr_procs,
+		       unsigned long long usecs, double total)
+{
+	double secs = (double)usecs / 1000000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %3d procs: %llu.%03llu [sec]\n", nr_procs,
+		       usecs / 1000000, (usecs % 1000000) / 1000);
+		printf(" %14.1f %s/sec\n", total / secs, unit);
+		printf(" %14.1f %s/sec/proc\n\n",
+		       total / secs / nr_procs, unit);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		if (label)
+			printf("%s ", label);
+		printf("%d %.1f\n", nr_procs, total / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
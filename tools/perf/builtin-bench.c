@@ -13,6 +13,8 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  net   ... networking stack
+ *  fs    ... filesystem and VFS
  *
  */
 
@@ -58,6 +60,48 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite net_suites[] = {
+	{ "packet-filter",
+	  "Packet socket filter, BPF interpreter vs JIT",
+	  bench_net_packet_filter },
+	{ "route-lookup",
+	  "IPv4 route lookups, route cache vs FIB",
+	  bench_net_route_lookup },
+	{ "conntrack-new",
+	  "Conntrack new flow rate per number of cpus",
+	  bench_net_conntrack },
+	{ "unix-stream",
+	  "AF_UNIX stream socket ping-pong and streaming",
+	  bench_net_unix_stream },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL                    }
+};
+
+static struct bench_suite fs_suites[] = {
+	{ "stat",
+	  "Parallel stat() of one path per number of cpus",
+	  bench_fs_stat },
+	{ "files",
+	  "Parallel create/unlink and open/close per number of cpus",
+	  bench_fs_files },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite md_suites[] = {
+	{ "write",
+	  "Parallel writes to a RAID4/5/6 array, raid5d vs per-cpu workers",
+	  bench_md_write },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +115,15 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "net",
+	  "networking stack",
+	  net_suites },
+	{ "fs",
+	  "filesystem and VFS",
+	  fs_suites },
+	{ "md",
+	  "software RAID",
+	  md_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },